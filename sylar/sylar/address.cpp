@@ -1,7 +1,9 @@
 #include "address.h"
 #include <sstream>
 #include <string.h>
+#include <arpa/inet.h>
 #include "endian.h"
+#include "dns.h"
 
 namespace sylar
 {
@@ -11,6 +13,132 @@ int Address::getFamily() const
     return getAddr()->sa_family;
 }
 
+Address::ptr Address::Create(const sockaddr* addr, socklen_t addrlen)
+{
+    if (addr == nullptr) {
+        return nullptr;
+    }
+    Address::ptr result;
+    switch (addr->sa_family) {
+        case AF_INET:
+            result.reset(new IPv4Address(*(const sockaddr_in*)addr));
+            break;
+        case AF_INET6:
+            result.reset(new IPv6Address(*(const sockaddr_in6*)addr));
+            break;
+        default:
+            result.reset(new UnknowAddress(*addr));
+            break;
+    }
+    return result;
+}
+
+/**
+ * @brief 拆分host和端口, 支持 [ipv6]:port, host:port, host
+ */
+static bool SplitHostPort(const std::string& host, std::string& node, uint32_t& port)
+{
+    std::string service;
+    if (!host.empty() && host[0] == '[') {
+        size_t pos = host.find(']');
+        if (pos == std::string::npos) {
+            return false;
+        }
+        node = host.substr(1, pos - 1);
+        if (pos + 1 < host.size()) {
+            if (host[pos + 1] != ':') {
+                return false;
+            }
+            service = host.substr(pos + 2);
+        }
+    } else {
+        size_t pos = host.find(':');
+        // 多个':'是不带方括号的ipv6地址
+        if (pos != std::string::npos && host.find(':', pos + 1) == std::string::npos) {
+            node = host.substr(0, pos);
+            service = host.substr(pos + 1);
+        } else {
+            node = host;
+        }
+    }
+    port = 0;
+    if (!service.empty()) {
+        char* end = nullptr;
+        unsigned long v = strtoul(service.c_str(), &end, 10);
+        if (*end || v > 65535) {
+            return false;
+        }
+        port = v;
+    }
+    return !node.empty();
+}
+
+bool Address::Lookup(std::vector<Address::ptr>& result, const std::string& host,
+        int family)
+{
+    std::string node;
+    uint32_t port = 0;
+    if (!SplitHostPort(host, node, port)) {
+        return false;
+    }
+
+    sockaddr_in addr4;
+    memset(&addr4, 0, sizeof(addr4));
+    if ((family == AF_INET || family == AF_UNSPEC)
+            && inet_pton(AF_INET, node.c_str(), &addr4.sin_addr) == 1) {
+        addr4.sin_family = AF_INET;
+        addr4.sin_port = byteswapOnLittleEndian((uint16_t)port);
+        result.push_back(Address::ptr(new IPv4Address(addr4)));
+        return true;
+    }
+    sockaddr_in6 addr6;
+    memset(&addr6, 0, sizeof(addr6));
+    if ((family == AF_INET6 || family == AF_UNSPEC)
+            && inet_pton(AF_INET6, node.c_str(), &addr6.sin6_addr) == 1) {
+        addr6.sin6_family = AF_INET6;
+        addr6.sin6_port = byteswapOnLittleEndian((uint16_t)port);
+        result.push_back(Address::ptr(new IPv6Address(addr6)));
+        return true;
+    }
+
+    std::vector<IPAddress::ptr> addrs;
+    if (DnsMgr::GetInstance()->resolve(node, family, addrs)) {
+        return false;
+    }
+    // 缓存中的地址是共享的, 带端口时复制一份
+    for (auto& i : addrs) {
+        IPAddress::ptr addr = std::dynamic_pointer_cast<IPAddress>(
+                Create(i->getAddr(), i->getAddrLen()));
+        addr->setPort(port);
+        result.push_back(addr);
+    }
+    return !addrs.empty();
+}
+
+Address::ptr Address::LookupAny(const std::string& host, int family)
+{
+    std::vector<Address::ptr> result;
+    if (Lookup(result, host, family)) {
+        return result[0];
+    }
+    return nullptr;
+}
+
+std::shared_ptr<IPAddress> Address::LookupAnyIPAddress(const std::string& host,
+        int family)
+{
+    std::vector<Address::ptr> result;
+    if (Lookup(result, host, family)) {
+        for (auto& i : result) {
+            IPAddress::ptr v = std::dynamic_pointer_cast<IPAddress>(i);
+            if (v) {
+                return v;
+            }
+        }
+    }
+    return nullptr;
+}
+
 std::string Address::toString()
 {
     std::stringstream ss;
@@ -44,11 +172,16 @@ bool Address::operator!=(const Address& rhs) const
     return !(*this == rhs);
 }
 
+IPv4Address::IPv4Address(const sockaddr_in& address)
+{
+    m_addr = address;
+}
+
 IPv4Address::IPv4Address(uint32_t address, uint32_t port)
 {
     memset(&m_addr, 0, sizeof(m_addr));
     m_addr.sin_family = AF_INET;
-    m_addr.sin_port = byteswapOnLittleEndian(port);
+    m_addr.sin_port = byteswapOnLittleEndian((uint16_t)port);
     m_addr.sin_addr.s_addr = byteswapOnLittleEndian(address);
 }
 
@@ -99,7 +232,7 @@ uint32_t IPv4Address::getPort() const
 
 void IPv4Address::setPort(uint32_t v)
 {
-    m_addr.sin_port = byteswapOnLittleEndian(v);
+    m_addr.sin_port = byteswapOnLittleEndian((uint16_t)v);
 }
 
 IPv6Address::IPv6Address()
@@ -108,11 +241,16 @@ IPv6Address::IPv6Address()
     m_addr.sin6_family = AF_INET6;
 }
 
+IPv6Address::IPv6Address(const sockaddr_in6& address)
+{
+    m_addr = address;
+}
+
 IPv6Address::IPv6Address(const char* address, uint32_t port)
 {
     memset(&m_addr, 0, sizeof(m_addr));
     m_addr.sin6_family = AF_INET6;
-    m_addr.sin6_port = byteswapOnLittleEndian(port);
+    m_addr.sin6_port = byteswapOnLittleEndian((uint16_t)port);
     memcpy(&m_addr.sin6_addr.s6_addr, address, 16);
 }
 
@@ -173,7 +311,7 @@ uint32_t IPv6Address::getPort() const
 
 void IPv6Address::setPort(uint32_t v)
 {
-    m_addr.sin6_port = byteswapOnLittleEndian(v);
+    m_addr.sin6_port = byteswapOnLittleEndian((uint16_t)v);
 }
 
 static const size_t MAX_PATH_LEN = sizeof(((sockaddr_un*)0)->sun_path) - 1;
@@ -228,6 +366,11 @@ UnknowAddress::UnknowAddress(int family)
     m_addr.sa_family = family;
 }
 
+UnknowAddress::UnknowAddress(const sockaddr& addr)
+{
+    m_addr = addr;
+}
+
 const sockaddr* UnknowAddress::getAddr() const
 {
     return &m_addr;
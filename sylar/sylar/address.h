@@ -8,14 +8,50 @@
 #include <iostream>
 #include <netinet/in.h>
 #include <sys/un.h>
+#include <vector>
 
 namespace sylar
 {
 
+class IPAddress;
+
 class Address
 {
 public:
     typedef std::shared_ptr<Address> ptr;
+
+    /**
+     * @brief 通过sockaddr创建Address
+     * @param[in] addr sockaddr指针
+     * @param[in] addrlen sockaddr的长度
+     * @return 返回和sockaddr相匹配的Address, 失败返回nullptr
+     */
+    static Address::ptr Create(const sockaddr* addr, socklen_t addrlen);
+
+    /**
+     * @brief 通过host地址返回对应条件的所有Address
+     * @param[out] result 保存满足条件的Address
+     * @param[in] host 域名,服务器名等. 举例: www.sylar.top[:80] (方括号为可选内容)
+     * @param[in] family 协议族(AF_INET, AF_INET6, AF_UNSPEC)
+     * @details 数字地址直接解析, 其余先查/etc/hosts, 再通过DnsMgr在协程内异步查询
+     * @return 返回是否转换成功
+     */
+    static bool Lookup(std::vector<Address::ptr>& result, const std::string& host,
+            int family = AF_INET);
+
+    /**
+     * @brief 通过host地址返回对应条件的任意Address
+     * @return 返回满足条件的任意Address,失败返回nullptr
+     */
+    static Address::ptr LookupAny(const std::string& host, int family = AF_INET);
+
+    /**
+     * @brief 通过host地址返回对应条件的任意IPAddress
+     * @return 返回满足条件的任意IPAddress,失败返回nullptr
+     */
+    static std::shared_ptr<IPAddress> LookupAnyIPAddress(const std::string& host,
+            int family = AF_INET);
+
     virtual ~Address() {}
 
     int getFamily() const;
@@ -49,6 +85,7 @@ class IPv4Address : public IPAddress
 public:
     typedef std::shared_ptr<IPv4Address> ptr;
 
+    IPv4Address(const sockaddr_in& address);
     IPv4Address(uint32_t address = INADDR_ANY, uint32_t port = 0);
 
     virtual const sockaddr* getAddr() const override;
@@ -70,6 +107,7 @@ class IPv6Address : public IPAddress
 public:
     typedef std::shared_ptr<IPv6Address> ptr;
     IPv6Address();
+    IPv6Address(const sockaddr_in6& address);
     IPv6Address(const char* address, uint32_t port = 0);
 
     virtual const sockaddr* getAddr() const override;
@@ -107,6 +145,7 @@ public:
     typedef std::shared_ptr<UnknowAddress> ptr;
 
     UnknowAddress(int family);
+    UnknowAddress(const sockaddr& addr);
     virtual const sockaddr* getAddr() const override;
     virtual socklen_t getAddrLen() const override;
     virtual std::ostream& insert(std::ostream& os) const override;
@@ -0,0 +1,659 @@
+#include "binlog.h"
+#include <algorithm>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <limits.h>
+#include <sched.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#include "ring_buffer.h"
+#include "util.h"
+
+namespace sylar {
+
+static const char s_magic[] = "SYLARBL1";
+static const size_t s_magic_size = 8;
+
+struct BinLogger::ThreadBuffer {
+    typedef std::shared_ptr<ThreadBuffer> ptr;
+
+    ThreadBuffer(size_t size)
+        :ring(size)
+        ,dropped(0)
+        ,orphan(false) {
+    }
+
+    SpscRingBuffer ring;
+    /// 丢弃数量, 只有所属线程写入
+    std::atomic<uint64_t> dropped;
+    /// 所属线程已退出
+    std::atomic<bool> orphan;
+};
+
+template<class T>
+static void Put(std::string& out, T v)
+{
+    out.append((const char*)&v, sizeof(v));
+}
+
+/**
+ * @brief 写出全部iovec, 出错时丢弃剩余数据
+ */
+static void WriteAll(int fd, iovec* iov, int cnt)
+{
+    while (cnt > 0)
+    {
+        ssize_t n = writev(fd, iov, std::min(cnt, IOV_MAX));
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        while (cnt > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            ++iov;
+            --cnt;
+        }
+        if (cnt > 0)
+        {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+
+template<class T>
+static T Get(const char* p)
+{
+    T v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+BinLogger::BinLogger()
+    : m_level((int)LogLevel::Level::DEBUG)
+    , m_running(false)
+    , m_notified(false)
+    , m_stopping(false)
+{
+}
+
+BinLogger::~BinLogger()
+{
+    close();
+}
+
+bool BinLogger::open(const std::string& filename, size_t buffer_size, uint32_t flush_interval)
+{
+    if (m_thread)
+    {
+        return false;
+    }
+    m_fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd == -1)
+    {
+        std::cout << "BinLogger open " << filename << " failed errno="
+                  << errno << " errstr=" << strerror(errno) << std::endl;
+        return false;
+    }
+    if (::write(m_fd, s_magic, s_magic_size) != (ssize_t)s_magic_size)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_bufferSize = buffer_size;
+    m_flushInterval = flush_interval ? flush_interval : 1;
+    m_emitted.clear();
+    m_stopping = false;
+    m_thread.reset(new Thread(std::bind(&BinLogger::run, this), "binlog"));
+    m_running = true;
+    return true;
+}
+
+void BinLogger::close()
+{
+    if (!m_thread)
+    {
+        return;
+    }
+    m_running = false;
+    m_stopping = true;
+    m_sem.notify();
+    m_thread->join();
+    m_thread.reset();
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+uint32_t BinLogger::registerSite(LogLevel::Level level, const char* file, int32_t line
+                                 ,const char* fmt, const char* types)
+{
+    Site site;
+    site.level = level;
+    site.file = file;
+    site.line = line;
+    site.fmt = fmt;
+    site.types = types;
+    Mutex::Lock lock(m_sitesMutex);
+    m_sites.push_back(site);
+    return m_sites.size() - 1;
+}
+
+BinLogger::ThreadBuffer* BinLogger::getBuffer()
+{
+    // 线程退出时把缓冲区交给后台线程写完后回收
+    struct BufferHolder {
+        ThreadBuffer::ptr buf;
+
+        ~BufferHolder() {
+            if (buf) {
+                buf->orphan = true;
+            }
+        }
+    };
+    static thread_local BufferHolder t_holder;
+    if (!t_holder.buf)
+    {
+        t_holder.buf.reset(new ThreadBuffer(m_bufferSize));
+        Mutex::Lock lock(m_buffersMutex);
+        m_buffers.push_back(t_holder.buf);
+    }
+    return t_holder.buf.get();
+}
+
+void BinLogger::commit(uint32_t id, char* buf, size_t len)
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t ns = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    uint32_t tid = GetThreadId();
+    uint16_t size = len - binlog::s_header_size;
+    buf[0] = 'R';
+    memcpy(buf + 1, &id, sizeof(id));
+    memcpy(buf + 5, &tid, sizeof(tid));
+    memcpy(buf + 9, &ns, sizeof(ns));
+    memcpy(buf + 17, &size, sizeof(size));
+
+    ThreadBuffer* tb = getBuffer();
+    SpscRingBuffer& ring = tb->ring;
+    if (!ring.push(buf, len))
+    {
+        tb->dropped.store(tb->dropped.load(std::memory_order_relaxed) + 1
+                          ,std::memory_order_relaxed);
+        wakeup();
+    }
+    else if (ring.producerSize() > ring.capacity() / 2)
+    {
+        wakeup();
+    }
+}
+
+void BinLogger::wakeup()
+{
+    if (!m_notified.load(std::memory_order_relaxed) && !m_notified.exchange(true))
+    {
+        m_sem.notify();
+    }
+}
+
+void BinLogger::flush()
+{
+    std::vector<std::pair<ThreadBuffer::ptr, uint64_t> > targets;
+    {
+        Mutex::Lock lock(m_buffersMutex);
+        for (auto& i : m_buffers)
+        {
+            targets.push_back(std::make_pair(i, i->ring.getHead()));
+        }
+    }
+    for (auto& i : targets)
+    {
+        while (m_thread && i.first->ring.getTail() < i.second)
+        {
+            wakeup();
+            sched_yield();
+        }
+    }
+}
+
+uint64_t BinLogger::getDropped()
+{
+    Mutex::Lock lock(m_buffersMutex);
+    uint64_t dropped = m_orphanDropped;
+    for (auto& i : m_buffers)
+    {
+        dropped += i->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+/**
+ * @brief 从环形缓冲区的两段中读取, 数据可能跨越回绕点
+ */
+static void ReadIov(const iovec* iov, size_t offset, char* dst, size_t len)
+{
+    if (offset < iov[0].iov_len)
+    {
+        size_t n = std::min(len, iov[0].iov_len - offset);
+        memcpy(dst, (const char*)iov[0].iov_base + offset, n);
+        dst += n;
+        len -= n;
+        offset = 0;
+    }
+    else
+    {
+        offset -= iov[0].iov_len;
+    }
+    if (len)
+    {
+        memcpy(dst, (const char*)iov[1].iov_base + offset, len);
+    }
+}
+
+void BinLogger::emitSite(uint32_t id)
+{
+    Site site;
+    {
+        Mutex::Lock lock(m_sitesMutex);
+        site = m_sites[id];
+    }
+    if (id >= m_emitted.size())
+    {
+        m_emitted.resize(id + 1);
+    }
+    m_emitted[id] = true;
+    uint16_t file_len = strlen(site.file);
+    uint16_t fmt_len = strlen(site.fmt);
+    uint8_t types_len = strlen(site.types);
+    m_out.push_back('D');
+    Put<uint32_t>(m_out, id);
+    Put<uint8_t>(m_out, (uint8_t)site.level);
+    Put<uint32_t>(m_out, site.line);
+    Put<uint16_t>(m_out, file_len);
+    m_out.append(site.file, file_len);
+    Put<uint16_t>(m_out, fmt_len);
+    m_out.append(site.fmt, fmt_len);
+    Put<uint8_t>(m_out, types_len);
+    m_out.append(site.types, types_len);
+}
+
+size_t BinLogger::drain()
+{
+    std::vector<ThreadBuffer::ptr> buffers;
+    uint64_t dropped = 0;
+    {
+        Mutex::Lock lock(m_buffersMutex);
+        for (auto it = m_buffers.begin(); it != m_buffers.end();)
+        {
+            ThreadBuffer::ptr& buf = *it;
+            if (buf->orphan && buf->ring.size() == 0)
+            {
+                m_orphanDropped += buf->dropped.load(std::memory_order_relaxed);
+                it = m_buffers.erase(it);
+                continue;
+            }
+            dropped += buf->dropped.load(std::memory_order_relaxed);
+            buffers.push_back(buf);
+            ++it;
+        }
+        dropped += m_orphanDropped;
+    }
+
+    // 记录直接从环形缓冲区写出, 只扫描记录头找出新出现的id, 字典写在本批记录之前
+    m_out.clear();
+    std::vector<iovec> iovs(1);
+    std::vector<size_t> lens;
+    size_t total = 0;
+    for (auto& buf : buffers)
+    {
+        iovec iov[2];
+        int cnt = buf->ring.peek(iov);
+        size_t len = 0;
+        for (int i = 0; i < cnt; ++i)
+        {
+            iovs.push_back(iov[i]);
+            len += iov[i].iov_len;
+        }
+        // 记录是整条写入的, 缓冲区中总是完整的记录
+        size_t offset = 0;
+        while (offset < len)
+        {
+            char header[binlog::s_header_size];
+            ReadIov(iov, offset, header, sizeof(header));
+            uint32_t id = Get<uint32_t>(header + 1);
+            if (id >= m_emitted.size() || !m_emitted[id])
+            {
+                emitSite(id);
+            }
+            offset += binlog::s_header_size + Get<uint16_t>(header + 17);
+        }
+        lens.push_back(len);
+        total += len;
+    }
+
+    size_t dict_len = m_out.size();
+    if (dropped > m_reportedDropped)
+    {
+        m_out.push_back('L');
+        Put<uint64_t>(m_out, dropped - m_reportedDropped);
+        m_reportedDropped = dropped;
+        iovec iov;
+        iov.iov_base = &m_out[dict_len];
+        iov.iov_len = m_out.size() - dict_len;
+        iovs.push_back(iov);
+    }
+    iovs[0].iov_base = &m_out[0];
+    iovs[0].iov_len = dict_len;
+
+    WriteAll(m_fd, &iovs[0], iovs.size());
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        if (lens[i])
+        {
+            buffers[i]->ring.consume(lens[i]);
+        }
+    }
+    return total;
+}
+
+void BinLogger::run()
+{
+    while (true)
+    {
+        m_notified = false;
+        if (drain() == 0)
+        {
+            if (m_stopping)
+            {
+                break;
+            }
+            m_sem.waitFor(m_flushInterval);
+        }
+    }
+}
+
+/**
+ * @brief 读取一个编码后的参数
+ */
+struct BinLogArg
+{
+    char type = 0;
+    int64_t i = 0;
+    uint64_t u = 0;
+    double f = 0;
+    std::string s;
+};
+
+std::string BinLogDecoder::Render(const std::string& fmt, const std::string& types
+                                  ,const char* args, size_t len)
+{
+    std::string rt;
+    size_t idx = 0;
+    const char* end = args + len;
+    char tmp[512];
+    for (size_t i = 0; i < fmt.size(); ++i)
+    {
+        if (fmt[i] != '%')
+        {
+            rt.push_back(fmt[i]);
+            continue;
+        }
+        if (i + 1 < fmt.size() && fmt[i + 1] == '%')
+        {
+            rt.push_back('%');
+            ++i;
+            continue;
+        }
+        // 解析%[flags][width][.precision][length]conversion, 去掉长度修饰符
+        size_t begin = i++;
+        std::string spec = "%";
+        while (i < fmt.size() && strchr("-+ #0", fmt[i]))
+        {
+            spec.push_back(fmt[i++]);
+        }
+        while (i < fmt.size() && (isdigit(fmt[i]) || fmt[i] == '.'))
+        {
+            spec.push_back(fmt[i++]);
+        }
+        while (i < fmt.size() && strchr("hlLqjzt", fmt[i]))
+        {
+            ++i;
+        }
+        if (i >= fmt.size())
+        {
+            rt.append(fmt, begin, std::string::npos);
+            break;
+        }
+        char conv = fmt[i];
+
+        BinLogArg arg;
+        if (idx >= types.size())
+        {
+            rt.append(fmt, begin, i - begin + 1);
+            continue;
+        }
+        arg.type = types[idx++];
+        if (arg.type == 's')
+        {
+            if (args + 2 > end)
+            {
+                break;
+            }
+            uint16_t n = Get<uint16_t>(args);
+            if (args + 2 + n > end)
+            {
+                break;
+            }
+            arg.s.assign(args + 2, n);
+            args += 2 + n;
+        }
+        else
+        {
+            if (args + 8 > end)
+            {
+                break;
+            }
+            arg.u = Get<uint64_t>(args);
+            arg.i = (int64_t)arg.u;
+            memcpy(&arg.f, &arg.u, sizeof(arg.f));
+            args += 8;
+        }
+
+        // 参数类型和转换符不一致时按数值转换
+        int n = 0;
+        switch (conv)
+        {
+            case 'd':
+            case 'i':
+                spec += "ll";
+                spec.push_back(conv);
+                n = snprintf(tmp, sizeof(tmp), spec.c_str()
+                             ,(long long)(arg.type == 'f' ? (int64_t)arg.f : arg.i));
+                break;
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                spec += "ll";
+                spec.push_back(conv);
+                n = snprintf(tmp, sizeof(tmp), spec.c_str()
+                             ,(unsigned long long)(arg.type == 'f' ? (uint64_t)arg.f : arg.u));
+                break;
+            case 'c':
+                spec.push_back(conv);
+                n = snprintf(tmp, sizeof(tmp), spec.c_str(), (int)arg.i);
+                break;
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                spec.push_back(conv);
+                n = snprintf(tmp, sizeof(tmp), spec.c_str()
+                             ,arg.type == 'f' ? arg.f : arg.type == 'u' ? (double)arg.u : (double)arg.i);
+                break;
+            case 'p':
+                spec.push_back(conv);
+                n = snprintf(tmp, sizeof(tmp), spec.c_str(), (void*)(uintptr_t)arg.u);
+                break;
+            case 's':
+                if (arg.type != 's')
+                {
+                    arg.s = arg.type == 'f' ? std::to_string(arg.f)
+                        : arg.type == 'u' ? std::to_string(arg.u) : std::to_string(arg.i);
+                }
+                if (spec.size() == 1)
+                {
+                    rt.append(arg.s);
+                }
+                else
+                {
+                    spec.push_back(conv);
+                    n = snprintf(tmp, sizeof(tmp), spec.c_str(), arg.s.c_str());
+                }
+                break;
+            default:
+                rt.append(fmt, begin, i - begin + 1);
+                break;
+        }
+        if (n > 0)
+        {
+            rt.append(tmp, std::min((size_t)n, sizeof(tmp) - 1));
+        }
+    }
+    return rt;
+}
+
+bool BinLogDecoder::Decode(const std::string& filename, std::ostream& os)
+{
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs)
+    {
+        return false;
+    }
+    return Decode(ifs, os);
+}
+
+bool BinLogDecoder::Decode(std::istream& is, std::ostream& os)
+{
+    std::string data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    if (data.size() < s_magic_size || memcmp(data.data(), s_magic, s_magic_size))
+    {
+        return false;
+    }
+    struct DecodedSite {
+        LogLevel::Level level = LogLevel::Level::UNKNOW;
+        std::string file;
+        uint32_t line = 0;
+        std::string fmt;
+        std::string types;
+    };
+    std::vector<DecodedSite> sites;
+    const char* p = data.data() + s_magic_size;
+    const char* end = data.data() + data.size();
+    std::string line;
+    while (p < end)
+    {
+        char type = *p;
+        if (type == 'D')
+        {
+            if (p + 12 > end)
+            {
+                break;
+            }
+            DecodedSite site;
+            uint32_t id = Get<uint32_t>(p + 1);
+            site.level = (LogLevel::Level)Get<uint8_t>(p + 5);
+            site.line = Get<uint32_t>(p + 6);
+            const char* q = p + 10;
+            uint16_t file_len = Get<uint16_t>(q);
+            if (q + 2 + file_len + 2 > end)
+            {
+                break;
+            }
+            site.file.assign(q + 2, file_len);
+            q += 2 + file_len;
+            uint16_t fmt_len = Get<uint16_t>(q);
+            if (q + 2 + fmt_len + 1 > end)
+            {
+                break;
+            }
+            site.fmt.assign(q + 2, fmt_len);
+            q += 2 + fmt_len;
+            uint8_t types_len = *q;
+            if (q + 1 + types_len > end)
+            {
+                break;
+            }
+            site.types.assign(q + 1, types_len);
+            q += 1 + types_len;
+            if (id >= sites.size())
+            {
+                sites.resize(id + 1);
+            }
+            sites[id] = site;
+            p = q;
+        }
+        else if (type == 'R')
+        {
+            if (p + binlog::s_header_size > end)
+            {
+                break;
+            }
+            uint32_t id = Get<uint32_t>(p + 1);
+            uint32_t tid = Get<uint32_t>(p + 5);
+            uint64_t ns = Get<uint64_t>(p + 9);
+            uint16_t len = Get<uint16_t>(p + 17);
+            const char* args = p + binlog::s_header_size;
+            if (args + len > end)
+            {
+                break;
+            }
+            p = args + len;
+            if (id >= sites.size())
+            {
+                return false;
+            }
+            const DecodedSite& site = sites[id];
+            time_t second = ns / 1000000000ull;
+            struct tm tm;
+            localtime_r(&second, &tm);
+            char tbuf[64];
+            size_t tlen = strftime(tbuf, sizeof(tbuf), "%Y-%m-%d %H:%M:%S", &tm);
+            tlen += snprintf(tbuf + tlen, sizeof(tbuf) - tlen, ".%06u", (unsigned)(ns % 1000000000ull / 1000));
+            line.assign(tbuf, tlen);
+            line += "\t" + std::to_string(tid) + "\t[" + LogLevel::ToString(site.level) + "]\t"
+                + site.file + ":" + std::to_string(site.line) + "\t"
+                + Render(site.fmt, site.types, args, len) + "\n";
+            os << line;
+        }
+        else if (type == 'L')
+        {
+            if (p + 9 > end)
+            {
+                break;
+            }
+            os << "BinLogger dropped " << Get<uint64_t>(p + 1) << " records\n";
+            p += 9;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
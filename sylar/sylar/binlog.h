@@ -0,0 +1,334 @@
+/**
+ * @file binlog.h
+ * @brief 二进制延迟格式化日志
+ * @details 调用点在第一次执行时注册格式串, 之后只把格式id和参数的原始字节写入线程自己的
+ *          环形缓冲区, 不做任何文本格式化. 后台线程把记录和首次出现的格式串字典写入文件,
+ *          由log_decoder工具离线还原成文本
+ *
+ *          文件格式(小端):
+ *          - 文件头 "SYLARBL1"
+ *          - 'D' 字典: u32 id, u8 level, u32 line, u16+文件名, u16+格式串, u8+参数类型
+ *          - 'R' 记录: u32 id, u32 线程id, u64 纳秒时间戳, u16 参数长度, 参数
+ *          - 'L' 丢弃: u64 新增的丢弃条数
+ */
+#ifndef __SYLAR_BINLOG_H__
+#define __SYLAR_BINLOG_H__
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "log.h"
+#include "mutex.h"
+#include "noncopyable.h"
+#include "singleton.h"
+#include "thread.h"
+
+/**
+ * @brief 写二进制日志, 格式串为printf风格, 必须是字符串常量
+ * @details 支持整数, 枚举, 浮点数, 字符串(const char*, std::string)和指针参数,
+ *          不支持*宽度
+ */
+#define SYLAR_BINLOG_LEVEL(level, fmt, ...) \
+    do { \
+        sylar::BinLogger* sylar_binlog = sylar::BinLogMgr::GetInstance(); \
+        if (SYLAR_LOG_COMPILED(level) && sylar_binlog->isEnabled(level)) { \
+            static const uint32_t s_sylar_binlog_id = sylar_binlog->registerSite(level, __FILE__, __LINE__, fmt \
+                    , sylar::binlog::TypesOf<decltype(sylar::binlog::MakeTypes(fmt, ##__VA_ARGS__))>::Get()); \
+            sylar_binlog->write(s_sylar_binlog_id, fmt, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define SYLAR_BINLOG_DEBUG(fmt, ...) SYLAR_BINLOG_LEVEL(sylar::LogLevel::Level::DEBUG, fmt, ##__VA_ARGS__)
+#define SYLAR_BINLOG_INFO(fmt, ...) SYLAR_BINLOG_LEVEL(sylar::LogLevel::Level::INFO, fmt, ##__VA_ARGS__)
+#define SYLAR_BINLOG_WARN(fmt, ...) SYLAR_BINLOG_LEVEL(sylar::LogLevel::Level::WARN, fmt, ##__VA_ARGS__)
+#define SYLAR_BINLOG_ERROR(fmt, ...) SYLAR_BINLOG_LEVEL(sylar::LogLevel::Level::ERROR, fmt, ##__VA_ARGS__)
+#define SYLAR_BINLOG_FATAL(fmt, ...) SYLAR_BINLOG_LEVEL(sylar::LogLevel::Level::FATAL, fmt, ##__VA_ARGS__)
+
+namespace sylar {
+
+namespace binlog {
+
+/// 记录头长度: 类型, id, 线程id, 时间戳, 参数长度
+static const size_t s_header_size = 1 + 4 + 4 + 8 + 2;
+/// 单条记录的最大长度, 超长的字符串参数被截断
+static const size_t s_max_record = 2048;
+/// 单个参数除字符串内容外的最大长度
+static const size_t s_max_arg_size = 8;
+
+/**
+ * @brief 参数编码, 未支持的类型在编译期报错
+ */
+template<class T, class Enable = void>
+struct ArgTraits;
+
+template<class T>
+struct ArgTraits<T, typename std::enable_if<(std::is_integral<T>::value && std::is_signed<T>::value)
+                                            || std::is_enum<T>::value>::type> {
+    static const char type = 'i';
+    static void Encode(char* buf, size_t& pos, size_t, T v) {
+        int64_t x = (int64_t)v;
+        memcpy(buf + pos, &x, sizeof(x));
+        pos += sizeof(x);
+    }
+};
+
+template<class T>
+struct ArgTraits<T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type> {
+    static const char type = 'u';
+    static void Encode(char* buf, size_t& pos, size_t, T v) {
+        uint64_t x = v;
+        memcpy(buf + pos, &x, sizeof(x));
+        pos += sizeof(x);
+    }
+};
+
+template<class T>
+struct ArgTraits<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+    static const char type = 'f';
+    static void Encode(char* buf, size_t& pos, size_t, T v) {
+        double x = v;
+        memcpy(buf + pos, &x, sizeof(x));
+        pos += sizeof(x);
+    }
+};
+
+/**
+ * @brief 字符串: u16长度 + 内容, limit为本参数可用的最大字节数
+ */
+inline void EncodeString(char* buf, size_t& pos, size_t limit, const char* str, size_t len) {
+    if (len + 2 > limit) {
+        len = limit - 2;
+    }
+    uint16_t n = len;
+    memcpy(buf + pos, &n, sizeof(n));
+    memcpy(buf + pos + 2, str, len);
+    pos += 2 + len;
+}
+
+template<class T>
+struct ArgTraits<T, typename std::enable_if<std::is_same<T, const char*>::value
+                                            || std::is_same<T, char*>::value>::type> {
+    static const char type = 's';
+    static void Encode(char* buf, size_t& pos, size_t limit, const char* v) {
+        if (!v) {
+            v = "(null)";
+        }
+        EncodeString(buf, pos, limit, v, strlen(v));
+    }
+};
+
+template<>
+struct ArgTraits<std::string> {
+    static const char type = 's';
+    static void Encode(char* buf, size_t& pos, size_t limit, const std::string& v) {
+        EncodeString(buf, pos, limit, v.data(), v.size());
+    }
+};
+
+template<class T>
+struct ArgTraits<T, typename std::enable_if<std::is_pointer<T>::value
+                                            && !std::is_same<T, const char*>::value
+                                            && !std::is_same<T, char*>::value>::type> {
+    static const char type = 'p';
+    static void Encode(char* buf, size_t& pos, size_t, T v) {
+        uint64_t x = (uintptr_t)v;
+        memcpy(buf + pos, &x, sizeof(x));
+        pos += sizeof(x);
+    }
+};
+
+/**
+ * @brief 参数类型列表
+ */
+template<class... Args>
+struct TypeList {};
+
+/**
+ * @brief 只用于decltype推导参数类型, 参数不会被求值
+ */
+template<class... Args>
+TypeList<typename std::decay<Args>::type...> MakeTypes(const char* fmt, Args&&... args);
+
+template<class T>
+struct TypesOf;
+
+/**
+ * @brief 参数类型字符串, 每个参数一个字符
+ */
+template<class... Args>
+struct TypesOf<TypeList<Args...> > {
+    static const char* Get() {
+        static const char s_types[] = {ArgTraits<Args>::type..., '\0'};
+        return s_types;
+    }
+};
+
+inline void Encode(char*, size_t&) {
+}
+
+template<class T, class... Rest>
+inline void Encode(char* buf, size_t& pos, const T& v, const Rest&... rest) {
+    typedef typename std::decay<T>::type Type;
+    // 给后面的参数留出空间
+    size_t limit = s_max_record - pos - sizeof...(Rest) * (s_max_arg_size + 2);
+    ArgTraits<Type>::Encode(buf, pos, limit, v);
+    Encode(buf, pos, rest...);
+}
+
+}
+
+/**
+ * @brief 二进制日志写入器
+ */
+class BinLogger : Noncopyable {
+public:
+    /**
+     * @brief 调用点信息
+     */
+    struct Site {
+        LogLevel::Level level;
+        const char* file;
+        int32_t line;
+        const char* fmt;
+        const char* types;
+    };
+
+    BinLogger();
+
+    /**
+     * @brief 析构函数, 写出剩余日志后退出后台线程
+     */
+    ~BinLogger();
+
+    /**
+     * @brief 打开输出文件并启动后台线程
+     * @param[in] filename 输出文件, 截断写入
+     * @param[in] buffer_size 每个线程的缓冲区大小, 只对之后创建的缓冲区生效
+     * @param[in] flush_interval 后台线程空闲时的刷新间隔(毫秒)
+     */
+    bool open(const std::string& filename
+              ,size_t buffer_size = 1024 * 1024
+              ,uint32_t flush_interval = 10);
+
+    /**
+     * @brief 写出剩余日志, 关闭文件
+     */
+    void close();
+
+    /**
+     * @brief 等待调用前写入的日志全部输出
+     */
+    void flush();
+
+    bool isEnabled(LogLevel::Level level) const {
+        return (int)level >= m_level.load(std::memory_order_relaxed)
+            && m_running.load(std::memory_order_relaxed);
+    }
+
+    void setLevel(LogLevel::Level level) { m_level = (int)level;}
+
+    /**
+     * @brief 注册调用点, 每个调用点只调用一次
+     * @return 格式id
+     */
+    uint32_t registerSite(LogLevel::Level level, const char* file, int32_t line
+                          ,const char* fmt, const char* types);
+
+    /**
+     * @brief 编码参数写入当前线程的缓冲区, 缓冲区满时丢弃
+     */
+    template<class... Args>
+    void write(uint32_t id, const char*, const Args&... args) {
+        static_assert(binlog::s_header_size + sizeof...(Args) * (binlog::s_max_arg_size + 2)
+                      <= binlog::s_max_record, "too many binlog arguments");
+        char buf[binlog::s_max_record];
+        size_t pos = binlog::s_header_size;
+        binlog::Encode(buf, pos, args...);
+        commit(id, buf, pos);
+    }
+
+    /**
+     * @brief 返回丢弃的日志条数
+     */
+    uint64_t getDropped();
+private:
+    struct ThreadBuffer;
+
+    /**
+     * @brief 填写记录头并写入当前线程的缓冲区
+     */
+    void commit(uint32_t id, char* buf, size_t len);
+
+    ThreadBuffer* getBuffer();
+
+    void run();
+
+    /**
+     * @brief 输出所有缓冲区中的记录, 必要时先输出字典
+     * @return 输出的字节数
+     */
+    size_t drain();
+
+    /**
+     * @brief 把调用点字典追加到输出缓冲
+     */
+    void emitSite(uint32_t id);
+
+    void wakeup();
+private:
+    std::atomic<int> m_level;
+    std::atomic<bool> m_running;
+    int m_fd = -1;
+    size_t m_bufferSize = 1024 * 1024;
+    uint32_t m_flushInterval = 10;
+
+    /// 调用点注册锁, 只在调用点第一次执行和输出字典时使用
+    Mutex m_sitesMutex;
+    std::vector<Site> m_sites;
+    /// 已输出字典的id, 只有后台线程访问
+    std::vector<bool> m_emitted;
+
+    Mutex m_buffersMutex;
+    std::vector<std::shared_ptr<ThreadBuffer> > m_buffers;
+    uint64_t m_orphanDropped = 0;
+    /// 已写入文件的丢弃数量, 只有后台线程访问
+    uint64_t m_reportedDropped = 0;
+    /// 字典输出缓冲, 只有后台线程访问
+    std::string m_out;
+
+    Semaphore m_sem;
+    std::atomic<bool> m_notified;
+    std::atomic<bool> m_stopping;
+    Thread::ptr m_thread;
+};
+
+typedef Singleton<BinLogger> BinLogMgr;
+
+/**
+ * @brief 二进制日志解码
+ */
+class BinLogDecoder {
+public:
+    /**
+     * @brief 解码文件, 每条记录输出一行文本
+     * @return 文件格式是否正确, 末尾不完整的记录被忽略
+     */
+    static bool Decode(const std::string& filename, std::ostream& os);
+
+    static bool Decode(std::istream& is, std::ostream& os);
+
+    /**
+     * @brief 按printf格式串和编码后的参数生成消息
+     */
+    static std::string Render(const std::string& fmt, const std::string& types
+                              ,const char* args, size_t len);
+};
+
+}
+
+#endif
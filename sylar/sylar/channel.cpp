@@ -0,0 +1,85 @@
+#include "channel.h"
+#include <algorithm>
+#include "iomanager.h"
+#include "scheduler.h"
+
+namespace sylar {
+
+ChannelWaiter::ChannelWaiter()
+    :scheduler(Scheduler::GetThis())
+    ,fiber(Fiber::GetThis())
+    ,m_fired(false) {
+    SYLAR_ASSERT(scheduler);
+}
+
+void ChannelWaiter::wake() {
+    scheduler->schedule(fiber);
+}
+
+int ChannelBase::Wait(const ChannelWaiter::ptr& w, uint64_t timeout_ms) {
+    Timer::ptr timer;
+    if(timeout_ms != ~0ull) {
+        IOManager* iom = IOManager::GetThis();
+        SYLAR_ASSERT2(iom, "channel timeout needs IOManager");
+        timer = iom->addTimer(timeout_ms, [w](){
+            if(w->claim()) {
+                w->index = -1;
+                w->wake();
+            }
+        });
+    }
+    // 认领者唤醒时可能还没切出, 调度器会等协程切出后再执行
+    Fiber::YieldToHold();
+    if(timer) {
+        timer->cancel();
+    }
+    return w->index;
+}
+
+int ChannelSelect::wait(uint64_t timeout_ms) {
+    // 按地址顺序加锁避免死锁, 同一个通道只锁一次
+    std::vector<ChannelBase*> channels;
+    for(auto& i : m_cases) {
+        channels.push_back(i.channel.get());
+    }
+    std::sort(channels.begin(), channels.end());
+    channels.erase(std::unique(channels.begin(), channels.end()), channels.end());
+
+    ChannelWaiter::ptr wake;
+    ChannelWaiter::ptr w;
+    int index = -1;
+    for(auto i : channels) {
+        i->getMutex().lock();
+    }
+    // 持有所有锁时等待者还没注册, 不会被其他协程认领
+    for(size_t i = 0; i < m_cases.size(); ++i) {
+        if(m_cases[i].tryLocked(&m_ok, wake)) {
+            index = i;
+            break;
+        }
+    }
+    if(index < 0 && timeout_ms) {
+        w.reset(new ChannelWaiter);
+        for(size_t i = 0; i < m_cases.size(); ++i) {
+            m_cases[i].enqueueLocked(w, i);
+        }
+    }
+    for(auto i : channels) {
+        i->getMutex().unlock();
+    }
+    if(wake) {
+        wake->wake();
+    }
+    if(!w) {
+        return index;
+    }
+
+    index = ChannelBase::Wait(w, timeout_ms);
+    for(auto i : channels) {
+        i->removeWaiter(w);
+    }
+    m_ok = w->ok;
+    return index;
+}
+
+}
@@ -0,0 +1,394 @@
+/**
+ * @file channel.h
+ * @brief 协程通道
+ * @details 多生产者多消费者的消息通道, 发送和接收在通道满或空时挂起协程而不是线程.
+ *          每条消息只加一次通道锁, 有等待的接收者时发送方直接把值交给它
+ */
+#ifndef __SYLAR_CHANNEL_H__
+#define __SYLAR_CHANNEL_H__
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <vector>
+#include "fiber.h"
+#include "macro.h"
+#include "mutex.h"
+#include "noncopyable.h"
+
+namespace sylar {
+
+class Scheduler;
+
+/**
+ * @brief 挂起在通道上的协程
+ * @details select时同一个等待者会注册到多个通道, 第一个认领(claim)成功的一方
+ *          完成操作并唤醒协程, 其他通道中的记录在协程醒来后删除
+ */
+struct ChannelWaiter {
+    typedef std::shared_ptr<ChannelWaiter> ptr;
+
+    ChannelWaiter();
+
+    /**
+     * @brief 认领等待者, 只有一方能成功
+     */
+    bool claim() { return !m_fired.exchange(true, std::memory_order_acq_rel);}
+
+    /**
+     * @brief 在等待者所属的调度器中唤醒它
+     */
+    void wake();
+
+    Scheduler* scheduler;
+    Fiber::ptr fiber;
+    /// 完成的case序号, -1为超时
+    int index = -1;
+    /// 操作是否成功, 通道关闭时为false
+    bool ok = false;
+private:
+    std::atomic<bool> m_fired;
+};
+
+/**
+ * @brief 通道基类, 提供与元素类型无关的锁和等待
+ */
+class ChannelBase : Noncopyable {
+public:
+    typedef Spinlock MutexType;
+
+    virtual ~ChannelBase() {}
+
+    /**
+     * @brief 删除等待者在本通道中的记录
+     */
+    virtual void removeWaiter(const ChannelWaiter::ptr& w) = 0;
+
+    MutexType& getMutex() { return m_mutex;}
+
+    /**
+     * @brief 挂起当前协程直到被认领或超时
+     * @param[in] w 已注册到通道中的等待者
+     * @param[in] timeout_ms 超时时间(毫秒), ~0ull为不超时, 需要在IOManager中
+     * @return 完成的case序号, 超时返回-1
+     */
+    static int Wait(const ChannelWaiter::ptr& w, uint64_t timeout_ms);
+protected:
+    MutexType m_mutex;
+};
+
+/**
+ * @brief 协程通道
+ * @details capacity为0时不限长度, 发送不会挂起. 关闭后发送失败, 接收在取完剩余元素后失败.
+ *          超时通过IOManager的定时器实现, timeout_ms为0时不挂起, ~0ull为一直等待
+ * @attention 可能挂起的操作只能在调度器的协程中调用
+ */
+template<class T>
+class Channel : public ChannelBase {
+public:
+    typedef std::shared_ptr<Channel> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] capacity 缓冲区大小, 0为不限
+     */
+    Channel(size_t capacity = 0)
+        :m_capacity(capacity) {
+    }
+
+    ~Channel() {
+        SYLAR_ASSERT(m_receivers.empty() && m_senders.empty());
+    }
+
+    /**
+     * @brief 发送, 缓冲区满时挂起
+     * @return 通道已关闭或超时返回false
+     */
+    bool send(T value, uint64_t timeout_ms = ~0ull) {
+        ChannelWaiter::ptr wake;
+        ChannelWaiter::ptr w;
+        bool ok = false;
+        {
+            MutexType::Lock lock(m_mutex);
+            if(!trySendLocked(&value, &ok, wake) && timeout_ms) {
+                w.reset(new ChannelWaiter);
+                enqueueSendLocked(w, 0, &value);
+            }
+        }
+        if(wake) {
+            wake->wake();
+        }
+        if(!w) {
+            return ok;
+        }
+        if(Wait(w, timeout_ms) < 0) {
+            removeWaiter(w);
+        }
+        return w->ok;
+    }
+
+    /**
+     * @brief 不挂起的发送
+     */
+    bool trySend(T value) {
+        return send(std::move(value), 0);
+    }
+
+    /**
+     * @brief 接收, 通道为空时挂起
+     * @return 通道已关闭且为空或超时返回false
+     */
+    bool recv(T& value, uint64_t timeout_ms = ~0ull) {
+        ChannelWaiter::ptr wake;
+        ChannelWaiter::ptr w;
+        bool ok = false;
+        {
+            MutexType::Lock lock(m_mutex);
+            if(!tryRecvLocked(&value, &ok, wake) && timeout_ms) {
+                w.reset(new ChannelWaiter);
+                enqueueRecvLocked(w, 0, &value);
+            }
+        }
+        if(wake) {
+            wake->wake();
+        }
+        if(!w) {
+            return ok;
+        }
+        if(Wait(w, timeout_ms) < 0) {
+            removeWaiter(w);
+        }
+        return w->ok;
+    }
+
+    /**
+     * @brief 不挂起的接收
+     */
+    bool tryRecv(T& value) {
+        return recv(value, 0);
+    }
+
+    /**
+     * @brief 关闭通道, 唤醒所有等待者, 它们的操作返回false
+     */
+    void close() {
+        std::vector<ChannelWaiter::ptr> wakes;
+        {
+            MutexType::Lock lock(m_mutex);
+            m_closed = true;
+            for(auto& i : m_receivers) {
+                if(i.waiter->claim()) {
+                    i.waiter->index = i.index;
+                    i.waiter->ok = false;
+                    wakes.push_back(i.waiter);
+                }
+            }
+            for(auto& i : m_senders) {
+                if(i.waiter->claim()) {
+                    i.waiter->index = i.index;
+                    i.waiter->ok = false;
+                    wakes.push_back(i.waiter);
+                }
+            }
+            m_receivers.clear();
+            m_senders.clear();
+        }
+        for(auto& i : wakes) {
+            i->wake();
+        }
+    }
+
+    bool isClosed() {
+        MutexType::Lock lock(m_mutex);
+        return m_closed;
+    }
+
+    /**
+     * @brief 返回缓冲区中的元素数量
+     */
+    size_t size() {
+        MutexType::Lock lock(m_mutex);
+        return m_buffer.size();
+    }
+
+    size_t getCapacity() const { return m_capacity;}
+
+    void removeWaiter(const ChannelWaiter::ptr& w) override {
+        MutexType::Lock lock(m_mutex);
+        removeFrom(m_receivers, w);
+        removeFrom(m_senders, w);
+    }
+
+    /**
+     * @brief 尝试立即发送, 需要持有锁
+     * @param[in, out] value 完成时被移走
+     * @param[out] ok 完成时是否成功
+     * @param[out] wake 需要在解锁后唤醒的等待者
+     * @return 是否已完成(成功或通道已关闭)
+     */
+    bool trySendLocked(T* value, bool* ok, ChannelWaiter::ptr& wake) {
+        if(m_closed) {
+            *ok = false;
+            return true;
+        }
+        // 有等待的接收者时缓冲区一定为空, 直接交给接收者
+        while(!m_receivers.empty()) {
+            Entry e = m_receivers.front();
+            m_receivers.pop_front();
+            // 认领失败说明它已被select的其他通道或超时唤醒
+            if(e.waiter->claim()) {
+                *e.value = std::move(*value);
+                e.waiter->index = e.index;
+                e.waiter->ok = true;
+                wake = e.waiter;
+                *ok = true;
+                return true;
+            }
+        }
+        if(m_capacity == 0 || m_buffer.size() < m_capacity) {
+            m_buffer.push_back(std::move(*value));
+            *ok = true;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief 尝试立即接收, 需要持有锁
+     * @return 是否已完成(收到元素或通道已关闭且为空)
+     */
+    bool tryRecvLocked(T* value, bool* ok, ChannelWaiter::ptr& wake) {
+        if(!m_buffer.empty()) {
+            *value = std::move(m_buffer.front());
+            m_buffer.pop_front();
+            // 空出了位置, 把一个等待的发送者的值放入缓冲区
+            while(!m_senders.empty()) {
+                Entry e = m_senders.front();
+                m_senders.pop_front();
+                if(e.waiter->claim()) {
+                    m_buffer.push_back(std::move(*e.value));
+                    e.waiter->index = e.index;
+                    e.waiter->ok = true;
+                    wake = e.waiter;
+                    break;
+                }
+            }
+            *ok = true;
+            return true;
+        }
+        if(m_closed) {
+            *ok = false;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief 注册等待的发送者, 需要持有锁, value在被认领前必须有效
+     */
+    void enqueueSendLocked(const ChannelWaiter::ptr& w, int index, T* value) {
+        m_senders.push_back(Entry{w, value, index});
+    }
+
+    /**
+     * @brief 注册等待的接收者, 需要持有锁, value在被认领前必须有效
+     */
+    void enqueueRecvLocked(const ChannelWaiter::ptr& w, int index, T* value) {
+        m_receivers.push_back(Entry{w, value, index});
+    }
+private:
+    struct Entry {
+        ChannelWaiter::ptr waiter;
+        /// 发送者的值或接收者的输出位置
+        T* value;
+        int index;
+    };
+
+    static void removeFrom(std::list<Entry>& l, const ChannelWaiter::ptr& w) {
+        for(auto it = l.begin(); it != l.end();) {
+            if(it->waiter == w) {
+                it = l.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+private:
+    size_t m_capacity;
+    bool m_closed = false;
+    std::deque<T> m_buffer;
+    std::list<Entry> m_receivers;
+    std::list<Entry> m_senders;
+};
+
+/**
+ * @brief 在多个通道操作中等待第一个完成的
+ * @details 所有通道按地址顺序加锁后依次尝试, 都不能完成时把同一个等待者注册到所有通道.
+ *          只会完成一个操作
+ *
+ *          sylar::ChannelSelect sel;
+ *          sel.recv(ch1, a).recv(ch2, b).send(ch3, c);
+ *          int idx = sel.wait(100);
+ */
+class ChannelSelect : Noncopyable {
+public:
+    /**
+     * @brief 添加接收操作, 完成时结果写入value
+     */
+    template<class T>
+    ChannelSelect& recv(const std::shared_ptr<Channel<T> >& ch, T& value) {
+        Channel<T>* c = ch.get();
+        T* v = &value;
+        m_cases.push_back(Case{ch
+            ,[c, v](bool* ok, ChannelWaiter::ptr& wake) {
+                return c->tryRecvLocked(v, ok, wake);
+            }
+            ,[c, v](const ChannelWaiter::ptr& w, int index) {
+                c->enqueueRecvLocked(w, index, v);
+            }});
+        return *this;
+    }
+
+    /**
+     * @brief 添加发送操作, 值在添加时复制
+     */
+    template<class T>
+    ChannelSelect& send(const std::shared_ptr<Channel<T> >& ch, T value) {
+        Channel<T>* c = ch.get();
+        std::shared_ptr<T> v = std::make_shared<T>(std::move(value));
+        m_cases.push_back(Case{ch
+            ,[c, v](bool* ok, ChannelWaiter::ptr& wake) {
+                return c->trySendLocked(v.get(), ok, wake);
+            }
+            ,[c, v](const ChannelWaiter::ptr& w, int index) {
+                c->enqueueSendLocked(w, index, v.get());
+            }});
+        return *this;
+    }
+
+    /**
+     * @brief 等待一个操作完成
+     * @param[in] timeout_ms 超时时间(毫秒), 0为不挂起, ~0ull为一直等待
+     * @return 完成的操作序号(按添加顺序), 超时返回-1
+     */
+    int wait(uint64_t timeout_ms = ~0ull);
+
+    /**
+     * @brief 完成的操作是否成功, 通道关闭时为false
+     */
+    bool ok() const { return m_ok;}
+private:
+    struct Case {
+        std::shared_ptr<ChannelBase> channel;
+        std::function<bool(bool*, ChannelWaiter::ptr&)> tryLocked;
+        std::function<void(const ChannelWaiter::ptr&, int)> enqueueLocked;
+    };
+    std::vector<Case> m_cases;
+    bool m_ok = false;
+};
+
+}
+
+#endif
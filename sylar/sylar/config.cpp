@@ -1,7 +1,12 @@
 #include "config.h"
+#include <unistd.h>
+#include <algorithm>
+#include "thread.h"
 
 namespace sylar
 {
+std::atomic<size_t> ConfigVarBase::s_index(0);
+
 ConfigVarBase::ptr Config::LookupBase(const std::string& name)
 {
     RWMutexType::ReadLock lock(GetMutex());
@@ -9,8 +14,8 @@ ConfigVarBase::ptr Config::LookupBase(const std::string& name)
     return it == GetDatas().end() ? nullptr : it->second;
 }
 
-static void ListAllMember(const std::string& prefix, const YAML::Node& node, 
-    std::list<std::pair<std::string, YAML::Node>>& output)
+void Config::CollectVars(const std::string& prefix, const YAML::Node& node
+                         ,std::vector<std::pair<ConfigVarBase::ptr, YAML::Node> >& output)
 {
     if (prefix.find_first_not_of("abcdefghijklmnopqrstuvwxyz._123456789") 
                 != std::string::npos)
@@ -18,46 +23,144 @@ static void ListAllMember(const std::string& prefix, const YAML::Node& node,
         SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config invalid name: " << prefix << " : " << node;
         return ;
     }
-    output.push_back(std::make_pair(prefix, node));
+    if (!prefix.empty())
+    {
+        auto it = GetDatas().find(prefix);
+        if (it != GetDatas().end())
+        {
+            output.push_back(std::make_pair(it->second, node));
+        }
+        // 没有以它为前缀的配置项, 整个子树都不用看
+        if (!GetPrefixes().count(prefix))
+        {
+            return ;
+        }
+    }
     if (node.IsMap())
     {
         for (auto it = node.begin(); it != node.end(); ++it)
         {
-            ListAllMember(prefix.empty() ? it->first.Scalar() 
+            CollectVars(prefix.empty() ? it->first.Scalar() 
                 : prefix + "." + it->first.Scalar(), it->second, output);
         }
     }
-
 }
 
 void Config::LoadFromYaml(const YAML::Node& root)
 {
-    std::list<std::pair<std::string, YAML::Node>> all_node;
-    ListAllMember("", root, all_node);
+    std::vector<std::pair<ConfigVarBase::ptr, YAML::Node> > vars;
+    {
+        RWMutexType::ReadLock lock(GetMutex());
+        CollectVars("", root, vars);
+    }
 
-    for (auto& i : all_node)
+    // 监听器中可能会Lookup, 不能持有锁
+    for (auto& i : vars)
     {
-        std::string key = i.first;
-        if (key.empty())
-            continue;
-        
-        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-        ConfigVarBase::ptr var = LookupBase(key);
+        i.first->fromNode(i.second);
+    }
+}
 
-        if (var)
+size_t Config::LoadFromFiles(const std::vector<std::string>& files, size_t threads)
+{
+    if (threads == 0)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n > 0 ? n : 1;
+    }
+    threads = std::min(threads, files.size());
+
+    // 读文件, 解析和转换并行进行, 结果按文件保存
+    std::vector<std::vector<std::function<void()> > > results(files.size());
+    std::vector<char> loaded(files.size(), 0);
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t idx = next++; idx < files.size(); idx = next++)
         {
-            if (i.second.IsScalar())
+            try
             {
-                var->fromString(i.second.Scalar());
+                YAML::Node root = YAML::LoadFile(files[idx]);
+                std::vector<std::pair<ConfigVarBase::ptr, YAML::Node> > vars;
+                {
+                    RWMutexType::ReadLock lock(GetMutex());
+                    CollectVars("", root, vars);
+                }
+                for (auto& i : vars)
+                {
+                    std::function<void()> cb = i.first->convert(i.second);
+                    if (cb)
+                    {
+                        results[idx].push_back(std::move(cb));
+                    }
+                }
+                loaded[idx] = 1;
             }
-            else 
+            catch (std::exception& e)
             {
-                std::stringstream ss;
-                ss << i.second;
-                var->fromString(ss.str());
+                SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "Config load " << files[idx]
+                    << " failed: " << e.what();
             }
         }
+    };
+    std::vector<Thread::ptr> workers;
+    for (size_t i = 1; i < threads; ++i)
+    {
+        workers.push_back(Thread::ptr(new Thread(work, "config_load_" + std::to_string(i))));
+    }
+    work();
+    for (auto& i : workers)
+    {
+        i->join();
+    }
+
+    // 按文件顺序设置, 后面的文件覆盖前面的
+    size_t count = 0;
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        for (auto& cb : results[i])
+        {
+            cb();
+        }
+        count += loaded[i];
+    }
+    return count;
+}
+
+size_t Config::LoadChangedFromYaml(const YAML::Node& root
+                                   ,std::map<std::string, std::string>& applied)
+{
+    std::vector<std::pair<ConfigVarBase::ptr, YAML::Node> > vars;
+    {
+        RWMutexType::ReadLock lock(GetMutex());
+        CollectVars("", root, vars);
+    }
+
+    std::map<std::string, std::string> current;
+    size_t changed = 0;
+    for (auto& i : vars)
+    {
+        const std::string& key = i.first->getName();
+        std::string text;
+        if (i.second.IsScalar())
+        {
+            text = i.second.Scalar();
+        }
+        else
+        {
+            std::stringstream ss;
+            ss << i.second;
+            text = ss.str();
+        }
+        auto it = applied.find(key);
+        if (it == applied.end() || it->second != text)
+        {
+            i.first->fromNode(i.second);
+            ++changed;
+        }
+        current[key].swap(text);
     }
+    applied.swap(current);
+    return changed;
 }
 
 void Config::Visit(std::function<void(ConfigVarBase::ptr)> cb)
@@ -14,6 +14,8 @@
 #include <unordered_set>
 #include <list>
 #include <functional>
+#include <atomic>
+#include <type_traits>
 
 #include "log.h"
 
@@ -27,6 +29,8 @@ public:
     ConfigVarBase(const std::string& name, const std::string& description = "")
         : m_name(name)
         , m_description(description)
+        , m_index(s_index.fetch_add(1, std::memory_order_relaxed))
+        , m_version(1)
     {
         std::transform(m_name.begin(), m_name.end(), m_name.begin(), ::tolower);
     }
@@ -39,9 +43,62 @@ public:
     virtual std::string toString() = 0;
     virtual bool fromString(const std::string& val) = 0;
     virtual std::string getTypeName() const = 0;
+
+    /**
+     * @brief 把yaml节点直接转换为值, 不经过字符串
+     * @details 转换可以在任意线程进行, 返回的函数负责设置值和调用监听器
+     * @return 转换失败返回nullptr
+     */
+    virtual std::function<void()> convert(const YAML::Node& node) = 0;
+
+    /**
+     * @brief 从yaml节点设置值
+     */
+    bool fromNode(const YAML::Node& node)
+    {
+        std::function<void()> cb = convert(node);
+        if (!cb)
+        {
+            return false;
+        }
+        cb();
+        return true;
+    }
+
+    /**
+     * @brief 值的版本号, 每次修改加1
+     */
+    uint64_t getVersion() const { return m_version.load(std::memory_order_acquire); }
+protected:
+    /**
+     * @brief 线程局部缓存的快照
+     */
+    struct CacheEntry
+    {
+        uint64_t version = 0;
+        std::shared_ptr<const void> value;
+    };
+
+    /**
+     * @brief 当前线程中下标为index的配置项的缓存
+     */
+    static CacheEntry& GetThreadCache(size_t index)
+    {
+        static thread_local std::vector<CacheEntry> t_cache;
+        if (index >= t_cache.size())
+        {
+            t_cache.resize(index + 1);
+        }
+        return t_cache[index];
+    }
 protected:
     std::string m_name;
     std::string m_description;
+    /// 线程局部缓存中的下标
+    size_t m_index;
+    std::atomic<uint64_t> m_version;
+
+    static std::atomic<size_t> s_index;
 };
 
 template<class F, class T>
@@ -270,6 +327,130 @@ public:
     }
 };
 
+/**
+ * @brief yaml节点直接转换为T
+ * @details 标量节点直接用LexicalCast转换, 容器逐个转换元素, 避免序列化成字符串再解析.
+ *          其他非标量节点回退到序列化后用LexicalCast, 自定义类型可以特化
+ */
+template<class T>
+class NodeCast
+{
+public:
+    T operator()(const YAML::Node& node)
+    {
+        if (node.IsScalar())
+        {
+            return LexicalCast<std::string, T>()(node.Scalar());
+        }
+        std::stringstream ss;
+        ss << node;
+        return LexicalCast<std::string, T>()(ss.str());
+    }
+};
+
+template<class T>
+class NodeCast<std::vector<T>>
+{
+public:
+    std::vector<T> operator()(const YAML::Node& node)
+    {
+        std::vector<T> vec;
+        if (node.IsSequence())
+        {
+            vec.reserve(node.size());
+        }
+        for (auto it = node.begin(); it != node.end(); ++it)
+        {
+            vec.push_back(NodeCast<T>()(*it));
+        }
+        return vec;
+    }
+};
+
+template<class T>
+class NodeCast<std::list<T>>
+{
+public:
+    std::list<T> operator()(const YAML::Node& node)
+    {
+        std::list<T> vec;
+        for (auto it = node.begin(); it != node.end(); ++it)
+        {
+            vec.push_back(NodeCast<T>()(*it));
+        }
+        return vec;
+    }
+};
+
+template<class T>
+class NodeCast<std::set<T>>
+{
+public:
+    std::set<T> operator()(const YAML::Node& node)
+    {
+        std::set<T> vec;
+        for (auto it = node.begin(); it != node.end(); ++it)
+        {
+            vec.insert(NodeCast<T>()(*it));
+        }
+        return vec;
+    }
+};
+
+template<class T>
+class NodeCast<std::unordered_set<T>>
+{
+public:
+    std::unordered_set<T> operator()(const YAML::Node& node)
+    {
+        std::unordered_set<T> vec;
+        for (auto it = node.begin(); it != node.end(); ++it)
+        {
+            vec.insert(NodeCast<T>()(*it));
+        }
+        return vec;
+    }
+};
+
+template<class T>
+class NodeCast<std::map<std::string, T>>
+{
+public:
+    std::map<std::string, T> operator()(const YAML::Node& node)
+    {
+        std::map<std::string, T> vec;
+        for (auto it = node.begin(); it != node.end(); ++it)
+        {
+            vec.insert(std::make_pair(it->first.Scalar(), NodeCast<T>()(it->second)));
+        }
+        return vec;
+    }
+};
+
+template<class T>
+class NodeCast<std::unordered_map<std::string, T>>
+{
+public:
+    std::unordered_map<std::string, T> operator()(const YAML::Node& node)
+    {
+        std::unordered_map<std::string, T> vec;
+        if (node.IsMap())
+        {
+            vec.reserve(node.size());
+        }
+        for (auto it = node.begin(); it != node.end(); ++it)
+        {
+            vec.insert(std::make_pair(it->first.Scalar(), NodeCast<T>()(it->second)));
+        }
+        return vec;
+    }
+};
+
+/**
+ * @brief 配置项
+ * @details 值保存为不可变快照, 修改时整体替换. 每个线程缓存一份快照的引用,
+ *          读取时只比较版本号, 版本未变时不加锁也不拷贝
+ */
 template<class T, class FromStr = LexicalCast<std::string, T>, 
                   class ToStr = LexicalCast<T, std::string>>
 class ConfigVar : public ConfigVarBase
@@ -277,12 +458,13 @@ class ConfigVar : public ConfigVarBase
 public:
     typedef RWMutex RWMutexType;
     typedef std::shared_ptr<ConfigVar> ptr;
+    typedef std::shared_ptr<const T> ConstPtr;
     typedef std::function<void (const T& old_value, const T& new_value)> on_change_cb;
 
     ConfigVar(const std::string& name, const T& default_value,
         const std::string& description = "")
         : ConfigVarBase(name, description)
-        , m_val(default_value)
+        , m_val(std::make_shared<const T>(default_value))
     {
     }
 
@@ -291,13 +473,12 @@ public:
         try
         {
             //return boost::lexical_cast<std::string>(m_val); //字面值转换，类似atoi()
-            RWMutexType::ReadLock lock(m_mutex);
-            return ToStr()(m_val);
+            return ToStr()(*getSnapshot());
         }
         catch (std::exception& e)
         {
             SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::toString exception"
-                << e.what() << "convert: " << typeid(m_val).name() << " to string";
+                << e.what() << "convert: " << typeid(T).name() << " to string";
         }
         return "";
     }
@@ -311,35 +492,70 @@ public:
         catch (std::exception& e)
         {
             SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::fromString exception"
-                << e.what() << "convert: string to" << typeid(m_val).name()
+                << e.what() << "convert: string to" << typeid(T).name()
                 << " - " << val;
         }
         return false;
     }
 
+    /**
+     * @brief 返回值的拷贝
+     */
     const T getValue() 
     { 
-        RWMutexType::ReadLock lock(m_mutex);
-        return m_val; 
+        return getView();
+    }
+
+    /**
+     * @brief 返回当前线程缓存的只读视图, 不拷贝
+     * @attention 引用在本线程下一次读取该配置项之前有效, 不能跨协程切换持有,
+     *            需要长期持有时使用getSnapshot
+     */
+    const T& getView()
+    {
+        return *static_cast<const T*>(getCache().value.get());
+    }
+
+    /**
+     * @brief 返回当前值的不可变快照, 可以长期持有
+     */
+    ConstPtr getSnapshot()
+    {
+        return std::static_pointer_cast<const T>(getCache().value);
     }
 
     void setValue(const T& val) 
     { 
+        if (notify(val))
         {
-            RWMutexType::ReadLock lock(m_mutex);
-            if (val == m_val)
-                return;
-            
-            for (auto& i : m_cbs)
-            {
-                i.second(m_val, val);
-            }
+            publish(std::make_shared<const T>(val));
         }
-        RWMutexType::WriteLock lock(m_mutex);
-        m_val = val; 
     }
     std::string getTypeName() const override { return typeid(T).name(); }
 
+    std::function<void()> convert(const YAML::Node& node) override
+    {
+        try
+        {
+            // 自定义了FromStr时按它的字符串格式解析
+            ConstPtr val = std::make_shared<const T>(nodeToValue(node
+                    ,std::integral_constant<bool, std::is_same<FromStr, LexicalCast<std::string, T>>::value>()));
+            return [this, val]() {
+                if (notify(*val))
+                {
+                    publish(val);
+                }
+            };
+        }
+        catch (std::exception& e)
+        {
+            SYLAR_LOG_ERROR(SYLAR_LOG_ROOT()) << "ConfigVar::convert exception"
+                << e.what() << "convert: yaml node to " << typeid(T).name()
+                << " - " << getName();
+        }
+        return nullptr;
+    }
+
     uint64_t addListener(on_change_cb cb)
     {
         static uint64_t s_fun_id = 0;
@@ -365,9 +581,67 @@ public:
         RWMutexType::ReadLock lock(m_mutex);
         m_cbs.clear();
     }
+private:
+    T nodeToValue(const YAML::Node& node, std::true_type)
+    {
+        return NodeCast<T>()(node);
+    }
+
+    T nodeToValue(const YAML::Node& node, std::false_type)
+    {
+        if (node.IsScalar())
+        {
+            return FromStr()(node.Scalar());
+        }
+        std::stringstream ss;
+        ss << node;
+        return FromStr()(ss.str());
+    }
+
+    /**
+     * @brief 值相同时返回false, 否则以(旧值, 新值)调用监听器
+     */
+    bool notify(const T& val)
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        if (val == *m_val)
+            return false;
+
+        for (auto& i : m_cbs)
+        {
+            i.second(*m_val, val);
+        }
+        return true;
+    }
+
+    /**
+     * @brief 发布新的快照
+     */
+    void publish(ConstPtr val)
+    {
+        RWMutexType::WriteLock lock(m_mutex);
+        m_val.swap(val);
+        m_version.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * @brief 当前线程的缓存, 版本变化时在读锁下刷新
+     */
+    CacheEntry& getCache()
+    {
+        CacheEntry& entry = GetThreadCache(m_index);
+        if (entry.version != m_version.load(std::memory_order_acquire))
+        {
+            RWMutexType::ReadLock lock(m_mutex);
+            entry.value = m_val;
+            entry.version = m_version.load(std::memory_order_relaxed);
+        }
+        return entry;
+    }
 private:
     RWMutexType m_mutex;
-    T m_val;
+    /// 当前值的快照, 由m_mutex保护
+    ConstPtr m_val;
     // 配置变更回调函数, key:要求唯一，hash表示
     std::map<uint64_t, on_change_cb> m_cbs;
 };
@@ -409,6 +683,10 @@ public:
 
         typename ConfigVar<T>::ptr v(new ConfigVar<T>(name, default_vale, description));
         GetDatas()[name] = v;
+        for (size_t pos = name.find('.'); pos != std::string::npos; pos = name.find('.', pos + 1))
+        {
+            GetPrefixes().insert(name.substr(0, pos));
+        }
         return v;
     }
 
@@ -422,7 +700,31 @@ public:
         return std::dynamic_pointer_cast<ConfigVar<T>>(it->second);
     }
 
+    /**
+     * @brief 加载yaml中已注册的配置项
+     * @details 只进入含有已注册配置项的子树, 节点直接转换为值
+     */
     static void LoadFromYaml(const YAML::Node& root);
+
+    /**
+     * @brief 并行加载多个yaml文件
+     * @details 文件的读取, 解析和值转换在多个线程中进行, 之后按文件顺序设置值,
+     *          后面文件中的配置项覆盖前面的
+     * @param[in] files 文件列表
+     * @param[in] threads 线程数, 0为CPU数量
+     * @return 成功加载的文件数量
+     */
+    static size_t LoadFromFiles(const std::vector<std::string>& files, size_t threads = 0);
+
+    /**
+     * @brief 只加载与上次内容不同的配置项
+     * @param[in] root yaml根节点
+     * @param[in, out] applied 上次加载的 配置名->yaml文本, 返回本次的内容
+     * @return 修改的配置项数量
+     */
+    static size_t LoadChangedFromYaml(const YAML::Node& root
+                                      ,std::map<std::string, std::string>& applied);
+
     static ConfigVarBase::ptr LookupBase(const std::string& name);
 
     static void Visit(std::function<void(ConfigVarBase::ptr)> cb);
@@ -437,6 +739,20 @@ private:
         static RWMutexType s_mutex;
         return s_mutex;
     }
+
+    /**
+     * @brief 已注册配置项名称的所有前缀, 如a.b.c的a和a.b
+     */
+    static std::unordered_set<std::string>& GetPrefixes(){
+        static std::unordered_set<std::string> s_prefixes;
+        return s_prefixes;
+    }
+
+    /**
+     * @brief 收集yaml中已注册的配置项, 跳过没有已注册配置项的子树, 需要持有读锁
+     */
+    static void CollectVars(const std::string& prefix, const YAML::Node& node
+                            ,std::vector<std::pair<ConfigVarBase::ptr, YAML::Node> >& output);
 };
 }
 
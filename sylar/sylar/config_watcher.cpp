@@ -0,0 +1,342 @@
+#include "config_watcher.h"
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "config.h"
+#include "log.h"
+#include "offload.h"
+#include "util.h"
+
+namespace sylar {
+
+static Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static ConfigVar<uint32_t>::ptr g_watch_debounce =
+    Config::Lookup("config.watch.debounce", (uint32_t)100, "config watcher debounce ms");
+
+static ConfigVar<uint32_t>::ptr g_watch_max_delay =
+    Config::Lookup("config.watch.max_delay", (uint32_t)1000, "config watcher max reload delay ms");
+
+static const uint32_t s_watch_mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM;
+
+static bool IsYamlFile(const std::string& name)
+{
+    if (name.empty() || name[0] == '.')
+    {
+        return false;
+    }
+    size_t pos = name.rfind('.');
+    if (pos == std::string::npos)
+    {
+        return false;
+    }
+    std::string ext = name.substr(pos);
+    return ext == ".yml" || ext == ".yaml";
+}
+
+ConfigWatcher::ConfigWatcher(IOManager* iom)
+    : m_iom(iom)
+    , m_stopping(false)
+    , m_reloads(0)
+    , m_lastChanged(0)
+{
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd == -1)
+    {
+        SYLAR_LOG_ERROR(g_logger) << "inotify_init1 errno=" << errno
+            << " errstr=" << strerror(errno);
+    }
+}
+
+ConfigWatcher::~ConfigWatcher()
+{
+    if (m_fd != -1)
+    {
+        close(m_fd);
+    }
+}
+
+ConfigWatcher::Watch* ConfigWatcher::addWatch(const std::string& dir)
+{
+    if (m_fd == -1)
+    {
+        return nullptr;
+    }
+    int wd = inotify_add_watch(m_fd, dir.c_str(), s_watch_mask);
+    if (wd == -1)
+    {
+        SYLAR_LOG_ERROR(g_logger) << "inotify_add_watch(" << dir << ") errno=" << errno
+            << " errstr=" << strerror(errno);
+        return nullptr;
+    }
+    // 同一目录重复添加返回相同的wd
+    Watch& w = m_watches[wd];
+    w.dir = dir;
+    return &w;
+}
+
+bool ConfigWatcher::addFile(const std::string& path)
+{
+    size_t pos = path.rfind('/');
+    std::string dir = pos == std::string::npos ? "." : path.substr(0, pos ? pos : 1);
+    std::string name = pos == std::string::npos ? path : path.substr(pos + 1);
+    {
+        MutexType::Lock lock(m_mutex);
+        Watch* w = addWatch(dir);
+        if (!w)
+        {
+            return false;
+        }
+        w->names.insert(name);
+    }
+    std::set<std::string> files;
+    files.insert(dir + "/" + name);
+    // 文件还不存在时也保持监视, 创建后加载
+    bool ok = access(path.c_str(), R_OK) == 0;
+    if (ok)
+    {
+        loadFiles(files);
+    }
+    arm();
+    return ok;
+}
+
+bool ConfigWatcher::addDirectory(const std::string& path)
+{
+    std::string dir = path;
+    while (dir.size() > 1 && dir[dir.size() - 1] == '/')
+    {
+        dir.resize(dir.size() - 1);
+    }
+    {
+        MutexType::Lock lock(m_mutex);
+        Watch* w = addWatch(dir);
+        if (!w)
+        {
+            return false;
+        }
+        w->all = true;
+    }
+    std::set<std::string> files;
+    DIR* d = opendir(dir.c_str());
+    if (d)
+    {
+        struct dirent* dp = nullptr;
+        while ((dp = readdir(d)) != nullptr)
+        {
+            if (IsYamlFile(dp->d_name))
+            {
+                files.insert(dir + "/" + dp->d_name);
+            }
+        }
+        closedir(d);
+    }
+    loadFiles(files);
+    arm();
+    return true;
+}
+
+void ConfigWatcher::stop()
+{
+    if (m_stopping.exchange(true))
+    {
+        return;
+    }
+    Timer::ptr timer;
+    {
+        MutexType::Lock lock(m_mutex);
+        timer.swap(m_timer);
+    }
+    if (timer)
+    {
+        timer->cancel();
+    }
+    // 触发读事件回调, 回调看到m_stopping后不再注册, 释放持有的shared_ptr
+    if (m_fd != -1)
+    {
+        m_iom->cancelEvent(m_fd, IOManager::READ);
+    }
+}
+
+void ConfigWatcher::arm()
+{
+    MutexType::Lock lock(m_mutex);
+    if (m_fd == -1 || m_stopping || m_iom->hasEvent(m_fd, IOManager::READ))
+    {
+        return;
+    }
+    ConfigWatcher::ptr self = shared_from_this();
+    m_iom->addEvent(m_fd, IOManager::READ, [self](){
+        self->onReadable();
+    });
+}
+
+void ConfigWatcher::onReadable()
+{
+    if (m_stopping)
+    {
+        return;
+    }
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    while (true)
+    {
+        ssize_t n = read(m_fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        MutexType::Lock lock(m_mutex);
+        for (char* p = buf; p < buf + n; )
+        {
+            struct inotify_event* ev = (struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW)
+            {
+                // 事件丢失, 重新加载所有文件
+                for (auto& i : m_applied)
+                {
+                    m_dirty.insert(i.first);
+                }
+                changed = true;
+                continue;
+            }
+            if (!ev->len)
+            {
+                continue;
+            }
+            auto it = m_watches.find(ev->wd);
+            if (it == m_watches.end())
+            {
+                continue;
+            }
+            std::string name = ev->name;
+            if (it->second.all ? !IsYamlFile(name) : !it->second.names.count(name))
+            {
+                continue;
+            }
+            // 删除和移走时保留当前配置
+            if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+            {
+                continue;
+            }
+            m_dirty.insert(it->second.dir + "/" + name);
+            changed = true;
+        }
+    }
+    if (changed)
+    {
+        MutexType::Lock lock(m_mutex);
+        debounceLocked();
+    }
+    arm();
+}
+
+void ConfigWatcher::debounceLocked()
+{
+    if (m_stopping || m_loading)
+    {
+        // 加载结束后会检查m_dirty
+        return;
+    }
+    uint64_t now = GetCurrentMS();
+    uint32_t debounce = g_watch_debounce->getValue();
+    if (!m_timer)
+    {
+        m_firstChange = now;
+        ConfigWatcher::ptr self = shared_from_this();
+        m_timer = m_iom->addTimer(debounce, [self](){
+            self->onTimer();
+        });
+        return;
+    }
+    // 持续有变化时推迟加载, 但不超过max_delay
+    uint64_t deadline = m_firstChange + std::max(g_watch_max_delay->getValue(), debounce);
+    if (now + debounce <= deadline)
+    {
+        m_timer->reset(debounce, true);
+    }
+    else if (now < deadline)
+    {
+        m_timer->reset(deadline - now, true);
+    }
+}
+
+void ConfigWatcher::onTimer()
+{
+    std::set<std::string> files;
+    {
+        MutexType::Lock lock(m_mutex);
+        m_timer = nullptr;
+        if (m_stopping || m_dirty.empty())
+        {
+            return;
+        }
+        files.swap(m_dirty);
+        m_loading = true;
+    }
+    ConfigWatcher::ptr self = shared_from_this();
+    auto task = [self, files](){
+        size_t changed = self->loadFiles(files);
+        ++self->m_reloads;
+        SYLAR_LOG_INFO(g_logger) << "config reloaded files=" << files.size()
+            << " changed=" << changed;
+        MutexType::Lock lock(self->m_mutex);
+        self->m_loading = false;
+        if (!self->m_dirty.empty())
+        {
+            self->debounceLocked();
+        }
+    };
+    // 解析和监听器可能很慢, 不在IO线程中执行
+    if (!OffloadMgr::GetInstance()->submit(task))
+    {
+        m_iom->schedule(task);
+    }
+}
+
+size_t ConfigWatcher::loadFiles(const std::set<std::string>& files)
+{
+    MutexType::Lock lock(m_loadMutex);
+    size_t changed = 0;
+    for (auto& i : files)
+    {
+        YAML::Node root;
+        try
+        {
+            root = YAML::LoadFile(i);
+        }
+        catch (std::exception& e)
+        {
+            // 写了一半或格式错误时保留当前配置, 下次修改时重新加载
+            SYLAR_LOG_ERROR(g_logger) << "config watcher load " << i
+                << " failed: " << e.what();
+            continue;
+        }
+        changed += Config::LoadChangedFromYaml(root, m_applied[i]);
+    }
+    m_lastChanged = changed;
+    return changed;
+}
+
+size_t ConfigWatcher::reload()
+{
+    std::set<std::string> files;
+    {
+        MutexType::Lock lock(m_loadMutex);
+        for (auto& i : m_applied)
+        {
+            files.insert(i.first);
+        }
+    }
+    return loadFiles(files);
+}
+
+}
@@ -0,0 +1,140 @@
+/**
+ * @file config_watcher.h
+ * @brief 配置文件热加载
+ * @details 用inotify监视yaml文件和目录, inotify句柄注册在IOManager上, 事件在协程中处理.
+ *          变化经过防抖后交给阻塞IO线程池解析, 与上次加载的内容比较,
+ *          只重新设置内容变化的配置项, 监听器只在值真正变化时被调用
+ */
+#ifndef __SYLAR_CONFIG_WATCHER_H__
+#define __SYLAR_CONFIG_WATCHER_H__
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include "iomanager.h"
+#include "mutex.h"
+#include "noncopyable.h"
+
+namespace sylar {
+
+/**
+ * @brief 配置文件监视器
+ * @details 监视的是文件所在的目录, 编辑器先写临时文件再重命名的保存方式也能发现.
+ *          连续的修改在config.watch.debounce毫秒内没有新变化时才加载,
+ *          持续修改时最迟config.watch.max_delay毫秒加载一次. 文件被删除时保留当前值
+ * @attention 必须由shared_ptr持有, 不再使用时调用stop
+ */
+class ConfigWatcher : public std::enable_shared_from_this<ConfigWatcher>, Noncopyable {
+public:
+    typedef std::shared_ptr<ConfigWatcher> ptr;
+    typedef Mutex MutexType;
+
+    /**
+     * @brief 构造函数
+     * @param[in] iom 处理inotify事件和防抖定时器的调度器
+     */
+    ConfigWatcher(IOManager* iom);
+
+    ~ConfigWatcher();
+
+    /**
+     * @brief 监视文件, 立即加载一次
+     * @return inotify或文件加载失败返回false
+     */
+    bool addFile(const std::string& path);
+
+    /**
+     * @brief 监视目录下的.yml/.yaml文件, 立即按文件名顺序加载一次
+     */
+    bool addDirectory(const std::string& path);
+
+    /**
+     * @brief 停止监视, 正在进行的加载会执行完
+     */
+    void stop();
+
+    /**
+     * @brief 同步重新加载所有文件
+     * @return 修改的配置项数量
+     */
+    size_t reload();
+
+    /**
+     * @brief 返回完成的加载次数(不含addFile/addDirectory时的加载)
+     */
+    uint64_t getReloads() const { return m_reloads;}
+
+    /**
+     * @brief 返回最近一次加载修改的配置项数量
+     */
+    size_t getLastChanged() const { return m_lastChanged;}
+private:
+    /**
+     * @brief 被监视的目录
+     */
+    struct Watch {
+        std::string dir;
+        /// 监视目录下所有yaml文件
+        bool all = false;
+        /// 监视的文件名
+        std::set<std::string> names;
+    };
+
+    /**
+     * @brief 为目录添加inotify监视, 需要持有m_mutex
+     */
+    Watch* addWatch(const std::string& dir);
+
+    /**
+     * @brief 注册inotify句柄的读事件
+     */
+    void arm();
+
+    /**
+     * @brief inotify句柄可读
+     */
+    void onReadable();
+
+    /**
+     * @brief 收到变化后启动或推迟防抖定时器, 需要持有m_mutex
+     */
+    void debounceLocked();
+
+    /**
+     * @brief 防抖定时器到期, 把变化的文件交给线程池加载
+     */
+    void onTimer();
+
+    /**
+     * @brief 加载文件, 在线程池中执行
+     * @return 修改的配置项数量
+     */
+    size_t loadFiles(const std::set<std::string>& files);
+private:
+    IOManager* m_iom;
+    int m_fd = -1;
+    MutexType m_mutex;
+    /// inotify wd -> 监视的目录
+    std::map<int, Watch> m_watches;
+    /// 每个文件上次加载的 配置名->yaml文本
+    std::map<std::string, std::map<std::string, std::string> > m_applied;
+    /// 等待加载的文件
+    std::set<std::string> m_dirty;
+    /// 防抖定时器
+    Timer::ptr m_timer;
+    /// 本轮第一个变化的时间
+    uint64_t m_firstChange = 0;
+    /// 是否正在加载
+    bool m_loading = false;
+    /// 加载锁, 保证同一时间只有一个线程修改m_applied
+    MutexType m_loadMutex;
+    std::atomic<bool> m_stopping;
+    std::atomic<uint64_t> m_reloads;
+    std::atomic<size_t> m_lastChanged;
+};
+
+}
+
+#endif
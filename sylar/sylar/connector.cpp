@@ -0,0 +1,316 @@
+#include "connector.h"
+#include <errno.h>
+#include <list>
+#include <string.h>
+#include "config.h"
+#include "fiber.h"
+#include "hook.h"
+#include "iomanager.h"
+#include "log.h"
+#include "mutex.h"
+#include "util.h"
+
+namespace sylar {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static ConfigVar<int>::ptr g_tcp_connect_attempt_delay =
+    Config::Lookup("tcp.connect.attempt_delay", 250, "tcp connect attempt delay(RFC 8305)");
+
+namespace {
+
+/**
+ * @brief 单次连接尝试
+ */
+struct ConnectAttempt {
+    enum State {
+        /// 连接中
+        PENDING,
+        /// 已结束(成功或失败), 等待发起方处理
+        DONE,
+        /// 发起方已放弃
+        ABANDONED
+    };
+    int fd = -1;
+    State state = PENDING;
+    Address::ptr addr;
+};
+
+/**
+ * @brief 一次ConnectAny调用的共享状态, 事件回调和定时器都持有它
+ */
+struct ConnectState {
+    typedef std::shared_ptr<ConnectState> ptr;
+    typedef Mutex MutexType;
+
+    MutexType mutex;
+    std::vector<ConnectAttempt> attempts;
+    /// 胜出的尝试下标
+    int winner = -1;
+    /// 最后一次失败的错误
+    int error = ETIMEDOUT;
+    /// 仍在连接中的数量
+    int running = 0;
+    /// 是否有未处理的唤醒
+    bool signaled = false;
+    /// 挂起等待的协程
+    Fiber::ptr waiting;
+    Scheduler* scheduler = nullptr;
+
+    /**
+     * @brief 唤醒发起协程, 只调度一次
+     */
+    void wake() {
+        MutexType::Lock lock(mutex);
+        wakeLocked();
+    }
+
+    void wakeLocked() {
+        signaled = true;
+        if (waiting) {
+            scheduler->schedule(waiting);
+            waiting = nullptr;
+        }
+    }
+
+    /**
+     * @brief 等待任一尝试结束或定时器到期
+     */
+    void wait() {
+        MutexType::Lock lock(mutex);
+        if (!signaled) {
+            waiting = Fiber::GetThis();
+            lock.unlock();
+            Fiber::YieldToHold();
+            lock.lock();
+        }
+        signaled = false;
+    }
+
+    /**
+     * @brief socket可写时检查连接结果
+     */
+    void onWritable(size_t idx) {
+        MutexType::Lock lock(mutex);
+        ConnectAttempt& a = attempts[idx];
+        if (a.state != ConnectAttempt::PENDING) {
+            return;
+        }
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(a.fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1) {
+            err = errno;
+        }
+        a.state = ConnectAttempt::DONE;
+        --running;
+        if (err == 0) {
+            if (winner == -1) {
+                winner = idx;
+            }
+        } else {
+            error = err;
+            SYLAR_LOG_DEBUG(g_logger) << "connect " << a.addr->toString()
+                << " failed errno=" << err << " errstr=" << strerror(err);
+        }
+        wakeLocked();
+    }
+};
+
+}
+
+std::vector<Address::ptr> SortAddressesForConnect(const std::vector<Address::ptr>& addrs) {
+    if (addrs.empty()) {
+        return addrs;
+    }
+    int first_family = addrs[0]->getFamily();
+    std::list<Address::ptr> first;
+    std::list<Address::ptr> other;
+    for (auto& i : addrs) {
+        if (i->getFamily() == first_family) {
+            first.push_back(i);
+        } else {
+            other.push_back(i);
+        }
+    }
+    std::vector<Address::ptr> rt;
+    rt.reserve(addrs.size());
+    while (!first.empty() || !other.empty()) {
+        if (!first.empty()) {
+            rt.push_back(first.front());
+            first.pop_front();
+        }
+        if (!other.empty()) {
+            rt.push_back(other.front());
+            other.pop_front();
+        }
+    }
+    return rt;
+}
+
+/**
+ * @brief 没有IOManager时逐个阻塞连接
+ */
+static int ConnectSequential(const std::vector<Address::ptr>& addrs) {
+    int error = EINVAL;
+    for (auto& i : addrs) {
+        int fd = socket(i->getFamily(), SOCK_STREAM, 0);
+        if (fd == -1) {
+            error = errno;
+            continue;
+        }
+        if (connect(fd, i->getAddr(), i->getAddrLen()) == 0) {
+            return fd;
+        }
+        error = errno;
+        close(fd);
+    }
+    errno = error;
+    return -1;
+}
+
+int ConnectAny(const std::vector<Address::ptr>& addrs
+               ,uint64_t timeout_ms
+               ,uint64_t attempt_delay_ms) {
+    if (addrs.empty()) {
+        errno = EINVAL;
+        return -1;
+    }
+    IOManager* iom = IOManager::GetThis();
+    if (!iom || !is_hook_enable()) {
+        return ConnectSequential(SortAddressesForConnect(addrs));
+    }
+    if (timeout_ms == CONNECT_USE_CONFIG) {
+        // 配置项由hook.cpp定义, 静态初始化顺序不确定, 使用时再查找
+        static ConfigVar<int>::ptr s_tcp_connect_timeout =
+            Config::Lookup<int>("tcp.connect.timeout");
+        int v = s_tcp_connect_timeout->getValue();
+        // 与hook的connect一致, 负数表示不超时
+        timeout_ms = v < 0 ? CONNECT_NO_TIMEOUT : v;
+    }
+    if (attempt_delay_ms == CONNECT_USE_CONFIG) {
+        attempt_delay_ms = g_tcp_connect_attempt_delay->getValue();
+    }
+    uint64_t left = get_fiber_deadline_left();
+    if (left < timeout_ms) {
+        timeout_ms = left;
+    }
+
+    ConnectState::ptr state(new ConnectState);
+    state->scheduler = iom;
+    std::vector<Address::ptr> sorted = SortAddressesForConnect(addrs);
+    state->attempts.resize(sorted.size());
+
+    // 超时时间大到会回绕时不设截止时间, 只等待连接事件
+    static const uint64_t s_max_wait_ms = ~0ull / 2;
+    uint64_t end = timeout_ms < s_max_wait_ms ? GetCurrentMS() + timeout_ms : ~0ull;
+    size_t next = 0;
+    while (true) {
+        // 启动下一次尝试, 立即失败的继续启动后一个
+        while (next < sorted.size()) {
+            size_t idx = next++;
+            Address::ptr addr = sorted[idx];
+            int fd = socket(addr->getFamily(), SOCK_STREAM, 0);
+            if (fd == -1) {
+                ConnectState::MutexType::Lock lock(state->mutex);
+                state->error = errno;
+                continue;
+            }
+            ConnectState::MutexType::Lock lock(state->mutex);
+            ConnectAttempt& a = state->attempts[idx];
+            a.fd = fd;
+            a.addr = addr;
+            // socket已被hook设为非阻塞, 直接调用原始connect
+            int rt = connect_f(fd, addr->getAddr(), addr->getAddrLen());
+            if (rt == 0) {
+                a.state = ConnectAttempt::DONE;
+                state->winner = idx;
+                break;
+            }
+            if (errno != EINPROGRESS) {
+                a.state = ConnectAttempt::DONE;
+                state->error = errno;
+                continue;
+            }
+            ++state->running;
+            std::weak_ptr<ConnectState> wstate(state);
+            rt = iom->addEvent(fd, IOManager::WRITE, [wstate, idx](){
+                ConnectState::ptr s = wstate.lock();
+                if (s) {
+                    s->onWritable(idx);
+                }
+            });
+            if (rt) {
+                a.state = ConnectAttempt::DONE;
+                --state->running;
+                state->error = EBADF;
+                continue;
+            }
+            break;
+        }
+
+        {
+            ConnectState::MutexType::Lock lock(state->mutex);
+            if (state->winner != -1) {
+                break;
+            }
+            if (state->running == 0 && next >= sorted.size()) {
+                break;
+            }
+        }
+        uint64_t now = GetCurrentMS();
+        if (now >= end) {
+            ConnectState::MutexType::Lock lock(state->mutex);
+            state->error = ETIMEDOUT;
+            break;
+        }
+        uint64_t wait_ms = end - now;
+        if (next < sorted.size() && attempt_delay_ms < wait_ms) {
+            wait_ms = attempt_delay_ms;
+        }
+        Timer::ptr timer;
+        if (wait_ms < s_max_wait_ms) {
+            std::weak_ptr<ConnectState> wstate(state);
+            timer = iom->addTimer(wait_ms, [wstate](){
+                ConnectState::ptr s = wstate.lock();
+                if (s) {
+                    s->wake();
+                }
+            });
+        }
+        state->wait();
+        if (timer) {
+            timer->cancel();
+        }
+    }
+
+    // 关闭除胜出者外的所有socket, 关闭时hook会取消其事件, 回调看到ABANDONED直接返回
+    std::vector<int> losers;
+    int winner_fd = -1;
+    int error = 0;
+    {
+        ConnectState::MutexType::Lock lock(state->mutex);
+        for (size_t i = 0; i < state->attempts.size(); ++i) {
+            ConnectAttempt& a = state->attempts[i];
+            if ((int)i == state->winner) {
+                winner_fd = a.fd;
+                continue;
+            }
+            if (a.fd != -1) {
+                losers.push_back(a.fd);
+            }
+            a.state = ConnectAttempt::ABANDONED;
+        }
+        error = state->error;
+    }
+    for (auto fd : losers) {
+        close(fd);
+    }
+    if (winner_fd == -1) {
+        errno = error;
+        return -1;
+    }
+    iom->delEvent(winner_fd, IOManager::WRITE);
+    return winner_fd;
+}
+
+}
@@ -0,0 +1,42 @@
+/**
+ * @file connector.h
+ * @brief 多地址并行连接(RFC 8305 Happy Eyeballs)
+ * @details 按地址族交替排序后错开启动非阻塞连接, 第一个连接成功的socket胜出,
+ *          其余连接全部关闭, 避免某个地址不可达时等待整个连接超时
+ */
+#ifndef __SYLAR_CONNECTOR_H__
+#define __SYLAR_CONNECTOR_H__
+
+#include <stdint.h>
+#include <vector>
+#include "address.h"
+
+namespace sylar {
+
+/**
+ * @brief 按RFC 8305对地址排序, 以第一个地址的地址族开头, 之后各地址族交替
+ */
+std::vector<Address::ptr> SortAddressesForConnect(const std::vector<Address::ptr>& addrs);
+
+/// 使用配置项的值
+static const uint64_t CONNECT_USE_CONFIG = ~0ull;
+/// 不限制超时时间, 仍受协程截止时间限制
+static const uint64_t CONNECT_NO_TIMEOUT = ~0ull - 1;
+
+/**
+ * @brief 并行连接多个地址, 必须在IOManager的协程中调用
+ * @param[in] addrs 候选地址
+ * @param[in] timeout_ms 整体超时时间(毫秒), CONNECT_USE_CONFIG使用配置tcp.connect.timeout,
+ *            配置为负数或超时时间大到无法表示截止时间时不限制超时
+ * @param[in] attempt_delay_ms 两次连接尝试的间隔(毫秒), CONNECT_USE_CONFIG使用配置tcp.connect.attempt_delay
+ *            前一次尝试失败时立即开始下一次
+ * @return 成功返回已连接的socket(SOCK_STREAM), 失败返回-1并设置errno
+ *         超时(含协程截止时间)errno=ETIMEDOUT, 否则为最后一次失败的错误
+ */
+int ConnectAny(const std::vector<Address::ptr>& addrs
+               ,uint64_t timeout_ms = CONNECT_USE_CONFIG
+               ,uint64_t attempt_delay_ms = CONNECT_USE_CONFIG);
+
+}
+
+#endif
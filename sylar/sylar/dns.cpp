@@ -0,0 +1,491 @@
+#include "dns.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string.h>
+#include <sys/time.h>
+#include "config.h"
+#include "hook.h"
+#include "log.h"
+#include "util.h"
+
+namespace sylar {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static ConfigVar<std::vector<std::string> >::ptr g_dns_servers =
+    Config::Lookup("dns.servers", std::vector<std::string>()
+            , "dns servers ip[:port], empty to use /etc/resolv.conf");
+
+static ConfigVar<int>::ptr g_dns_timeout =
+    Config::Lookup("dns.timeout", 1000, "dns query timeout per attempt(ms)");
+
+static ConfigVar<int>::ptr g_dns_retries =
+    Config::Lookup("dns.retries", 2, "dns query retries per server");
+
+static ConfigVar<int>::ptr g_dns_negative_ttl =
+    Config::Lookup("dns.cache.negative_ttl", 30, "dns negative cache ttl(s)");
+
+static ConfigVar<int>::ptr g_dns_max_ttl =
+    Config::Lookup("dns.cache.max_ttl", 3600, "dns cache max ttl(s)");
+
+static ConfigVar<int>::ptr g_dns_cache_capacity =
+    Config::Lookup("dns.cache.capacity", 4096, "dns cache capacity");
+
+static const uint16_t DNS_TYPE_A = 1;
+static const uint16_t DNS_TYPE_SOA = 6;
+static const uint16_t DNS_TYPE_AAAA = 28;
+static const uint16_t DNS_CLASS_IN = 1;
+static const uint16_t DNS_RCODE_NXDOMAIN = 3;
+static const size_t DNS_HEADER_SIZE = 12;
+static const size_t DNS_MAX_UDP_SIZE = 1232;
+
+/**
+ * @brief 解析服务器地址 ip, ip:port, [ipv6]:port, 只接受数字地址
+ */
+static Address::ptr ParseServer(const std::string& str) {
+    std::string host = str;
+    uint32_t port = 53;
+    if (!str.empty() && str[0] == '[') {
+        size_t pos = str.find(']');
+        if (pos == std::string::npos) {
+            return nullptr;
+        }
+        host = str.substr(1, pos - 1);
+        if (pos + 2 < str.size() && str[pos + 1] == ':') {
+            port = atoi(str.c_str() + pos + 2);
+        }
+    } else {
+        size_t pos = str.find(':');
+        if (pos != std::string::npos && str.find(':', pos + 1) == std::string::npos) {
+            host = str.substr(0, pos);
+            port = atoi(str.c_str() + pos + 1);
+        }
+    }
+    sockaddr_in addr4;
+    memset(&addr4, 0, sizeof(addr4));
+    if (inet_pton(AF_INET, host.c_str(), &addr4.sin_addr) == 1) {
+        addr4.sin_family = AF_INET;
+        addr4.sin_port = htons(port);
+        return Address::Create((const sockaddr*)&addr4, sizeof(addr4));
+    }
+    sockaddr_in6 addr6;
+    memset(&addr6, 0, sizeof(addr6));
+    if (inet_pton(AF_INET6, host.c_str(), &addr6.sin6_addr) == 1) {
+        addr6.sin6_family = AF_INET6;
+        addr6.sin6_port = htons(port);
+        return Address::Create((const sockaddr*)&addr6, sizeof(addr6));
+    }
+    return nullptr;
+}
+
+/**
+ * @brief 数字地址转IPAddress
+ */
+static IPAddress::ptr ParseIP(const std::string& str) {
+    Address::ptr addr = ParseServer(str.find(':') == std::string::npos ? str : "[" + str + "]");
+    if (!addr) {
+        return nullptr;
+    }
+    IPAddress::ptr rt = std::dynamic_pointer_cast<IPAddress>(addr);
+    rt->setPort(0);
+    return rt;
+}
+
+static std::string ToLower(const std::string& str) {
+    std::string rt = str;
+    for (auto& c : rt) {
+        c = tolower(c);
+    }
+    if (!rt.empty() && rt.back() == '.') {
+        rt.pop_back();
+    }
+    return rt;
+}
+
+static uint16_t ReadU16(const std::string& buf, size_t pos) {
+    return ((uint8_t)buf[pos] << 8) | (uint8_t)buf[pos + 1];
+}
+
+static uint32_t ReadU32(const std::string& buf, size_t pos) {
+    return ((uint32_t)ReadU16(buf, pos) << 16) | ReadU16(buf, pos + 2);
+}
+
+static void WriteU16(std::string& buf, uint16_t v) {
+    buf.push_back(v >> 8);
+    buf.push_back(v & 0xff);
+}
+
+/**
+ * @brief 跳过报文中的域名(含压缩指针)
+ * @return 失败返回false
+ */
+static bool SkipName(const std::string& buf, size_t& pos) {
+    while (pos < buf.size()) {
+        uint8_t len = buf[pos];
+        if ((len & 0xc0) == 0xc0) {
+            pos += 2;
+            return pos <= buf.size();
+        }
+        ++pos;
+        if (len == 0) {
+            return true;
+        }
+        pos += len;
+    }
+    return false;
+}
+
+/**
+ * @brief 构造查询报文
+ */
+static bool BuildQuery(const std::string& name, uint16_t qtype, uint16_t id, std::string& buf) {
+    buf.clear();
+    WriteU16(buf, id);
+    // RD
+    WriteU16(buf, 0x0100);
+    WriteU16(buf, 1);
+    WriteU16(buf, 0);
+    WriteU16(buf, 0);
+    WriteU16(buf, 0);
+    size_t begin = 0;
+    while (begin < name.size()) {
+        size_t end = name.find('.', begin);
+        if (end == std::string::npos) {
+            end = name.size();
+        }
+        size_t len = end - begin;
+        if (len == 0 || len > 63) {
+            return false;
+        }
+        buf.push_back(len);
+        buf.append(name, begin, len);
+        begin = end + 1;
+    }
+    buf.push_back(0);
+    WriteU16(buf, qtype);
+    WriteU16(buf, DNS_CLASS_IN);
+    return buf.size() <= 512;
+}
+
+/**
+ * @brief 解析应答报文
+ * @param[out] ttl 应答中记录的最小TTL, 负应答为SOA中的最小TTL
+ * @return 0成功, ENOENT不存在/无记录, EIO报文错误或服务器错误
+ */
+static int ParseResponse(const std::string& buf, uint16_t qtype
+                         ,std::vector<IPAddress::ptr>& result, uint32_t& ttl) {
+    if (buf.size() < DNS_HEADER_SIZE) {
+        return EIO;
+    }
+    uint16_t flags = ReadU16(buf, 2);
+    uint16_t qdcount = ReadU16(buf, 4);
+    uint16_t ancount = ReadU16(buf, 6);
+    uint16_t nscount = ReadU16(buf, 8);
+    uint16_t rcode = flags & 0x0f;
+    if (rcode != 0 && rcode != DNS_RCODE_NXDOMAIN) {
+        return EIO;
+    }
+
+    size_t pos = DNS_HEADER_SIZE;
+    for (uint16_t i = 0; i < qdcount; ++i) {
+        if (!SkipName(buf, pos)) {
+            return EIO;
+        }
+        pos += 4;
+    }
+
+    ttl = ~0u;
+    uint16_t count = ancount + nscount;
+    for (uint16_t i = 0; i < count; ++i) {
+        if (!SkipName(buf, pos) || pos + 10 > buf.size()) {
+            return EIO;
+        }
+        uint16_t type = ReadU16(buf, pos);
+        uint16_t cls = ReadU16(buf, pos + 2);
+        uint32_t rttl = ReadU32(buf, pos + 4);
+        uint16_t rdlen = ReadU16(buf, pos + 8);
+        pos += 10;
+        if (pos + rdlen > buf.size()) {
+            return EIO;
+        }
+        if (i < ancount && cls == DNS_CLASS_IN && type == qtype) {
+            IPAddress::ptr addr;
+            if (type == DNS_TYPE_A && rdlen == 4) {
+                sockaddr_in addr4;
+                memset(&addr4, 0, sizeof(addr4));
+                addr4.sin_family = AF_INET;
+                memcpy(&addr4.sin_addr, buf.data() + pos, 4);
+                addr.reset(new IPv4Address(addr4));
+            } else if (type == DNS_TYPE_AAAA && rdlen == 16) {
+                sockaddr_in6 addr6;
+                memset(&addr6, 0, sizeof(addr6));
+                addr6.sin6_family = AF_INET6;
+                memcpy(&addr6.sin6_addr, buf.data() + pos, 16);
+                addr.reset(new IPv6Address(addr6));
+            }
+            if (addr) {
+                result.push_back(addr);
+                ttl = std::min(ttl, rttl);
+            }
+        } else if (i >= ancount && type == DNS_TYPE_SOA && result.empty()) {
+            // 负缓存时间取SOA的TTL和MINIMUM中较小者(RFC 2308)
+            size_t p = pos;
+            if (SkipName(buf, p) && SkipName(buf, p) && p + 20 <= pos + rdlen) {
+                ttl = std::min(ttl, std::min(rttl, ReadU32(buf, p + 16)));
+            }
+        }
+        pos += rdlen;
+    }
+    if (rcode == DNS_RCODE_NXDOMAIN || result.empty()) {
+        return ENOENT;
+    }
+    return 0;
+}
+
+static uint16_t NextQueryId() {
+    static thread_local std::mt19937 s_rand(GetCurrentUS() ^ (GetThreadId() << 16));
+    return s_rand() & 0xffff;
+}
+
+DnsResolver::DnsResolver()
+    :m_queryCount(0) {
+    std::ifstream hosts("/etc/hosts");
+    std::string line;
+    while (std::getline(hosts, line)) {
+        size_t pos = line.find('#');
+        if (pos != std::string::npos) {
+            line.resize(pos);
+        }
+        std::istringstream ss(line);
+        std::string ip;
+        std::string name;
+        if (!(ss >> ip)) {
+            continue;
+        }
+        IPAddress::ptr addr = ParseIP(ip);
+        if (!addr) {
+            continue;
+        }
+        while (ss >> name) {
+            m_hosts[ToLower(name)].push_back(addr);
+        }
+    }
+
+    std::ifstream resolv("/etc/resolv.conf");
+    while (std::getline(resolv, line)) {
+        std::istringstream ss(line);
+        std::string key;
+        std::string value;
+        if (ss >> key >> value && key == "nameserver") {
+            Address::ptr addr = ParseServer(value.find(':') == std::string::npos
+                                            ? value : "[" + value + "]:53");
+            if (addr) {
+                m_sysServers.push_back(addr);
+            }
+        }
+    }
+}
+
+std::vector<Address::ptr> DnsResolver::getServers() {
+    std::vector<Address::ptr> servers;
+    // 快照不拷贝vector, 解析期间配置被修改也不受影响
+    auto conf = g_dns_servers->getSnapshot();
+    for (auto& i : *conf) {
+        Address::ptr addr = ParseServer(i);
+        if (addr) {
+            servers.push_back(addr);
+        } else {
+            SYLAR_LOG_ERROR(g_logger) << "invalid dns server " << i;
+        }
+    }
+    if (servers.empty()) {
+        servers = m_sysServers;
+    }
+    if (servers.empty()) {
+        servers.push_back(ParseServer("127.0.0.1"));
+    }
+    return servers;
+}
+
+bool DnsResolver::lookupHosts(const std::string& name, int family
+                              ,std::vector<IPAddress::ptr>& result) {
+    auto it = m_hosts.find(name);
+    if (it == m_hosts.end()) {
+        return false;
+    }
+    size_t size = result.size();
+    for (auto& i : it->second) {
+        if (family == AF_UNSPEC || i->getFamily() == family) {
+            result.push_back(i);
+        }
+    }
+    return result.size() > size;
+}
+
+DnsResolver::CacheShard& DnsResolver::getShard(const std::string& key) {
+    return m_shards[std::hash<std::string>()(key) % s_shard_count];
+}
+
+int DnsResolver::resolve(const std::string& name, int family
+                         ,std::vector<IPAddress::ptr>& result) {
+    std::string lname = ToLower(name);
+    if (lname.empty()) {
+        return ENOENT;
+    }
+    if (lookupHosts(lname, family, result)) {
+        return 0;
+    }
+    if (family == AF_INET) {
+        return resolveType(lname, DNS_TYPE_A, result);
+    } else if (family == AF_INET6) {
+        return resolveType(lname, DNS_TYPE_AAAA, result);
+    } else if (family == AF_UNSPEC) {
+        int rt6 = resolveType(lname, DNS_TYPE_AAAA, result);
+        int rt4 = resolveType(lname, DNS_TYPE_A, result);
+        return (rt6 == 0 || rt4 == 0) ? 0 : rt4;
+    }
+    return EINVAL;
+}
+
+int DnsResolver::resolveType(const std::string& name, uint16_t qtype
+                             ,std::vector<IPAddress::ptr>& result) {
+    std::string key = name + "/" + std::to_string(qtype);
+    CacheShard& shard = getShard(key);
+    uint64_t now = GetCurrentMS();
+    {
+        MutexType::Lock lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end()) {
+            if (it->second.expire > now) {
+                result.insert(result.end(), it->second.addrs.begin(), it->second.addrs.end());
+                return it->second.error;
+            }
+            shard.entries.erase(it);
+        }
+    }
+
+    std::vector<IPAddress::ptr> addrs;
+    uint32_t ttl = 0;
+    int rt = query(name, qtype, addrs, ttl);
+    if (rt == 0 || rt == ENOENT) {
+        if (rt == ENOENT) {
+            ttl = std::min(ttl, (uint32_t)g_dns_negative_ttl->getValue());
+        }
+        ttl = std::min(ttl, (uint32_t)g_dns_max_ttl->getValue());
+        CacheEntry entry;
+        entry.addrs = addrs;
+        entry.error = rt;
+        entry.expire = GetCurrentMS() + (uint64_t)ttl * 1000;
+
+        size_t capacity = std::max(g_dns_cache_capacity->getValue() / (int)s_shard_count, 1);
+        MutexType::Lock lock(shard.mutex);
+        if (shard.entries.size() >= capacity) {
+            for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+                if (it->second.expire <= now) {
+                    it = shard.entries.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            if (shard.entries.size() >= capacity) {
+                shard.entries.erase(shard.entries.begin());
+            }
+        }
+        shard.entries[key] = entry;
+    }
+    result.insert(result.end(), addrs.begin(), addrs.end());
+    return rt;
+}
+
+int DnsResolver::query(const std::string& name, uint16_t qtype
+                       ,std::vector<IPAddress::ptr>& result, uint32_t& ttl) {
+    std::vector<Address::ptr> servers = getServers();
+    int retries = std::max(g_dns_retries->getValue(), 0);
+    int error = ETIMEDOUT;
+    for (int i = 0; i <= retries; ++i) {
+        for (auto& server : servers) {
+            uint16_t id = NextQueryId();
+            std::string request;
+            if (!BuildQuery(name, qtype, id, request)) {
+                return ENOENT;
+            }
+            std::string response;
+            int rt = exchange(server, request, id, response);
+            if (rt) {
+                error = rt;
+                SYLAR_LOG_DEBUG(g_logger) << "dns query " << name << " type=" << qtype
+                    << " server=" << server->toString() << " errno=" << rt;
+                if (rt == ETIMEDOUT && get_fiber_deadline_left() == 0) {
+                    return ETIMEDOUT;
+                }
+                continue;
+            }
+            std::vector<IPAddress::ptr> addrs;
+            rt = ParseResponse(response, qtype, addrs, ttl);
+            if (rt == 0 || rt == ENOENT) {
+                result.swap(addrs);
+                return rt;
+            }
+            error = rt;
+        }
+    }
+    return error;
+}
+
+int DnsResolver::exchange(Address::ptr server, const std::string& request
+                          ,uint16_t id, std::string& response) {
+    int sock = socket(server->getFamily(), SOCK_DGRAM, 0);
+    if (sock == -1) {
+        return errno;
+    }
+    int timeout = g_dns_timeout->getValue();
+    timeval tv = {timeout / 1000, timeout % 1000 * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    int rt = 0;
+    do {
+        // connect后内核只投递该服务器的应答
+        if (connect(sock, server->getAddr(), server->getAddrLen())
+                || send(sock, request.data(), request.size(), 0) != (ssize_t)request.size()) {
+            rt = errno;
+            break;
+        }
+        ++m_queryCount;
+        uint64_t end = GetCurrentMS() + timeout;
+        response.resize(DNS_MAX_UDP_SIZE);
+        while (true) {
+            ssize_t n = recv(sock, &response[0], response.size(), 0);
+            if (n < 0) {
+                rt = (errno == EAGAIN || errno == EWOULDBLOCK) ? ETIMEDOUT : errno;
+                break;
+            }
+            // 忽略id不匹配或不是应答的报文
+            if (n >= (ssize_t)DNS_HEADER_SIZE && ReadU16(response, 0) == id
+                    && (response[2] & 0x80)) {
+                response.resize(n);
+                break;
+            }
+            uint64_t now = GetCurrentMS();
+            if (now >= end) {
+                rt = ETIMEDOUT;
+                break;
+            }
+            uint64_t left = end - now;
+            tv = {(time_t)(left / 1000), (suseconds_t)(left % 1000 * 1000)};
+            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        }
+    } while (0);
+    close(sock);
+    return rt;
+}
+
+void DnsResolver::clearCache() {
+    for (auto& i : m_shards) {
+        MutexType::Lock lock(i.mutex);
+        i.entries.clear();
+    }
+}
+
+}
@@ -0,0 +1,118 @@
+/**
+ * @file dns.h
+ * @brief 协程DNS解析
+ * @details 通过hook的UDP socket发送A/AAAA查询, 在协程中等待应答不阻塞线程,
+ *          支持超时重试, 多服务器轮询, 以及按TTL过期的分片正/负缓存
+ */
+#ifndef __SYLAR_DNS_H__
+#define __SYLAR_DNS_H__
+
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "address.h"
+#include "mutex.h"
+#include "singleton.h"
+
+namespace sylar {
+
+/**
+ * @brief DNS解析器
+ */
+class DnsResolver : Noncopyable {
+public:
+    typedef Mutex MutexType;
+
+    /// 缓存分片数量
+    static const size_t s_shard_count = 16;
+
+    /**
+     * @brief 构造函数, 读取/etc/hosts和/etc/resolv.conf
+     */
+    DnsResolver();
+
+    /**
+     * @brief 解析域名
+     * @param[in] name 域名
+     * @param[in] family 协议族(AF_INET, AF_INET6, AF_UNSPEC)
+     * @param[out] result 解析结果, 端口为0, 对象可能被缓存共享, 不要修改
+     * @return 0成功, ENOENT域名不存在或没有对应记录, ETIMEDOUT超时, EIO服务器错误
+     */
+    int resolve(const std::string& name, int family, std::vector<IPAddress::ptr>& result);
+
+    /**
+     * @brief 清空缓存
+     */
+    void clearCache();
+
+    /**
+     * @brief 返回发出的查询报文数量
+     */
+    uint64_t getQueryCount() const { return m_queryCount;}
+private:
+    /**
+     * @brief 缓存条目
+     */
+    struct CacheEntry {
+        /// 解析结果
+        std::vector<IPAddress::ptr> addrs;
+        /// 错误码, 非0为负缓存
+        int error = 0;
+        /// 过期时间(毫秒)
+        uint64_t expire = 0;
+    };
+
+    /**
+     * @brief 缓存分片
+     */
+    struct CacheShard {
+        MutexType mutex;
+        std::unordered_map<std::string, CacheEntry> entries;
+    };
+
+    /**
+     * @brief 查询一种记录, 先查缓存
+     */
+    int resolveType(const std::string& name, uint16_t qtype, std::vector<IPAddress::ptr>& result);
+
+    /**
+     * @brief 向服务器发起查询, 带重试
+     * @param[out] ttl 结果可缓存的秒数
+     */
+    int query(const std::string& name, uint16_t qtype
+              ,std::vector<IPAddress::ptr>& result, uint32_t& ttl);
+
+    /**
+     * @brief 与一个服务器完成一次请求应答
+     */
+    int exchange(Address::ptr server, const std::string& request
+                 ,uint16_t id, std::string& response);
+
+    /**
+     * @brief 返回当前生效的服务器列表
+     */
+    std::vector<Address::ptr> getServers();
+
+    /**
+     * @brief 查询/etc/hosts
+     */
+    bool lookupHosts(const std::string& name, int family, std::vector<IPAddress::ptr>& result);
+
+    CacheShard& getShard(const std::string& key);
+private:
+    /// 缓存分片
+    CacheShard m_shards[s_shard_count];
+    /// /etc/hosts, 构造后只读
+    std::unordered_map<std::string, std::vector<IPAddress::ptr> > m_hosts;
+    /// /etc/resolv.conf中的服务器, 构造后只读
+    std::vector<Address::ptr> m_sysServers;
+    /// 发出的查询报文数量
+    std::atomic<uint64_t> m_queryCount;
+};
+
+typedef Singleton<DnsResolver> DnsMgr;
+
+}
+
+#endif
@@ -0,0 +1,174 @@
+#include "epoch.h"
+#include <atomic>
+#include <list>
+#include <stdint.h>
+#include "mutex.h"
+
+namespace sylar {
+
+namespace {
+
+/**
+ * @brief 每个线程的epoch记录, 只挂入不摘除, 线程退出后可被新线程复用
+ */
+struct EpochRecord {
+    /// 当前线程所在的epoch, 0表示不在epoch内
+    std::atomic<uint64_t> epoch;
+    /// 是否被线程占用
+    std::atomic<bool> used;
+    /// 嵌套层数, 只有所属线程访问
+    uint32_t nest = 0;
+    /// 下一条记录
+    EpochRecord* next = nullptr;
+
+    EpochRecord()
+        :epoch(0)
+        ,used(true) {
+    }
+};
+
+/**
+ * @brief 线程退出时归还epoch记录
+ */
+struct EpochRecordHolder {
+    EpochRecord* record = nullptr;
+
+    ~EpochRecordHolder();
+};
+
+struct RetireItem {
+    uint64_t epoch;
+    std::function<void()> cb;
+};
+
+/**
+ * @brief 待回收列表, 只有写者访问
+ */
+struct RetireList {
+    Mutex mutex;
+    std::list<RetireItem> items;
+};
+
+/// 所有线程记录, 常量初始化, 不受静态析构顺序影响
+static std::atomic<EpochRecord*> s_records(nullptr);
+/// 全局epoch
+static std::atomic<uint64_t> s_global_epoch(1);
+/// 每积累多少个待回收对象尝试回收一次
+static const size_t s_reclaim_batch = 64;
+
+static thread_local EpochRecord* t_record = nullptr;
+static thread_local EpochRecordHolder t_holder;
+
+EpochRecordHolder::~EpochRecordHolder() {
+    if (record) {
+        record->nest = 0;
+        record->epoch.store(0, std::memory_order_release);
+        record->used.store(false, std::memory_order_release);
+        record = nullptr;
+        t_record = nullptr;
+    }
+}
+
+static RetireList& GetRetireList() {
+    // 进程退出时仍可能有线程在回收, 不析构
+    static RetireList* s_list = new RetireList;
+    return *s_list;
+}
+
+static EpochRecord* Register() {
+    EpochRecord* r = s_records.load(std::memory_order_acquire);
+    for (; r; r = r->next) {
+        bool expect = false;
+        if (!r->used.load(std::memory_order_relaxed)
+                && r->used.compare_exchange_strong(expect, true)) {
+            break;
+        }
+    }
+    if (!r) {
+        r = new EpochRecord;
+        EpochRecord* head = s_records.load(std::memory_order_relaxed);
+        do {
+            r->next = head;
+        } while (!s_records.compare_exchange_weak(head, r
+                    , std::memory_order_release, std::memory_order_relaxed));
+    }
+    t_record = r;
+    t_holder.record = r;
+    return r;
+}
+
+/**
+ * @brief 所有在epoch内的线程都已看到当前epoch时推进一步, 调用方持有回收锁
+ */
+static uint64_t TryAdvance() {
+    uint64_t cur = s_global_epoch.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (EpochRecord* r = s_records.load(std::memory_order_acquire); r; r = r->next) {
+        uint64_t e = r->epoch.load(std::memory_order_acquire);
+        if (e && e != cur) {
+            return cur;
+        }
+    }
+    s_global_epoch.store(cur + 1, std::memory_order_release);
+    return cur + 1;
+}
+
+}
+
+void Epoch::Enter() {
+    EpochRecord* r = t_record;
+    if (!r) {
+        r = Register();
+    }
+    if (r->nest++ == 0) {
+        r->epoch.store(s_global_epoch.load(std::memory_order_relaxed)
+                , std::memory_order_relaxed);
+        // 公告必须先于之后对共享指针的读取对回收者可见
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+void Epoch::Leave() {
+    EpochRecord* r = t_record;
+    if (--r->nest == 0) {
+        r->epoch.store(0, std::memory_order_release);
+    }
+}
+
+void Epoch::Retire(std::function<void()> cb) {
+    RetireList& rl = GetRetireList();
+    size_t size = 0;
+    {
+        Mutex::Lock lock(rl.mutex);
+        rl.items.push_back({s_global_epoch.load(std::memory_order_relaxed), cb});
+        size = rl.items.size();
+    }
+    if (size >= s_reclaim_batch) {
+        Reclaim();
+    }
+}
+
+size_t Epoch::Reclaim() {
+    RetireList& rl = GetRetireList();
+    std::list<RetireItem> done;
+    size_t left = 0;
+    {
+        Mutex::Lock lock(rl.mutex);
+        uint64_t global = TryAdvance();
+        // 摘下于epoch e的对象, 在全局epoch到达e + 2后不会再有读者持有
+        for (auto it = rl.items.begin(); it != rl.items.end();) {
+            if (it->epoch + 2 <= global) {
+                done.splice(done.end(), rl.items, it++);
+            } else {
+                ++it;
+            }
+        }
+        left = rl.items.size();
+    }
+    for (auto& i : done) {
+        i.cb();
+    }
+    return left;
+}
+
+}
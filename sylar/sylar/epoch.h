@@ -0,0 +1,65 @@
+/**
+ * @file epoch.h
+ * @brief 基于epoch的内存回收(EBR)
+ * @details 读者进入epoch后可以无锁地访问共享指针, 写者摘下对象后调用Retire,
+ *          等所有读者都离开摘下时的epoch之后对象才被真正释放
+ *          读者路径只有一次普通store和一次内存屏障, 没有锁和原子读改写
+ */
+#ifndef __SYLAR_EPOCH_H__
+#define __SYLAR_EPOCH_H__
+
+#include <stddef.h>
+#include <functional>
+#include "noncopyable.h"
+
+namespace sylar {
+
+/**
+ * @brief epoch管理
+ */
+class Epoch {
+public:
+    /**
+     * @brief 当前线程进入epoch, 可以嵌套
+     */
+    static void Enter();
+
+    /**
+     * @brief 当前线程离开epoch
+     */
+    static void Leave();
+
+    /**
+     * @brief 延迟释放
+     * @param[in] cb 所有读者都离开当前epoch后执行的回收函数
+     */
+    static void Retire(std::function<void()> cb);
+
+    /**
+     * @brief 延迟delete对象
+     */
+    template<class T>
+    static void Retire(T* p) {
+        Retire([p](){ delete p; });
+    }
+
+    /**
+     * @brief 尝试推进epoch并执行可回收的回收函数
+     * @return 剩余待回收数量
+     */
+    static size_t Reclaim();
+};
+
+/**
+ * @brief epoch的RAII守卫
+ * @attention 守卫期间不能切换协程, 协程可能在其他线程恢复
+ */
+class EpochGuard : Noncopyable {
+public:
+    EpochGuard() { Epoch::Enter(); }
+    ~EpochGuard() { Epoch::Leave(); }
+};
+
+}
+
+#endif
@@ -10,6 +10,7 @@ namespace sylar
 FdCtx::FdCtx(int fd)
     : m_isInit(false)
     , m_isSocket(false)
+    , m_isFile(false)
     , m_sysNonblock(false)
     , m_userNonblock(false)
     , m_isClosed(false)
@@ -41,12 +42,14 @@ bool FdCtx::init()
     {
         m_isInit = false;
         m_isSocket = false;
+        m_isFile = false;
     } 
     else 
     {
         m_isInit = true;
         // S_ISSOCK检查一个文件描述符是否是套接字，是则返回非0，否则返回0
         m_isSocket = S_ISSOCK(fd_stat.st_mode);
+        m_isFile = S_ISREG(fd_stat.st_mode) || S_ISBLK(fd_stat.st_mode);
     }
 
     if (m_isSocket) {
@@ -61,7 +64,8 @@ bool FdCtx::init()
     {
         m_sysNonblock = false;
     }
-    m_userNonblock = false;
+    // 非socket句柄不修改系统标志, 用户打开时设置的非阻塞直接生效
+    m_userNonblock = !m_isSocket && (fcntl_f(m_fd, F_GETFL, 0) & O_NONBLOCK);
     m_isClosed = false;
     return m_isInit;
 }
@@ -91,39 +95,79 @@ uint64_t FdCtx::getTimeout(int type)
     }
 }
 
+FdManager::Segment::Segment()
+{
+    for (int i = 0; i < s_segment_size; ++i) {
+        slots[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
 FdManager::FdManager()
 {
-    m_datas.resize(64);
+    for (int i = 0; i < s_segment_count; ++i) {
+        m_segments[i].store(nullptr, std::memory_order_relaxed);
+    }
 }
 
-FdCtx::ptr FdManager::get(int fd, bool auto_create)
+FdManager::~FdManager()
 {
-    RWMutexType::ReadLock lock(m_mutex);
-    if ((int)m_datas.size() <= fd) {
-        if  (auto_create == false) {
+    for (int i = 0; i < s_segment_count; ++i) {
+        Segment* seg = m_segments[i].load(std::memory_order_acquire);
+        if (!seg) {
+            continue;
+        }
+        for (int j = 0; j < s_segment_size; ++j) {
+            delete seg->slots[j].load(std::memory_order_relaxed);
+        }
+        delete seg;
+    }
+}
+
+FdCtx* FdManager::get(int fd, bool auto_create)
+{
+    if (fd < 0 || fd >= s_segment_size * s_segment_count) {
+        return nullptr;
+    }
+    std::atomic<Segment*>& pseg = m_segments[fd >> s_segment_bits];
+    Segment* seg = pseg.load(std::memory_order_acquire);
+    if (!seg) {
+        if (!auto_create) {
             return nullptr;
         }
-    } 
-    else {
-        if (m_datas[fd] || !auto_create) {
-            return m_datas[fd];
+        Segment* nseg = new Segment;
+        if (pseg.compare_exchange_strong(seg, nseg, std::memory_order_acq_rel)) {
+            seg = nseg;
+        } else {
+            delete nseg;
         }
     }
-    lock.unlock();
-    RWMutexType::WriteLock lock2(m_mutex);
-    FdCtx::ptr ctx(new FdCtx(fd));
-    m_datas[fd] = ctx;
 
+    std::atomic<FdCtx*>& slot = seg->slots[fd & (s_segment_size - 1)];
+    FdCtx* ctx = slot.load(std::memory_order_acquire);
+    if (ctx || !auto_create) {
+        return ctx;
+    }
+    FdCtx* nctx = new FdCtx(fd);
+    if (slot.compare_exchange_strong(ctx, nctx, std::memory_order_acq_rel)) {
+        return nctx;
+    }
+    delete nctx;
     return ctx;
 }
 
 void FdManager::del(int fd)
 {
-    RWMutexType::WriteLock lock(m_mutex);
-    if ((int)m_datas.size() <= fd) {
-        return ;
+    if (fd < 0 || fd >= s_segment_size * s_segment_count) {
+        return;
+    }
+    Segment* seg = m_segments[fd >> s_segment_bits].load(std::memory_order_acquire);
+    if (!seg) {
+        return;
+    }
+    FdCtx* ctx = seg->slots[fd & (s_segment_size - 1)].exchange(nullptr, std::memory_order_acq_rel);
+    if (ctx) {
+        Epoch::Retire(ctx);
     }
-    m_datas[fd].reset();
 }
 
-}
\ No newline at end of file
+}
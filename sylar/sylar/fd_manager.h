@@ -1,7 +1,9 @@
 #ifndef __FD_MANAGER_H__
 #define __FD_MANAGER_H__
 
+#include <atomic>
 #include <memory>
+#include "epoch.h"
 #include "mutex.h"
 #include "iomanager.h"
 #include "singleton.h"
@@ -13,16 +15,19 @@ namespace sylar
  * @details 管理文件句柄类型(是否socket)
  *          是否阻塞,是否关闭,读/写超时时间
  */
-class FdCtx : public std::enable_shared_from_this<FdCtx>
+class FdCtx
 {
 public:
-    typedef std::shared_ptr<FdCtx> ptr;
     FdCtx(int fd);
     ~FdCtx();
 
     bool init();
     bool isInit() const { return m_isInit; }
     bool isSocket() const { return m_isSocket; }
+    /**
+     * @brief 是否普通文件或块设备, 只有它们的IO交给阻塞IO线程池
+     */
+    bool isFile() const { return m_isFile; }
      /**
      * @brief 是否已关闭
      */
@@ -50,6 +55,7 @@ public:
 private:
     bool m_isInit = true;
     bool m_isSocket = true;
+    bool m_isFile = false;
     bool m_sysNonblock = true;
     bool m_userNonblock = true;
     bool m_isClosed = true;
@@ -61,18 +67,52 @@ private:
     sylar::IOManager* m_iomanager;
 };
 
-class FdManager 
+/**
+ * @brief 文件句柄管理类
+ * @details 两级表: 段指针数组 + 每段固定数量的槽位, 段一经分配不再移动,
+ *          查找只有两次acquire load, 不加锁也没有原子读改写
+ *          删除的FdCtx通过Epoch延迟释放
+ */
+class FdManager : Noncopyable
 {
 public:
-    typedef RWMutex RWMutexType;
+    /// 每段槽位数量的位数
+    static const int s_segment_bits = 10;
+    /// 每段槽位数量
+    static const int s_segment_size = 1 << s_segment_bits;
+    /// 段数量, 最大支持 s_segment_size * s_segment_count 个句柄
+    static const int s_segment_count = 1024;
+
     FdManager();
+    ~FdManager();
+
+    /**
+     * @brief 获取/创建文件句柄上下文
+     * @param[in] fd 文件句柄
+     * @param[in] auto_create 不存在时是否自动创建
+     * @return 借用的指针, 只在调用方持有的EpochGuard作用域内有效
+     * @attention 调用方必须在EpochGuard作用域内调用并使用返回值
+     */
+    FdCtx* get(int fd, bool auto_create = false);
 
-    FdCtx::ptr get(int fd, bool auto_create = false);
+    /**
+     * @brief 删除文件句柄上下文, 已借出的指针在读者离开epoch后才释放
+     */
     void del(int fd);
 
 private:
-    RWMutexType m_mutex;
-    std::vector<FdCtx::ptr> m_datas;
+    /**
+     * @brief 一段槽位
+     */
+    struct Segment {
+        std::atomic<FdCtx*> slots[s_segment_size];
+
+        Segment();
+    };
+
+private:
+    /// 段指针数组
+    std::atomic<Segment*> m_segments[s_segment_count];
 };
 
 typedef Singleton<FdManager> FdMgr;
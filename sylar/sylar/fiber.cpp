@@ -71,7 +71,7 @@ Fiber::Fiber(std::function<void()> cb, size_t stacksize, bool use_caller)
         makecontext(&m_ctx, &Fiber::CallerMainFunc, 0);
     }
 
-    SYLAR_LOG_DEBUG(g_logger) << "Fiber::Fiber id=" << m_id;
+    SYLAR_LOG_STATIC_DEBUG(g_logger) << "Fiber::Fiber id=" << m_id;
 }
 
 Fiber::~Fiber() {
@@ -91,7 +91,7 @@ Fiber::~Fiber() {
             SetThis(nullptr);
         }
     }
-    SYLAR_LOG_DEBUG(g_logger) << "Fiber::~Fiber id=" << m_id
+    SYLAR_LOG_STATIC_DEBUG(g_logger) << "Fiber::~Fiber id=" << m_id
                               << " total=" << s_fiber_count;
 }
 
@@ -103,6 +103,7 @@ void Fiber::reset(std::function<void()> cb) {
             || m_state == EXCEPT
             || m_state == INIT);
     m_cb = cb;
+    m_deadline.reset();
     if(getcontext(&m_ctx)) {
         SYLAR_ASSERT2(false, "getcontext");
     }
@@ -16,6 +16,7 @@
 namespace sylar {
 
 class Scheduler;
+struct FiberDeadline;
 
 /**
  * @brief 协程类
@@ -104,6 +105,16 @@ public:
      * @brief 返回协程状态
      */
     State getState() const { return m_state;}
+
+    /**
+     * @brief 返回协程截止时间上下文(由hook模块维护)
+     */
+    const std::shared_ptr<FiberDeadline>& getDeadline() const { return m_deadline;}
+
+    /**
+     * @brief 设置协程截止时间上下文
+     */
+    void setDeadline(std::shared_ptr<FiberDeadline> v) { m_deadline.swap(v);}
 public:
 
     /**
@@ -163,6 +174,8 @@ private:
     void* m_stack = nullptr;
     /// 协程运行函数
     std::function<void()> m_cb;
+    /// 协程截止时间上下文
+    std::shared_ptr<FiberDeadline> m_deadline;
 };
 
 }
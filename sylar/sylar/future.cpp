@@ -0,0 +1,173 @@
+#include "future.h"
+#include "iomanager.h"
+
+namespace sylar {
+
+/**
+ * @brief 等待者, 完成和超时通过claim竞争, 只有一方唤醒它
+ */
+struct FutureStateBase::Waiter {
+    Waiter()
+        :scheduler(Scheduler::GetThis())
+        ,fired(false) {
+        if(scheduler) {
+            fiber = Fiber::GetThis();
+        } else {
+            sem.reset(new Semaphore);
+        }
+    }
+
+    bool claim() { return !fired.exchange(true, std::memory_order_acq_rel);}
+
+    void wake() {
+        if(scheduler) {
+            scheduler->schedule(fiber);
+        } else {
+            sem->notify();
+        }
+    }
+
+    Scheduler* scheduler;
+    Fiber::ptr fiber;
+    /// 不在调度器中时阻塞线程
+    std::unique_ptr<Semaphore> sem;
+    std::atomic<bool> fired;
+    bool timedout = false;
+};
+
+FutureStateBase::FutureStateBase()
+    :m_state(PENDING) {
+}
+
+bool FutureStateBase::wait(uint64_t timeout_ms) {
+    if(isDone()) {
+        return true;
+    }
+    if(timeout_ms == 0) {
+        return false;
+    }
+    std::shared_ptr<Waiter> w(new Waiter);
+    {
+        MutexType::Lock lock(m_mutex);
+        if(isDone()) {
+            return true;
+        }
+        m_waiters.push_back(w);
+    }
+    if(w->scheduler) {
+        Timer::ptr timer;
+        if(timeout_ms != ~0ull) {
+            IOManager* iom = IOManager::GetThis();
+            SYLAR_ASSERT2(iom, "future timeout needs IOManager");
+            timer = iom->addTimer(timeout_ms, [w](){
+                if(w->claim()) {
+                    w->timedout = true;
+                    w->wake();
+                }
+            });
+        }
+        // 完成者唤醒时可能还没切出, 调度器会等协程切出后再执行
+        Fiber::YieldToHold();
+        if(timer) {
+            timer->cancel();
+        }
+    } else if(timeout_ms == ~0ull) {
+        w->sem->wait();
+    } else if(!w->sem->waitFor(timeout_ms)) {
+        if(w->claim()) {
+            w->timedout = true;
+        } else {
+            // 完成者已认领, 等它的notify
+            w->sem->wait();
+        }
+    }
+    if(w->timedout) {
+        MutexType::Lock lock(m_mutex);
+        m_waiters.remove(w);
+        return isDone();
+    }
+    return true;
+}
+
+void FutureStateBase::then(std::function<void()> cb) {
+    {
+        MutexType::Lock lock(m_mutex);
+        if(!isDone()) {
+            m_callbacks.push_back(cb);
+            return;
+        }
+    }
+    cb();
+}
+
+bool FutureStateBase::setException(std::exception_ptr e) {
+    MutexType::Lock lock(m_mutex);
+    if(isDone()) {
+        return false;
+    }
+    m_exception = e;
+    completeLocked(FAILED, lock);
+    return true;
+}
+
+bool FutureStateBase::cancel() {
+    MutexType::Lock lock(m_mutex);
+    if(isDone()) {
+        return false;
+    }
+    completeLocked(CANCELLED, lock);
+    return true;
+}
+
+void FutureStateBase::onCancel(std::function<void()> cb) {
+    {
+        MutexType::Lock lock(m_mutex);
+        if(!isDone()) {
+            m_cancelCallbacks.push_back(cb);
+            return;
+        }
+        if(getState() != CANCELLED) {
+            return;
+        }
+    }
+    cb();
+}
+
+void FutureStateBase::check() const {
+    switch(getState()) {
+        case FAILED:
+            std::rethrow_exception(m_exception);
+        case CANCELLED:
+            throw FutureCancelled();
+        default:
+            break;
+    }
+}
+
+void FutureStateBase::completeLocked(State state, MutexType::Lock& lock) {
+    m_state.store(state, std::memory_order_release);
+    std::list<std::shared_ptr<Waiter> > waiters;
+    std::vector<std::function<void()> > callbacks;
+    std::vector<std::function<void()> > cancel_callbacks;
+    waiters.swap(m_waiters);
+    callbacks.swap(m_callbacks);
+    // 回调可能持有其他Future, 完成后释放避免循环引用
+    cancel_callbacks.swap(m_cancelCallbacks);
+    lock.unlock();
+
+    for(auto& i : waiters) {
+        if(i->claim()) {
+            i->wake();
+        }
+    }
+    if(state == CANCELLED) {
+        for(auto& i : cancel_callbacks) {
+            i();
+        }
+    }
+    for(auto& i : callbacks) {
+        i();
+    }
+}
+
+}
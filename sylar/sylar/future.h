@@ -0,0 +1,375 @@
+/**
+ * @file future.h
+ * @brief 协程Future/Promise
+ * @details get/wait在协程中挂起协程, 在普通线程中阻塞线程. 完成时在等待者原来的调度器中
+ *          唤醒它, 每个Future只有自己的锁. WhenAll/WhenAny通过完成回调组合, 不需要等待线程
+ */
+#ifndef __SYLAR_FUTURE_H__
+#define __SYLAR_FUTURE_H__
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "macro.h"
+#include "mutex.h"
+#include "noncopyable.h"
+#include "scheduler.h"
+
+namespace sylar {
+
+/**
+ * @brief 获取已取消的Future的结果时抛出
+ */
+class FutureCancelled : public std::runtime_error {
+public:
+    FutureCancelled()
+        :std::runtime_error("future cancelled") {
+    }
+};
+
+/**
+ * @brief Future和Promise共享的状态, 与值类型无关的部分
+ */
+class FutureStateBase : Noncopyable {
+public:
+    typedef std::shared_ptr<FutureStateBase> ptr;
+    typedef Spinlock MutexType;
+
+    /**
+     * @brief 状态
+     */
+    enum State {
+        /// 未完成
+        PENDING = 0,
+        /// 已设置值
+        READY = 1,
+        /// 已设置异常
+        FAILED = 2,
+        /// 已取消
+        CANCELLED = 3
+    };
+
+    FutureStateBase();
+    virtual ~FutureStateBase() {}
+
+    State getState() const { return (State)m_state.load(std::memory_order_acquire);}
+
+    bool isDone() const { return getState() != PENDING;}
+
+    /**
+     * @brief 等待完成
+     * @param[in] timeout_ms 超时时间(毫秒), ~0ull为一直等待. 协程中超时需要在IOManager中
+     * @return 是否已完成
+     */
+    bool wait(uint64_t timeout_ms = ~0ull);
+
+    /**
+     * @brief 添加完成回调, 在完成的线程中调用, 已完成时立即调用
+     */
+    void then(std::function<void()> cb);
+
+    /**
+     * @brief 以异常完成
+     * @return 已完成时返回false
+     */
+    bool setException(std::exception_ptr e);
+
+    /**
+     * @brief 取消, 唤醒等待者并调用取消回调
+     * @return 已完成时返回false
+     */
+    bool cancel();
+
+    /**
+     * @brief 添加取消回调, 已取消时立即调用, 正常完成后回调被丢弃
+     */
+    void onCancel(std::function<void()> cb);
+
+    /**
+     * @brief 失败时重新抛出异常, 取消时抛出FutureCancelled
+     */
+    void check() const;
+protected:
+    /**
+     * @brief 把状态改为state, 释放lock后唤醒等待者和调用回调
+     * @pre 持有m_mutex且状态为PENDING
+     */
+    void completeLocked(State state, MutexType::Lock& lock);
+protected:
+    MutexType m_mutex;
+private:
+    struct Waiter;
+
+    std::atomic<int> m_state;
+    std::exception_ptr m_exception;
+    std::list<std::shared_ptr<Waiter> > m_waiters;
+    std::vector<std::function<void()> > m_callbacks;
+    std::vector<std::function<void()> > m_cancelCallbacks;
+};
+
+/**
+ * @brief 带值的共享状态
+ */
+template<class T>
+class FutureState : public FutureStateBase {
+public:
+    typedef std::shared_ptr<FutureState> ptr;
+
+    bool setValue(T v) {
+        MutexType::Lock lock(m_mutex);
+        if(getState() != PENDING) {
+            return false;
+        }
+        m_value.reset(new T(std::move(v)));
+        completeLocked(READY, lock);
+        return true;
+    }
+
+    /**
+     * @pre 状态为READY
+     */
+    const T& getValue() const { return *m_value;}
+private:
+    std::unique_ptr<T> m_value;
+};
+
+template<>
+class FutureState<void> : public FutureStateBase {
+public:
+    typedef std::shared_ptr<FutureState> ptr;
+
+    bool setValue() {
+        MutexType::Lock lock(m_mutex);
+        if(getState() != PENDING) {
+            return false;
+        }
+        completeLocked(READY, lock);
+        return true;
+    }
+};
+
+/**
+ * @brief Future中与值类型无关的操作
+ */
+class FutureBase {
+public:
+    bool valid() const { return !!m_state;}
+
+    bool isDone() const { return m_state->isDone();}
+
+    FutureStateBase::State getState() const { return m_state->getState();}
+
+    /**
+     * @brief 等待完成, 不抛出异常
+     * @return 超时返回false
+     */
+    bool wait(uint64_t timeout_ms = ~0ull) const { return m_state->wait(timeout_ms);}
+
+    /**
+     * @brief 取消, 生产者通过Promise::isCancelled或onCancel得知
+     * @return 已完成时返回false
+     */
+    bool cancel() const { return m_state->cancel();}
+
+    /**
+     * @brief 返回共享状态, 用于组合
+     */
+    const FutureStateBase::ptr& getSharedState() const { return m_state;}
+protected:
+    FutureStateBase::ptr m_state;
+};
+
+/**
+ * @brief 异步结果
+ * @details 可以复制, 所有副本共享同一个结果
+ */
+template<class T>
+class Future : public FutureBase {
+public:
+    Future() {}
+
+    explicit Future(typename FutureState<T>::ptr state)
+        :m_typed(state) {
+        m_state = state;
+    }
+
+    /**
+     * @brief 等待并返回结果
+     * @exception 生产者设置的异常, 取消时为FutureCancelled
+     */
+    const T& get() const {
+        m_typed->wait();
+        m_typed->check();
+        return m_typed->getValue();
+    }
+private:
+    typename FutureState<T>::ptr m_typed;
+};
+
+template<>
+class Future<void> : public FutureBase {
+public:
+    Future() {}
+
+    explicit Future(FutureState<void>::ptr state) {
+        m_state = state;
+    }
+
+    void get() const {
+        m_state->wait();
+        m_state->check();
+    }
+};
+
+/**
+ * @brief Promise中与值类型无关的操作
+ */
+template<class T>
+class PromiseBase {
+public:
+    PromiseBase()
+        :m_state(new FutureState<T>) {
+    }
+
+    Future<T> getFuture() const { return Future<T>(m_state);}
+
+    bool setException(std::exception_ptr e) const { return m_state->setException(e);}
+
+    bool isCancelled() const { return m_state->getState() == FutureStateBase::CANCELLED;}
+
+    /**
+     * @brief 添加取消回调, 用于中止下游调用
+     */
+    void onCancel(std::function<void()> cb) const { m_state->onCancel(cb);}
+protected:
+    typename FutureState<T>::ptr m_state;
+};
+
+/**
+ * @brief 设置异步结果
+ * @details 可以复制, 只有第一次设置生效
+ */
+template<class T>
+class Promise : public PromiseBase<T> {
+public:
+    /**
+     * @return 已完成(包括被取消)时返回false
+     */
+    bool setValue(T v) const { return this->m_state->setValue(std::move(v));}
+};
+
+template<>
+class Promise<void> : public PromiseBase<void> {
+public:
+    bool setValue() const { return m_state->setValue();}
+};
+
+namespace future_detail {
+
+template<class R, class F>
+void Fulfill(const Promise<R>& p, F& f) {
+    p.setValue(f());
+}
+
+template<class F>
+void Fulfill(const Promise<void>& p, F& f) {
+    f();
+    p.setValue();
+}
+
+}
+
+/**
+ * @brief 在调度器中执行f, 返回它的结果
+ * @details 执行前已取消时不执行, f抛出的异常由Future::get重新抛出
+ */
+template<class F>
+auto Async(Scheduler* sc, F f) -> Future<decltype(f())> {
+    typedef decltype(f()) R;
+    Promise<R> p;
+    sc->schedule([p, f]() mutable {
+        if(p.isCancelled()) {
+            return;
+        }
+        try {
+            future_detail::Fulfill(p, f);
+        } catch(...) {
+            p.setException(std::current_exception());
+        }
+    });
+    return p.getFuture();
+}
+
+/**
+ * @brief 所有Future完成(包括失败和取消)时完成
+ * @details 返回的Future被取消时取消所有输入
+ */
+template<class Iter>
+Future<void> WhenAll(Iter begin, Iter end) {
+    Promise<void> p;
+    std::vector<FutureStateBase::ptr> states;
+    for(; begin != end; ++begin) {
+        states.push_back(begin->getSharedState());
+    }
+    if(states.empty()) {
+        p.setValue();
+        return p.getFuture();
+    }
+    std::shared_ptr<std::atomic<size_t> > remaining(new std::atomic<size_t>(states.size()));
+    p.onCancel([states]() {
+        for(auto& i : states) {
+            i->cancel();
+        }
+    });
+    for(auto& i : states) {
+        i->then([p, remaining]() {
+            if(--*remaining == 0) {
+                p.setValue();
+            }
+        });
+    }
+    return p.getFuture();
+}
+
+template<class T>
+Future<void> WhenAll(const std::vector<Future<T> >& futures) {
+    return WhenAll(futures.begin(), futures.end());
+}
+
+/**
+ * @brief 第一个Future完成时完成, 值为它的下标
+ * @details 其余的Future不会被取消. 返回的Future被取消时取消所有输入
+ */
+template<class Iter>
+Future<size_t> WhenAny(Iter begin, Iter end) {
+    Promise<size_t> p;
+    std::vector<FutureStateBase::ptr> states;
+    for(; begin != end; ++begin) {
+        states.push_back(begin->getSharedState());
+    }
+    SYLAR_ASSERT(!states.empty());
+    p.onCancel([states]() {
+        for(auto& i : states) {
+            i->cancel();
+        }
+    });
+    for(size_t i = 0; i < states.size(); ++i) {
+        states[i]->then([p, i]() {
+            p.setValue(i);
+        });
+    }
+    return p.getFuture();
+}
+
+template<class T>
+Future<size_t> WhenAny(const std::vector<Future<T> >& futures) {
+    return WhenAny(futures.begin(), futures.end());
+}
+
+}
+
+#endif
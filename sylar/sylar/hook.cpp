@@ -6,6 +6,7 @@
 #include "log.h"
 #include "fd_manager.h"
 #include "config.h"
+#include "offload.h"
 
 sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 namespace sylar
@@ -26,11 +27,23 @@ static thread_local bool t_hook_enable = false;
     XX(recv) \
     XX(recvfrom) \
     XX(recvmsg) \
+    XX(recvmmsg) \
     XX(write) \
     XX(writev) \
     XX(send) \
     XX(sendto) \
     XX(sendmsg) \
+    XX(sendmmsg) \
+    XX(sendfile) \
+    XX(splice) \
+    XX(poll) \
+    XX(ppoll) \
+    XX(select) \
+    XX(epoll_wait) \
+    XX(open) \
+    XX(pread) \
+    XX(pwrite) \
+    XX(fsync) \
     XX(close) \
     XX(fcntl) \
     XX(ioctl) \
@@ -50,17 +63,14 @@ void hook_init() {
 #undef XX
 }
 
-static uint64_t s_connect_timeout = -1;
 // 保证程序启动前hook函数初始化完成
 struct _HookIniter {
     _HookIniter() {
         hook_init();
-        s_connect_timeout = g_tcp_connect_timeout->getValue();
 
         g_tcp_connect_timeout->addListener([](const int& old_value, const int& new_value){
             SYLAR_LOG_INFO(g_logger) << "tcp connect timeout changed from " 
                 << old_value << " to " << new_value;
-            s_connect_timeout = new_value;
         });
     }
 };
@@ -75,12 +85,249 @@ void set_hook_enable(bool flag) {
     t_hook_enable = flag;
 }
 
+/**
+ * @brief 协程截止时间上下文
+ * @details 每个协程只有一个截止定时器, 定时器触发时取消协程当前等待的IO事件
+ */
+struct FiberDeadline {
+    typedef std::shared_ptr<FiberDeadline> ptr;
+    typedef Spinlock MutexType;
+
+    ~FiberDeadline() {
+        if (timer) {
+            timer->cancel();
+        }
+    }
+
+    /**
+     * @brief 剩余时间(毫秒), 已超时返回0
+     */
+    uint64_t left() {
+        uint64_t now = sylar::GetCurrentMS();
+        if (expired || now >= deadline) {
+            return 0;
+        }
+        return deadline - now;
+    }
+
+    MutexType mutex;
+    /// 截止时间戳(毫秒)
+    uint64_t deadline = ~0ull;
+    /// 截止定时器是否已触发
+    std::atomic<bool> expired = {false};
+    /// 截止定时器
+    Timer::ptr timer;
+    /// 当前等待事件所在的IOManager, 为空表示未在等待
+    IOManager* iom = nullptr;
+    /// 当前等待的句柄
+    int fd = -1;
+    /// 当前等待的事件
+    uint32_t event = 0;
+    /// 等待事件的协程, 只用于确认事件仍属于它
+    Fiber* fiber = nullptr;
+};
+
+void set_fiber_deadline(uint64_t timeout_ms) {
+    if (timeout_ms == ~0ull) {
+        return;
+    }
+    Fiber::ptr fiber = Fiber::GetThis();
+    uint64_t deadline = sylar::GetCurrentMS() + timeout_ms;
+    const FiberDeadline::ptr& cur = fiber->getDeadline();
+    if (cur && cur->deadline <= deadline) {
+        return;
+    }
+
+    FiberDeadline::ptr dl(new FiberDeadline);
+    dl->deadline = deadline;
+    IOManager* iom = IOManager::GetThis();
+    if (iom) {
+        std::weak_ptr<FiberDeadline> wdl(dl);
+        dl->timer = iom->addConditionTimer(timeout_ms, [wdl](){
+            FiberDeadline::ptr t = wdl.lock();
+            if (!t) {
+                return ;
+            }
+            // 持锁取消, 协程在同一把锁下登记结束等待, 不会取消到它醒来之后的事件;
+            // 事件已触发时其他协程在同一句柄上注册的事件也不属于它, 不会被取消
+            FiberDeadline::MutexType::Lock lock(t->mutex);
+            t->expired = true;
+            if (t->iom) {
+                t->iom->cancelEvent(t->fd, (IOManager::Event)t->event, t->fiber);
+            }
+        }, wdl);
+    }
+    fiber->setDeadline(dl);
+}
+
+void clear_fiber_deadline() {
+    Fiber::GetThis()->setDeadline(nullptr);
+}
+
+uint64_t get_fiber_deadline_left() {
+    const FiberDeadline::ptr& dl = Fiber::GetThis()->getDeadline();
+    return dl ? dl->left() : ~0ull;
+}
+
+/**
+ * @brief 登记协程正在等待的IO事件(需在addEvent成功之后调用)
+ * @return 截止时间已过返回false, 此时调用方需要自行取消事件
+ */
+static bool deadline_begin_wait(const FiberDeadline::ptr& dl, IOManager* iom, int fd, uint32_t event) {
+    FiberDeadline::MutexType::Lock lock(dl->mutex);
+    if (dl->expired) {
+        return false;
+    }
+    dl->iom = iom;
+    dl->fd = fd;
+    dl->event = event;
+    dl->fiber = Fiber::GetThis().get();
+    return true;
+}
+
+static void deadline_end_wait(const FiberDeadline::ptr& dl) {
+    FiberDeadline::MutexType::Lock lock(dl->mutex);
+    dl->iom = nullptr;
+    dl->fd = -1;
+    dl->event = 0;
+    dl->fiber = nullptr;
+}
+
+/**
+ * @brief 按截止时间裁剪超时时间
+ * @param[in, out] to 超时时间(毫秒), 截止时间更短时由截止定时器负责超时
+ * @return 截止时间已过返回false
+ */
+static bool deadline_merge_timeout(const FiberDeadline::ptr& dl, uint64_t& to) {
+    if (!dl) {
+        return true;
+    }
+    uint64_t left = dl->left();
+    if (left == 0) {
+        return false;
+    }
+    if (to == (uint64_t)-1 || left <= to) {
+        to = -1;
+    }
+    return true;
+}
+
+/**
+ * @brief 挂起当前协程等待fd上的事件, 同时登记到协程截止时间上下文
+ * @return addEvent的返回值
+ */
+static int wait_event(IOManager* iom, const FiberDeadline::ptr& dl, int fd, uint32_t event) {
+    int rt = iom->addEvent(fd, (IOManager::Event)(event));
+    if (rt) {
+        return rt;
+    }
+    if (dl && !deadline_begin_wait(dl, iom, fd, event)) {
+        // 截止定时器已经触发, 主动取消事件唤醒自己
+        iom->cancelEvent(fd, (IOManager::Event)(event), Fiber::GetThis().get());
+    }
+    Fiber::YieldToHold();
+    if (dl) {
+        deadline_end_wait(dl);
+    }
+    return 0;
+}
+
+/**
+ * @brief 按截止时间裁剪睡眠时间
+ * @return 睡眠时间被截止时间截断时返回true
+ */
+static bool deadline_clip_sleep(uint64_t& ms) {
+    const FiberDeadline::ptr& dl = Fiber::GetThis()->getDeadline();
+    if (!dl) {
+        return false;
+    }
+    uint64_t left = dl->left();
+    if (left < ms) {
+        ms = left;
+        return true;
+    }
+    return false;
+}
+
 }
 struct timer_info
 {
     int cancelled = 0;
 };
 
+// 普通文件和块设备无法由epoll管理, 交给阻塞IO线程池执行, 当前协程挂起直到完成
+// 已提交的调用无法中断, 截止时间只在提交前检查
+template<typename OriginFun, typename ... Args>
+static auto do_offload(OriginFun fun, Args&&... args) -> decltype(fun(args...))
+{
+    sylar::Scheduler* sc = sylar::Scheduler::GetThis();
+    if (!sylar::t_hook_enable || !sc) {
+        return fun(std::forward<Args>(args)...);
+    }
+    sylar::Fiber::ptr fiber = sylar::Fiber::GetThis();
+    if (fiber.get() == sylar::Scheduler::GetMainFiber()) {
+        return fun(std::forward<Args>(args)...);
+    }
+    if (sylar::get_fiber_deadline_left() == 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    decltype(fun(args...)) rt = -1;
+    int error = 0;
+    bool ok = sylar::OffloadMgr::GetInstance()->submit([&](){
+        rt = fun(args...);
+        error = errno;
+        sc->schedule(fiber);
+    });
+    if (!ok) {
+        return fun(std::forward<Args>(args)...);
+    }
+    sylar::Fiber::YieldToHold();
+    errno = error;
+    return rt;
+}
+
+// fd上下文的分类
+enum fd_kind {
+    /// 不由FdManager管理
+    FD_UNKNOWN,
+    /// 已关闭
+    FD_CLOSED,
+    /// 普通文件或块设备
+    FD_FILE,
+    /// 管道, 终端等其他非socket句柄, 读写可能无限阻塞, 不交给线程池
+    FD_OTHER,
+    /// 用户设置了非阻塞的socket
+    FD_USER_NONBLOCK,
+    /// 需要hook的socket
+    FD_SOCKET
+};
+
+// 在epoch内读取fd上下文, 借用的FdCtx不能跨越协程切换, 所以只带出需要的字段
+static fd_kind get_fd_kind(int fd, int timeout_so, uint64_t& to)
+{
+    sylar::EpochGuard guard;
+    sylar::FdCtx* ctx = sylar::FdMgr::GetInstance()->get(fd);
+    if (!ctx) {
+        return FD_UNKNOWN;
+    }
+    if (ctx->isClose()) {
+        return FD_CLOSED;
+    }
+    if (ctx->getUserNonblock()) {
+        return FD_USER_NONBLOCK;
+    }
+    if (ctx->isFile()) {
+        return FD_FILE;
+    }
+    if (!ctx->isSocket()) {
+        return FD_OTHER;
+    }
+    to = ctx->getTimeout(timeout_so);
+    return FD_SOCKET;
+}
+
 template<typename OriginFun, typename ... Args>
 static ssize_t do_io(int fd, OriginFun fun, const char* hook_fun_name, 
     uint32_t event, int timeout_so, Args&&... args)
@@ -88,24 +335,32 @@ static ssize_t do_io(int fd, OriginFun fun, const char* hook_fun_name,
     if (!sylar::t_hook_enable) {
         return fun(fd, std::forward<Args>(args)...);
     }
-    SYLAR_LOG_DEBUG(g_logger) << "do_io<" << hook_fun_name << ">";
+    SYLAR_LOG_STATIC_DEBUG(g_logger) << "do_io<" << hook_fun_name << ">";
 
-    sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
-    if (!ctx) {
+    uint64_t to = -1;
+    fd_kind kind = get_fd_kind(fd, timeout_so, to);
+    if (kind == FD_UNKNOWN) {
         return fun(fd, std::forward<Args>(args)...);
     }
 
-    if (ctx->isClose()) {
+    if (kind == FD_CLOSED) {
         // "Bad file descriptor"，即无效的文件描述符
         // 出现情景：试图操作一个无效的文件描述符；试图在一个已经关闭的文件描述符上进行读写操作
         errno = EBADF;
         return -1;
     }
 
-    if (!ctx->isSocket() || ctx->getUserNonblock()) {
+    if (kind == FD_FILE) {
+        return do_offload(fun, fd, std::forward<Args>(args)...);
+    }
+    if (kind == FD_USER_NONBLOCK || kind == FD_OTHER) {
         return fun(fd, std::forward<Args>(args)...);
     }
-    uint64_t to = ctx->getTimeout(timeout_so);
+    sylar::FiberDeadline::ptr dl = sylar::Fiber::GetThis()->getDeadline();
+    if (!sylar::deadline_merge_timeout(dl, to)) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
     std::shared_ptr<timer_info> tinfo(new timer_info);
 
 retry:
@@ -117,7 +372,7 @@ retry:
     }
     // EAGAIN表示非阻塞操作当前无法完成，但稍后可能会成功
     if (n == -1 && errno == EAGAIN) {
-        SYLAR_LOG_DEBUG(g_logger) << "do_io1<" << hook_fun_name << ">";
+        SYLAR_LOG_STATIC_DEBUG(g_logger) << "do_io1<" << hook_fun_name << ">";
         sylar::IOManager* iom = sylar::IOManager::GetThis();
         sylar::Timer::ptr timer;
         std::weak_ptr<timer_info> winfo(tinfo);
@@ -133,16 +388,15 @@ retry:
             }, winfo);
         }
 
-        int rt = iom->addEvent(fd, (sylar::IOManager::Event)(event));
+        int rt = sylar::wait_event(iom, dl, fd, event);
         if (rt) {
-            SYLAR_LOG_ERROR(g_logger) << hook_fun_name << " addEvent(" 
+            SYLAR_LOG_ERROR_RATE(g_logger, 10) << hook_fun_name << " addEvent(" 
                 << fd << ", " << event << ")";
             if (timer) {
                 timer->cancel();
             }
             return -1;
         } else {
-            sylar::Fiber::YieldToHold();
             if (timer) {
                 timer->cancel();
             }
@@ -150,12 +404,128 @@ retry:
                 errno = tinfo->cancelled;
                 return -1;
             }
+            if (dl && dl->left() == 0) {
+                errno = ETIMEDOUT;
+                return -1;
+            }
             goto retry;
         }
     }
     return n;
 }
 
+// poll/select/epoll_wait的等待者, 任一事件就绪或超时只唤醒协程一次
+struct poll_waiter
+{
+    typedef std::shared_ptr<poll_waiter> ptr;
+
+    void wake() {
+        bool expected = false;
+        if (woken.compare_exchange_strong(expected, true)) {
+            scheduler->schedule(fiber);
+        }
+    }
+
+    std::atomic<bool> woken = {false};
+    sylar::Scheduler* scheduler = nullptr;
+    sylar::Fiber::ptr fiber;
+};
+
+typedef std::vector<std::pair<int, sylar::IOManager::Event> > poll_interest;
+
+// 注册所有句柄事件并挂起协程, 直到任一事件就绪或超时
+static void poll_wait_once(const poll_interest& interest, uint64_t timeout_ms)
+{
+    sylar::IOManager* iom = sylar::IOManager::GetThis();
+    poll_waiter::ptr waiter(new poll_waiter);
+    waiter->scheduler = iom;
+    waiter->fiber = sylar::Fiber::GetThis();
+
+    poll_interest added;
+    bool partial = false;
+    for (auto& i : interest) {
+        // 没有对应事件的条件(NONE)和已被其他协程等待的事件无法注册, 改为短间隔轮询
+        if (i.second == sylar::IOManager::NONE
+                || iom->hasEvent(i.first, i.second)
+                || iom->addEvent(i.first, i.second, [waiter](){ waiter->wake(); }, waiter.get())) {
+            partial = true;
+            continue;
+        }
+        added.push_back(i);
+    }
+    // 一个事件都没有注册时只能靠轮询醒来
+    if (partial || added.empty()) {
+        static const uint64_t s_poll_interval_ms = 10;
+        timeout_ms = std::min(timeout_ms, s_poll_interval_ms);
+    }
+
+    sylar::Timer::ptr timer;
+    if (timeout_ms != ~0ull) {
+        std::weak_ptr<poll_waiter> wwaiter(waiter);
+        timer = iom->addConditionTimer(timeout_ms, [wwaiter](){
+            auto t = wwaiter.lock();
+            if (t) {
+                t->wake();
+            }
+        }, wwaiter);
+    }
+    sylar::Fiber::YieldToHold();
+
+    if (timer) {
+        timer->cancel();
+    }
+    // 已触发的事件不再属于自己, 按标识删除不会误删其他协程之后注册的同一事件
+    for (auto& i : added) {
+        iom->delEvent(i.first, i.second, waiter.get());
+    }
+}
+
+// check以0超时检查就绪状态, 未就绪时挂起协程等待事件, 超时返回0
+template<typename Check>
+static int poll_wait(Check check, const poll_interest& interest, int timeout_ms)
+{
+    int rt = check();
+    if (rt != 0 || timeout_ms == 0) {
+        return rt;
+    }
+    uint64_t now = sylar::GetCurrentMS();
+    uint64_t end = timeout_ms < 0 ? ~0ull : now + timeout_ms;
+    uint64_t left = sylar::get_fiber_deadline_left();
+    if (left != ~0ull && (end == ~0ull || now + left < end)) {
+        end = now + left;
+    }
+    while (true) {
+        if (end != ~0ull && now >= end) {
+            return 0;
+        }
+        poll_wait_once(interest, end == ~0ull ? ~0ull : end - now);
+        rt = check();
+        if (rt != 0) {
+            return rt;
+        }
+        now = sylar::GetCurrentMS();
+    }
+}
+
+static void poll_build_interest(struct pollfd* fds, nfds_t nfds, poll_interest& interest)
+{
+    for (nfds_t i = 0; i < nfds; ++i) {
+        if (fds[i].fd < 0) {
+            continue;
+        }
+        if (fds[i].events & (POLLIN | POLLPRI | POLLRDHUP)) {
+            interest.push_back(std::make_pair(fds[i].fd, sylar::IOManager::READ));
+        }
+        if (fds[i].events & POLLOUT) {
+            interest.push_back(std::make_pair(fds[i].fd, sylar::IOManager::WRITE));
+        }
+        // 带外数据和只等待错误/挂断(events为0)不会触发读写事件
+        if ((fds[i].events & POLLPRI) || !(fds[i].events & (POLLIN | POLLRDHUP | POLLOUT))) {
+            interest.push_back(std::make_pair(fds[i].fd, sylar::IOManager::NONE));
+        }
+    }
+}
+
 extern "C" {
 #define XX(name) name ## _fun name ## _f = nullptr;
     HOOK_FUN(XX)
@@ -166,12 +536,14 @@ unsigned int sleep(unsigned int seconds)
     if (!sylar::t_hook_enable) {
         return sleep_f(seconds);
     }
+    uint64_t ms = seconds * 1000ull;
+    bool clipped = sylar::deadline_clip_sleep(ms);
     sylar::Fiber::ptr fiber = sylar::Fiber::GetThis();
     sylar::IOManager* iom = sylar::IOManager::GetThis();
-    iom->addTimer(seconds * 1000, std::bind((void(sylar::Scheduler::*)
+    iom->addTimer(ms, std::bind((void(sylar::Scheduler::*)
         (sylar::Fiber::ptr, int thread))&sylar::IOManager::schedule, iom, fiber, -1));
     sylar::Fiber::YieldToHold();
-    return 0;
+    return clipped ? seconds - ms / 1000 : 0;
 }
 
 int usleep(useconds_t usec)
@@ -179,11 +551,17 @@ int usleep(useconds_t usec)
     if (!sylar::t_hook_enable) {
         return usleep_f(usec);
     }
+    uint64_t ms = usec / 1000;
+    bool clipped = sylar::deadline_clip_sleep(ms);
     sylar::Fiber::ptr fiber = sylar::Fiber::GetThis();
     sylar::IOManager* iom = sylar::IOManager::GetThis();
-     iom->addTimer(usec / 1000, std::bind((void(sylar::Scheduler::*)
+     iom->addTimer(ms, std::bind((void(sylar::Scheduler::*)
         (sylar::Fiber::ptr, int thread))&sylar::IOManager::schedule, iom, fiber, -1));
     sylar::Fiber::YieldToHold();
+    if (clipped) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
     return 0;
 }
 
@@ -193,13 +571,24 @@ int nanosleep(const struct timespec *req, struct timespec *rem)
     {
         return nanosleep_f(req, rem);
     }
-    int timeout_ms = req->tv_sec * 1000 + req->tv_nsec / 1000 / 1000;
+    uint64_t timeout_ms = req->tv_sec * 1000 + req->tv_nsec / 1000 / 1000;
+    uint64_t request_ms = timeout_ms;
+    bool clipped = sylar::deadline_clip_sleep(timeout_ms);
     sylar::Fiber::ptr fiber = sylar::Fiber::GetThis();
     sylar::IOManager* iom = sylar::IOManager::GetThis();
     iom->addTimer(timeout_ms, [iom, fiber](){
         iom->schedule(fiber);
     });
     sylar::Fiber::YieldToHold();
+    if (clipped) {
+        if (rem) {
+            uint64_t left_ms = request_ms - timeout_ms;
+            rem->tv_sec = left_ms / 1000;
+            rem->tv_nsec = (left_ms % 1000) * 1000 * 1000;
+        }
+        errno = ETIMEDOUT;
+        return -1;
+    }
     return 0;
 }
 
@@ -222,15 +611,13 @@ int connect_with_timeout(int fd, const struct sockaddr* addr, socklen_t addrlen,
     if (!sylar::t_hook_enable) {
         return connect_f(fd, addr, addrlen);
     }
-    sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
-    if(!ctx || ctx->isClose()) {
+    uint64_t to = -1;
+    fd_kind kind = get_fd_kind(fd, SO_SNDTIMEO, to);
+    if (kind == FD_UNKNOWN || kind == FD_CLOSED) {
         errno = EBADF;
         return -1;
     }
-    if (!ctx->isSocket()) {
-        return connect_f(fd, addr, addrlen);
-    }
-    if (ctx->getUserNonblock()) {
+    if (kind != FD_SOCKET) {
         return connect_f(fd, addr, addrlen);
     }
     int n = connect_f(fd, addr, addrlen);
@@ -240,6 +627,11 @@ int connect_with_timeout(int fd, const struct sockaddr* addr, socklen_t addrlen,
     else if (n != -1 || errno != EINPROGRESS) {
         return n;
     }
+    sylar::FiberDeadline::ptr dl = sylar::Fiber::GetThis()->getDeadline();
+    if (!sylar::deadline_merge_timeout(dl, timeout_ms)) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
     sylar::IOManager* iom = sylar::IOManager::GetThis();
     sylar::Timer::ptr timer;
     std::shared_ptr<timer_info> tinfo(new timer_info);
@@ -255,9 +647,8 @@ int connect_with_timeout(int fd, const struct sockaddr* addr, socklen_t addrlen,
         }, winfo);
     }
 
-    int rt = iom->addEvent(fd, sylar::IOManager::WRITE);
+    int rt = sylar::wait_event(iom, dl, fd, sylar::IOManager::WRITE);
     if (rt == 0) {
-        sylar::Fiber::YieldToHold();
         if (timer) {
             timer->cancel();
         }   
@@ -265,11 +656,15 @@ int connect_with_timeout(int fd, const struct sockaddr* addr, socklen_t addrlen,
             errno = tinfo->cancelled;
             return -1;
         }
+        if (dl && dl->left() == 0) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
     } else {
         if (timer) {
             timer->cancel();
         }
-        SYLAR_LOG_ERROR(g_logger) << "connect addEvent(" << fd << ", WRITE) error";
+        SYLAR_LOG_ERROR_RATE(g_logger, 10) << "connect addEvent(" << fd << ", WRITE) error";
     }
     int error = 0;
     socklen_t len = sizeof(int);
@@ -287,7 +682,8 @@ int connect_with_timeout(int fd, const struct sockaddr* addr, socklen_t addrlen,
 
 int connect(int sockfd, const struct sockaddr* addr, socklen_t addrlen)
 {
-    return connect_with_timeout(sockfd, addr, addrlen, sylar::s_connect_timeout);
+    // 配置读取走线程局部快照, 不加锁; -1转换为无超时
+    return connect_with_timeout(sockfd, addr, addrlen, (uint64_t)sylar::g_tcp_connect_timeout->getValue());
 }
 
 int accept(int s, struct sockaddr* addr, socklen_t *addrlen)
@@ -325,6 +721,11 @@ ssize_t recvmsg(int sockfd, struct msghdr* msg, int flags)
     return do_io(sockfd, recvmsg_f, "recvmsg", sylar::IOManager::READ, SO_RCVTIMEO, msg, flags);
 }
 
+int recvmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen, int flags, struct timespec* timeout)
+{
+    return do_io(sockfd, recvmmsg_f, "recvmmsg", sylar::IOManager::READ, SO_RCVTIMEO, msgvec, vlen, flags, timeout);
+}
+
 // //write
 ssize_t write(int fd, const void* buf, size_t count)
 {
@@ -351,14 +752,179 @@ ssize_t sendmsg(int s, const struct msghdr *msg, int flags)
     return do_io(s, sendmsg_f, "sendmsg", sylar::IOManager::WRITE, SO_SNDTIMEO, msg, flags);
 }
 
+int sendmmsg(int s, struct mmsghdr* msgvec, unsigned int vlen, int flags)
+{
+    return do_io(s, sendmmsg_f, "sendmmsg", sylar::IOManager::WRITE, SO_SNDTIMEO, msgvec, vlen, flags);
+}
+
+// zero copy
+ssize_t sendfile(int out_fd, int in_fd, off_t* offset, size_t count)
+{
+    return do_io(out_fd, sendfile_f, "sendfile", sylar::IOManager::WRITE, SO_SNDTIMEO, in_fd, offset, count);
+}
+
+// 以输出端为首参数调用splice, 供do_io在输出端socket上等待可写
+static ssize_t splice_out(int fd_out, loff_t* off_out, int fd_in, loff_t* off_in, size_t len, unsigned int flags)
+{
+    return splice_f(fd_in, off_in, fd_out, off_out, len, flags);
+}
+
+// 输入端为socket时等待可读, 否则输出端为socket时等待可写
+// 中间的pipe应保持阻塞模式且不带SPLICE_F_NONBLOCK, EAGAIN只来自socket一端
+ssize_t splice(int fd_in, loff_t* off_in, int fd_out, loff_t* off_out, size_t len, unsigned int flags)
+{
+    if (!sylar::t_hook_enable) {
+        return splice_f(fd_in, off_in, fd_out, off_out, len, flags);
+    }
+    uint64_t to = -1;
+    fd_kind kind = get_fd_kind(fd_in, SO_RCVTIMEO, to);
+    if (kind == FD_SOCKET || kind == FD_USER_NONBLOCK) {
+        return do_io(fd_in, splice_f, "splice", sylar::IOManager::READ, SO_RCVTIMEO, off_in, fd_out, off_out, len, flags);
+    }
+    kind = get_fd_kind(fd_out, SO_SNDTIMEO, to);
+    if (kind == FD_SOCKET || kind == FD_USER_NONBLOCK) {
+        return do_io(fd_out, splice_out, "splice", sylar::IOManager::WRITE, SO_SNDTIMEO, off_out, fd_in, off_in, len, flags);
+    }
+    return do_io(fd_in, splice_f, "splice", sylar::IOManager::READ, SO_RCVTIMEO, off_in, fd_out, off_out, len, flags);
+}
+
+// poll
+int poll(struct pollfd* fds, nfds_t nfds, int timeout)
+{
+    if (!sylar::t_hook_enable || !sylar::IOManager::GetThis()) {
+        return poll_f(fds, nfds, timeout);
+    }
+    poll_interest interest;
+    poll_build_interest(fds, nfds, interest);
+    return poll_wait([fds, nfds](){
+        return poll_f(fds, nfds, 0);
+    }, interest, timeout);
+}
+
+int ppoll(struct pollfd* fds, nfds_t nfds, const struct timespec* tmo_p, const sigset_t* sigmask)
+{
+    if (!sylar::t_hook_enable || !sylar::IOManager::GetThis()) {
+        return ppoll_f(fds, nfds, tmo_p, sigmask);
+    }
+    int timeout = tmo_p ? tmo_p->tv_sec * 1000 + tmo_p->tv_nsec / 1000 / 1000 : -1;
+    poll_interest interest;
+    poll_build_interest(fds, nfds, interest);
+    return poll_wait([fds, nfds, sigmask](){
+        struct timespec zero = {0, 0};
+        return ppoll_f(fds, nfds, &zero, sigmask);
+    }, interest, timeout);
+}
+
+int select(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds, struct timeval* timeout)
+{
+    if (!sylar::t_hook_enable || !sylar::IOManager::GetThis()) {
+        return select_f(nfds, readfds, writefds, exceptfds, timeout);
+    }
+    fd_set rfds, wfds, efds;
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    FD_ZERO(&efds);
+    poll_interest interest;
+    for (int fd = 0; fd < nfds; ++fd) {
+        if (readfds && FD_ISSET(fd, readfds)) {
+            FD_SET(fd, &rfds);
+            interest.push_back(std::make_pair(fd, sylar::IOManager::READ));
+        }
+        if (writefds && FD_ISSET(fd, writefds)) {
+            FD_SET(fd, &wfds);
+            interest.push_back(std::make_pair(fd, sylar::IOManager::WRITE));
+        }
+        if (exceptfds && FD_ISSET(fd, exceptfds)) {
+            FD_SET(fd, &efds);
+            // 异常条件(带外数据)没有对应的事件
+            interest.push_back(std::make_pair(fd, sylar::IOManager::NONE));
+        }
+    }
+    int timeout_ms = timeout ? timeout->tv_sec * 1000 + timeout->tv_usec / 1000 : -1;
+    uint64_t begin = sylar::GetCurrentMS();
+    // select会修改fd_set, 每次检查前恢复调用方传入的集合
+    int rt = poll_wait([&](){
+        struct timeval zero = {0, 0};
+        if (readfds) {
+            *readfds = rfds;
+        }
+        if (writefds) {
+            *writefds = wfds;
+        }
+        if (exceptfds) {
+            *exceptfds = efds;
+        }
+        return select_f(nfds, readfds, writefds, exceptfds, &zero);
+    }, interest, timeout_ms);
+    if (timeout) {
+        uint64_t used = sylar::GetCurrentMS() - begin;
+        uint64_t left = (uint64_t)timeout_ms > used ? timeout_ms - used : 0;
+        timeout->tv_sec = left / 1000;
+        timeout->tv_usec = (left % 1000) * 1000;
+    }
+    return rt;
+}
+
+int epoll_wait(int epfd, struct epoll_event* events, int maxevents, int timeout)
+{
+    if (!sylar::t_hook_enable || !sylar::IOManager::GetThis()) {
+        return epoll_wait_f(epfd, events, maxevents, timeout);
+    }
+    // epoll句柄本身可被epoll监听, 有就绪事件时可读
+    poll_interest interest;
+    interest.push_back(std::make_pair(epfd, sylar::IOManager::READ));
+    return poll_wait([epfd, events, maxevents](){
+        return epoll_wait_f(epfd, events, maxevents, 0);
+    }, interest, timeout);
+}
+
+// file
+int open(const char* pathname, int flags, ...)
+{
+    mode_t mode = 0;
+    if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE) {
+        va_list va;
+        va_start(va, flags);
+        mode = va_arg(va, mode_t);
+        va_end(va);
+    }
+    if (!open_f) {
+        // 其他库的静态初始化可能早于hook初始化调用open
+        sylar::hook_init();
+    }
+    if (!sylar::t_hook_enable) {
+        return open_f(pathname, flags, mode);
+    }
+    int fd = do_offload(open_f, pathname, flags, mode);
+    if (fd >= 0) {
+        sylar::FdMgr::GetInstance()->get(fd, true);
+    }
+    return fd;
+}
+
+ssize_t pread(int fd, void* buf, size_t count, off_t offset)
+{
+    return do_io(fd, pread_f, "pread", sylar::IOManager::READ, SO_RCVTIMEO, buf, count, offset);
+}
+
+ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset)
+{
+    return do_io(fd, pwrite_f, "pwrite", sylar::IOManager::WRITE, SO_SNDTIMEO, buf, count, offset);
+}
+
+int fsync(int fd)
+{
+    return do_io(fd, fsync_f, "fsync", sylar::IOManager::WRITE, SO_SNDTIMEO);
+}
+
 // //close
 int close(int fd)
 {
     if (!sylar::t_hook_enable) {
         return close_f(fd);
     }
-    sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
-    if (ctx) {
+    uint64_t to = -1;
+    if (get_fd_kind(fd, SO_RCVTIMEO, to) != FD_UNKNOWN) {
         auto iom = sylar::IOManager::GetThis();
         if (iom) {
             iom->cancelAll(fd);
@@ -377,17 +943,23 @@ int fcntl(int fd, int cmd, .../* arg */)
         {
             int arg = va_arg(va, int);
             va_end(va);
-            sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
-            if (!ctx || ctx->isClose() || !ctx->isSocket()) {
-                return fcntl_f(fd, cmd, arg);
-            }
-            ctx->setUserNonblock(arg & O_NONBLOCK);
-            if (ctx->getSysNonblock()) {
-                arg |= O_NONBLOCK;
-            }
-            else 
             {
-                arg &= ~O_NONBLOCK;
+                sylar::EpochGuard guard;
+                sylar::FdCtx* ctx = sylar::FdMgr::GetInstance()->get(fd);
+                if (!ctx || ctx->isClose()) {
+                    return fcntl_f(fd, cmd, arg);
+                }
+                ctx->setUserNonblock(arg & O_NONBLOCK);
+                if (!ctx->isSocket()) {
+                    return fcntl_f(fd, cmd, arg);
+                }
+                if (ctx->getSysNonblock()) {
+                    arg |= O_NONBLOCK;
+                }
+                else 
+                {
+                    arg &= ~O_NONBLOCK;
+                }
             }
             return fcntl_f(fd, cmd, arg);
         }
@@ -395,7 +967,8 @@ int fcntl(int fd, int cmd, .../* arg */)
         {
             va_end(va);
             int arg = fcntl_f(fd, cmd);
-            sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+            sylar::EpochGuard guard;
+            sylar::FdCtx* ctx = sylar::FdMgr::GetInstance()->get(fd);
             if (!ctx || ctx->isClose() || !ctx->isSocket()) {
                 return arg;
             }
@@ -458,11 +1031,11 @@ int ioctl(int d, unsigned long int request, ...)
     va_end(va);
     if (FIONBIO == request) {
         bool user_nonblock = !!*(int*)arg;
-        sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(d);
-        if (!ctx || ctx->isClose() || !ctx->isSocket()) {
-            return ioctl_f(d, request, arg);
-        } 
-        ctx->setUserNonblock(user_nonblock);
+        sylar::EpochGuard guard;
+        sylar::FdCtx* ctx = sylar::FdMgr::GetInstance()->get(d);
+        if (ctx && !ctx->isClose() && ctx->isSocket()) {
+            ctx->setUserNonblock(user_nonblock);
+        }
     }
     return ioctl_f(d, request, arg);
 }
@@ -479,7 +1052,8 @@ int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t
     }
     if (level == SOL_SOCKET) {
         if (optname == SO_RCVTIMEO || optname == SO_SNDTIMEO) {
-            sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(sockfd);
+            sylar::EpochGuard guard;
+            sylar::FdCtx* ctx = sylar::FdMgr::GetInstance()->get(sockfd);
             if (ctx) {
                 const timeval* tv = (const timeval*)optval;
                 ctx->setTimeout(optname, tv->tv_sec * 1000 + tv->tv_usec / 1000);
@@ -2,9 +2,15 @@
 #define __SYLAR_HOOK_H__
 
 #include <fcntl.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/select.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <signal.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -12,6 +18,25 @@ namespace sylar
 {
 bool is_hook_enable();
 void set_hook_enable(bool flag);
+
+/**
+ * @brief 设置当前协程的截止时间
+ * @param[in] timeout_ms 从现在开始计算的超时时间(毫秒)
+ * @details 之后该协程内hook的connect/accept/read/recv/write/send/sleep
+ *          均以fd超时时间与截止时间中较短者为准, 超时返回-1且errno=ETIMEDOUT
+ *          已存在截止时间时只会缩短不会延长, 整个协程只使用一个定时器
+ */
+void set_fiber_deadline(uint64_t timeout_ms);
+
+/**
+ * @brief 清除当前协程的截止时间
+ */
+void clear_fiber_deadline();
+
+/**
+ * @brief 返回当前协程距离截止时间的剩余毫秒数, 无截止时间返回~0ull
+ */
+uint64_t get_fiber_deadline_left();
 }
 
 extern "C" {
@@ -52,6 +77,9 @@ extern recvfrom_fun recvfrom_f;
 typedef ssize_t (*recvmsg_fun)(int sockfd, struct msghdr* msg, int flags);
 extern recvmsg_fun recvmsg_f;
 
+typedef int (*recvmmsg_fun)(int sockfd, struct mmsghdr* msgvec, unsigned int vlen, int flags, struct timespec* timeout);
+extern recvmmsg_fun recvmmsg_f;
+
 //write
 typedef ssize_t (*write_fun)(int fd, const void* bug, size_t count);
 extern write_fun write_f;
@@ -68,6 +96,42 @@ extern sendto_fun sendto_f;
 typedef ssize_t (*sendmsg_fun)(int s, const struct msghdr *msg, int flags);
 extern sendmsg_fun sendmsg_f;
 
+typedef int (*sendmmsg_fun)(int s, struct mmsghdr* msgvec, unsigned int vlen, int flags);
+extern sendmmsg_fun sendmmsg_f;
+
+// zero copy
+typedef ssize_t (*sendfile_fun)(int out_fd, int in_fd, off_t* offset, size_t count);
+extern sendfile_fun sendfile_f;
+
+typedef ssize_t (*splice_fun)(int fd_in, loff_t* off_in, int fd_out, loff_t* off_out, size_t len, unsigned int flags);
+extern splice_fun splice_f;
+
+// poll
+typedef int (*poll_fun)(struct pollfd* fds, nfds_t nfds, int timeout);
+extern poll_fun poll_f;
+
+typedef int (*ppoll_fun)(struct pollfd* fds, nfds_t nfds, const struct timespec* tmo_p, const sigset_t* sigmask);
+extern ppoll_fun ppoll_f;
+
+typedef int (*select_fun)(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds, struct timeval* timeout);
+extern select_fun select_f;
+
+typedef int (*epoll_wait_fun)(int epfd, struct epoll_event* events, int maxevents, int timeout);
+extern epoll_wait_fun epoll_wait_f;
+
+// file
+typedef int (*open_fun)(const char* pathname, int flags, ...);
+extern open_fun open_f;
+
+typedef ssize_t (*pread_fun)(int fd, void* buf, size_t count, off_t offset);
+extern pread_fun pread_f;
+
+typedef ssize_t (*pwrite_fun)(int fd, const void* buf, size_t count, off_t offset);
+extern pwrite_fun pwrite_f;
+
+typedef int (*fsync_fun)(int fd);
+extern fsync_fun fsync_f;
+
 //close
 typedef int (*close_fun)(int fd);
 extern close_fun close_f;
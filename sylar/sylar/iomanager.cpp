@@ -1,6 +1,7 @@
 #include "iomanager.h"
 #include "macro.h"
 #include "log.h"
+#include "hook.h"
 
 #include <errno.h>
 #include <fcntl.h>
@@ -75,6 +76,7 @@ void IOManager::FdContext::resetContext(EventContext& ctx) {
     ctx.scheduler = nullptr;
     ctx.fiber.reset();
     ctx.cb = nullptr;
+    ctx.owner = nullptr;
 }
 
 void IOManager::FdContext::triggerEvent(IOManager::Event event) {
@@ -93,6 +95,7 @@ void IOManager::FdContext::triggerEvent(IOManager::Event event) {
         ctx.scheduler->schedule(&ctx.fiber);
     }
     ctx.scheduler = nullptr;
+    ctx.owner = nullptr;
     return;
 }
 
@@ -144,7 +147,7 @@ void IOManager::contextResize(size_t size) {
     }
 }
 
-int IOManager::addEvent(int fd, Event event, std::function<void()> cb) {
+int IOManager::addEvent(int fd, Event event, std::function<void()> cb, const void* owner) {
     FdContext* fd_ctx = nullptr;
     RWMutexType::ReadLock lock(m_mutex);
     if((int)m_fdContexts.size() > fd) {
@@ -172,7 +175,7 @@ int IOManager::addEvent(int fd, Event event, std::function<void()> cb) {
 
     int rt = epoll_ctl(m_epfd, op, fd, &epevent);
     if(rt) {
-        SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
+        SYLAR_LOG_ERROR_RATE(g_logger, 10) << "epoll_ctl(" << m_epfd << ", "
             << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
             << rt << " (" << errno << ") (" << strerror(errno) << ") fd_ctx->events="
             << (EPOLL_EVENTS)fd_ctx->events;
@@ -189,15 +192,17 @@ int IOManager::addEvent(int fd, Event event, std::function<void()> cb) {
     event_ctx.scheduler = Scheduler::GetThis();
     if(cb) {
         event_ctx.cb.swap(cb);
+        event_ctx.owner = owner;
     } else {
         event_ctx.fiber = Fiber::GetThis();
         SYLAR_ASSERT2(event_ctx.fiber->getState() == Fiber::EXEC
                       ,"state=" << event_ctx.fiber->getState());
+        event_ctx.owner = owner ? owner : event_ctx.fiber.get();
     }
     return 0;
 }
 
-bool IOManager::delEvent(int fd, Event event) {
+bool IOManager::delEvent(int fd, Event event, const void* owner) {
     RWMutexType::ReadLock lock(m_mutex);
     if((int)m_fdContexts.size() <= fd) {
         return false;
@@ -209,6 +214,10 @@ bool IOManager::delEvent(int fd, Event event) {
     if(!(fd_ctx->events & event)) {
         return false;
     }
+    // 事件触发后上下文被重置, 之后其他注册者的同一事件不会被删除
+    if(owner && fd_ctx->getContext(event).owner != owner) {
+        return false;
+    }
 
     Event new_events = (Event)(fd_ctx->events & ~event);
     int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
@@ -218,7 +227,7 @@ bool IOManager::delEvent(int fd, Event event) {
 
     int rt = epoll_ctl(m_epfd, op, fd, &epevent);
     if(rt) {
-        SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
+        SYLAR_LOG_ERROR_RATE(g_logger, 10) << "epoll_ctl(" << m_epfd << ", "
             << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
             << rt << " (" << errno << ") (" << strerror(errno) << ")";
         return false;
@@ -231,7 +240,7 @@ bool IOManager::delEvent(int fd, Event event) {
     return true;
 }
 
-bool IOManager::cancelEvent(int fd, Event event) {
+bool IOManager::cancelEvent(int fd, Event event, const void* owner) {
     RWMutexType::ReadLock lock(m_mutex);
     if((int)m_fdContexts.size() <= fd) {
         return false;
@@ -243,6 +252,9 @@ bool IOManager::cancelEvent(int fd, Event event) {
     if(!(fd_ctx->events & event)) {
         return false;
     }
+    if(owner && fd_ctx->getContext(event).owner != owner) {
+        return false;
+    }
 
     Event new_events = (Event)(fd_ctx->events & ~event);
     int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
@@ -252,7 +264,7 @@ bool IOManager::cancelEvent(int fd, Event event) {
 
     int rt = epoll_ctl(m_epfd, op, fd, &epevent);
     if(rt) {
-        SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
+        SYLAR_LOG_ERROR_RATE(g_logger, 10) << "epoll_ctl(" << m_epfd << ", "
             << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
             << rt << " (" << errno << ") (" << strerror(errno) << ")";
         return false;
@@ -283,7 +295,7 @@ bool IOManager::cancelAll(int fd) {
 
     int rt = epoll_ctl(m_epfd, op, fd, &epevent);
     if(rt) {
-        SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
+        SYLAR_LOG_ERROR_RATE(g_logger, 10) << "epoll_ctl(" << m_epfd << ", "
             << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
             << rt << " (" << errno << ") (" << strerror(errno) << ")";
         return false;
@@ -302,6 +314,18 @@ bool IOManager::cancelAll(int fd) {
     return true;
 }
 
+bool IOManager::hasEvent(int fd, Event event) {
+    RWMutexType::ReadLock lock(m_mutex);
+    if((int)m_fdContexts.size() <= fd) {
+        return false;
+    }
+    FdContext* fd_ctx = m_fdContexts[fd];
+    lock.unlock();
+
+    FdContext::MutexType::Lock lock2(fd_ctx->mutex);
+    return fd_ctx->events & event;
+}
+
 IOManager* IOManager::GetThis() {
     return dynamic_cast<IOManager*>(Scheduler::GetThis());
 }
@@ -328,7 +352,7 @@ bool IOManager::stopping() {
 }
 
 void IOManager::idle() {
-    SYLAR_LOG_DEBUG(g_logger) << "idle";
+    SYLAR_LOG_STATIC_DEBUG(g_logger) << "idle";
     const uint64_t MAX_EVNETS = 256;
     epoll_event* events = new epoll_event[MAX_EVNETS]();
     std::shared_ptr<epoll_event> shared_events(events, [](epoll_event* ptr){
@@ -341,6 +365,9 @@ void IOManager::idle() {
                                      << " idle stopping exit";
             break;
         }
+        if(retire()) {
+            break;
+        }
 
          int rt = 0;
         do {
@@ -351,7 +378,8 @@ void IOManager::idle() {
             } else {
                 next_timeout = MAX_TIMEOUT;
             }
-            rt = epoll_wait(m_epfd, events, MAX_EVNETS, (int)next_timeout);
+            // epoll_wait被hook, 调度器自身必须调用原始函数
+            rt = epoll_wait_f(m_epfd, events, MAX_EVNETS, (int)next_timeout);
             if(rt < 0 && errno == EINTR) {
             } else {
                 break;
@@ -393,7 +421,7 @@ void IOManager::idle() {
             event.events = EPOLLET | left_events;
             int rt2 = epoll_ctl(m_epfd, op, fd_ctx->fd, &event);
             if(rt2) {
-                SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
+                SYLAR_LOG_ERROR_RATE(g_logger, 10) << "epoll_ctl(" << m_epfd << ", "
                     << (EpollCtlOp)op << ", " << fd_ctx->fd << ", " << (EPOLL_EVENTS)event.events << "):"
                     << rt2 << " (" << errno << ") (" << strerror(errno) << ")";
                 continue;
@@ -49,6 +49,8 @@ private:
             Fiber::ptr fiber;
             /// 事件的回调函数
             std::function<void()> cb;
+            /// 注册者标识, 用于只删除/取消自己注册的事件
+            const void* owner = nullptr;
         };
 
         /**
@@ -101,25 +103,28 @@ public:
      * @param[in] fd socket句柄
      * @param[in] event 事件类型
      * @param[in] cb 事件回调函数
+     * @param[in] owner 注册者标识, 为空时取当前协程
      * @return 添加成功返回0,失败返回-1
      */
-    int addEvent(int fd, Event event, std::function<void()> cb = nullptr);
+    int addEvent(int fd, Event event, std::function<void()> cb = nullptr, const void* owner = nullptr);
 
     /**
      * @brief 删除事件
      * @param[in] fd socket句柄
      * @param[in] event 事件类型
+     * @param[in] owner 不为空时只删除该注册者的事件
      * @attention 不会触发事件
      */
-    bool delEvent(int fd, Event event);
+    bool delEvent(int fd, Event event, const void* owner = nullptr);
 
     /**
      * @brief 取消事件
      * @param[in] fd socket句柄
      * @param[in] event 事件类型
+     * @param[in] owner 不为空时只取消该注册者的事件
      * @attention 如果事件存在则触发事件
      */
-    bool cancelEvent(int fd, Event event);
+    bool cancelEvent(int fd, Event event, const void* owner = nullptr);
 
     /**
      * @brief 取消所有事件
@@ -127,6 +132,13 @@ public:
      */
     bool cancelAll(int fd);
 
+    /**
+     * @brief 句柄上是否已经注册了事件
+     * @param[in] fd socket句柄
+     * @param[in] event 事件类型
+     */
+    bool hasEvent(int fd, Event event);
+
     /**
      * @brief 返回当前的IOManager
      */
@@ -1,11 +1,51 @@
 #include "log.h"
+#include <algorithm>
 #include <functional>
 #include <time.h>
 #include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "config.h"
+#include "epoch.h"
+#include "hook.h"
+#include "ring_buffer.h"
+
+#ifdef SYLAR_HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 namespace sylar {
 
+/**
+ * @brief 在作用域内关闭当前线程的hook
+ * @details hook会把文件IO交给线程池并切换协程, 日志分发持有epoch守卫和appender的自旋锁时不能切换
+ */
+struct HookDisabler
+{
+    HookDisabler()
+        :m_enable(is_hook_enable())
+    {
+        set_hook_enable(false);
+    }
+
+    ~HookDisabler()
+    {
+        set_hook_enable(m_enable);
+    }
+
+    bool m_enable;
+};
+
 const char* LogLevel::ToString(LogLevel::Level level)
 {
     switch (level)
@@ -49,187 +89,221 @@ LogLevel::Level LogLevel::FromString(const std::string& str)
 #undef XX
 }
 
-LogEventWrap::LogEventWrap(LogEvent::ptr e)
-    : m_event(e)
+LogStream::LogStream()
+    : m_os(&m_buf)
 {
-
 }
 
-LogEventWrap::~LogEventWrap()
+LogStream::Buf::int_type LogStream::Buf::overflow(int_type c)
 {
-    m_event->getLogger()->log(m_event->getLevel(), m_event);
+    if (c != traits_type::eof())
+    {
+        str.push_back(traits_type::to_char_type(c));
+    }
+    return c;
 }
 
-std::stringstream& LogEventWrap::getSS()
+std::streamsize LogStream::Buf::xsputn(const char* s, std::streamsize n)
 {
-    return m_event->getSS();
+    str.append(s, n);
+    return n;
 }
 
-void LogEvent::format(const char* fmt, ...)
+void LogStream::reset()
 {
-    va_list al;
-    va_start(al, fmt);
-    format(fmt, al);
-    va_end(al);
-}
-
-void LogEvent::format(const char* fmt, va_list al) {
-    char* buf = nullptr;
-    int len = vasprintf(&buf, fmt, al);
-    if(len != -1) {
-        m_ss << std::string(buf, len);
-        free(buf);
+    // 超长日志留下的大块内存不保留
+    if (m_buf.str.capacity() > 64 * 1024)
+    {
+        std::string().swap(m_buf.str);
     }
-}
-
-class MessageFormatItem : public LogFormatter::FormatItem
-{
-public:
-    MessageFormatItem(const std::string& fmt = "") {} 
-    virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override
+    else
     {
-        os << event->getContent();
+        m_buf.str.clear();
     }
-};
+    m_os.clear();
+    m_os.flags(std::ios_base::dec | std::ios_base::skipws);
+    m_os.precision(6);
+    m_os.width(0);
+    m_os.fill(' ');
+}
 
-class LevelFormatItem : public LogFormatter::FormatItem
+/**
+ * @brief 线程局部的LogStream空闲列表
+ * @details 事件所在的协程可能在输出时被切换到别的线程, 所以按指针归还而不是按嵌套深度
+ */
+struct LogStreamPool
 {
-public:
-    LevelFormatItem(const std::string& fmt = "") {} 
-    virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override
+    /// 空闲列表上限, 超出的直接释放
+    static const size_t s_max_free = 16;
+
+    ~LogStreamPool()
     {
-        os << LogLevel::ToString(level);
+        for (auto i : free)
+        {
+            delete i;
+        }
     }
+
+    std::vector<LogStream*> free;
 };
 
-class ElapseFormatItem : public LogFormatter::FormatItem
+static thread_local LogStreamPool t_stream_pool;
+
+LogStream* LogStream::Acquire()
 {
-public:
-    ElapseFormatItem(const std::string& fmt = "") {} 
-    virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override
+    std::vector<LogStream*>& free = t_stream_pool.free;
+    if (free.empty())
     {
-        os << event->getElapse();
+        return new LogStream;
     }
-};
+    LogStream* stream = free.back();
+    free.pop_back();
+    return stream;
+}
 
-class NameFormatItem : public LogFormatter::FormatItem
+void LogStream::Release(LogStream* stream)
 {
-public:
-    NameFormatItem(const std::string& fmt = "") {} 
-    virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override
+    std::vector<LogStream*>& free = t_stream_pool.free;
+    if (free.size() >= LogStreamPool::s_max_free)
     {
-        os << event->getLogger()->getName(); 
+        delete stream;
+        return;
     }
-};
+    stream->reset();
+    free.push_back(stream);
+}
 
-class ThreadIdFormatItem : public LogFormatter::FormatItem
+LogEventWrap::~LogEventWrap()
 {
-public:
-    ThreadIdFormatItem(const std::string& fmt = "") {} 
-    virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override
-    {
-        os << event->getThreadId(); 
-    }
-};
+    m_event.getLogger()->log(m_event.getLevel(), m_event);
+}
 
-class ThreadNameFormatItem : public LogFormatter::FormatItem
+/**
+ * @brief 已解析的调用点列表, 不释放, 避免退出时析构顺序问题
+ */
+struct LogSiteList
 {
-public:
-    ThreadNameFormatItem(const std::string& fmt = "") {} 
-    virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override
-    {
-        os << event->getThreadName(); 
-    }
+    Mutex mutex;
+    LogSite* head = nullptr;
 };
 
+static LogSiteList& GetLogSites()
+{
+    static LogSiteList* s_sites = new LogSiteList;
+    return *s_sites;
+}
 
-class FiberIdFormatItem : public LogFormatter::FormatItem
+Logger* LogSite::resolve(Logger* logger)
 {
-public:
-    FiberIdFormatItem(const std::string& fmt = "") {} 
-    virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override
+    LogSiteList& sites = GetLogSites();
+    Mutex::Lock lock(sites.mutex);
+    if (m_state.load(std::memory_order_relaxed) == UNRESOLVED)
     {
-        os << event->getFiberId(); 
+        m_logger.store(logger, std::memory_order_relaxed);
+        m_next = sites.head;
+        sites.head = this;
+        m_state.store(logger->getLevel() <= m_level ? ENABLED : DISABLED
+                      ,std::memory_order_release);
     }
-};
+    return m_state.load(std::memory_order_relaxed) == ENABLED
+        ? m_logger.load(std::memory_order_relaxed) : nullptr;
+}
 
-class DateTimeFormatItem : public LogFormatter::FormatItem
+void LogSite::Refresh(Logger* logger)
 {
-public:
-    DateTimeFormatItem(const std::string& format = "%Y-%m-%d %H:%M:%S")
-        : m_format(format)
+    LogSiteList& sites = GetLogSites();
+    Mutex::Lock lock(sites.mutex);
+    for (LogSite* site = sites.head; site; site = site->m_next)
     {
-        if (m_format.empty())
+        if (site->m_logger.load(std::memory_order_relaxed) == logger)
         {
-            m_format = "%Y-%m-%d %H:%M:%S";
+            site->m_state.store(logger->getLevel() <= site->m_level ? ENABLED : DISABLED
+                                ,std::memory_order_release);
         }
     }
+}
 
-    virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override
+void LogSite::Unregister(Logger* logger)
+{
+    LogSiteList& sites = GetLogSites();
+    Mutex::Lock lock(sites.mutex);
+    LogSite** prev = &sites.head;
+    while (LogSite* site = *prev)
     {
-        struct tm tm;
-        time_t time = event->getTime();
-        localtime_r(&time, &tm);
-        char buf[64];
-        strftime(buf, sizeof(buf), m_format.c_str(), &tm);
-        os << buf; 
+        if (site->m_logger.load(std::memory_order_relaxed) == logger)
+        {
+            site->m_state.store(UNRESOLVED, std::memory_order_release);
+            *prev = site->m_next;
+            site->m_next = nullptr;
+        }
+        else
+        {
+            prev = &site->m_next;
+        }
     }
-private:
-    std::string m_format;
-};
+}
 
-class FilenameFormatItem : public LogFormatter::FormatItem
+LogRateLimiter::LogRateLimiter(uint32_t per_sec)
+    :m_tat(0)
+    ,m_suppressed(0)
 {
-public:
-    FilenameFormatItem(const std::string& fmt = "") {} 
-    virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override
-    {
-        os << event->getFile(); 
+    if (per_sec == 0) {
+        per_sec = 1;
     }
-};
+    m_interval = std::max<uint64_t>(1000 * 1000 / per_sec, 1);
+    m_tolerance = m_interval * (per_sec - 1);
+}
 
-class LineFormatItem : public LogFormatter::FormatItem
+uint64_t LogRateLimiter::NowUS()
 {
-public:
-    LineFormatItem(const std::string& fmt = "") {} 
-    virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override
-    {
-        os << event->getLine(); 
-    }
-};
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec * 1000 * 1000ul + ts.tv_nsec / 1000;
+}
 
-class NewLineFormatItem : public LogFormatter::FormatItem
+void LogEvent::format(const char* fmt, ...)
 {
-public:
-    NewLineFormatItem(const std::string& fmt = "") {} 
-    virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override
+    va_list al;
+    va_start(al, fmt);
+    format(fmt, al);
+    va_end(al);
+}
+
+void LogEvent::format(const char* fmt, va_list al) {
+    // 直接格式化到消息缓冲区末尾, 空间不够时扩容后再格式化一次
+    std::string& str = m_stream->str();
+    size_t old = str.size();
+    size_t avail = std::max<size_t>(str.capacity() - old, 128);
+    str.resize(old + avail);
+    va_list copy;
+    va_copy(copy, al);
+    int len = vsnprintf(&str[old], avail, fmt, copy);
+    va_end(copy);
+    if (len < 0)
     {
-        os << std::endl; 
+        str.resize(old);
+        return;
     }
-};
-
-class StringFormatItem : public LogFormatter::FormatItem
-{
-public:
-    StringFormatItem(const std::string& str)
-        : m_string(str) {} 
-    virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override
+    if ((size_t)len >= avail)
     {
-        os << m_string; 
+        str.resize(old + len + 1);
+        vsnprintf(&str[old], len + 1, fmt, al);
     }
-private:
-    std::string m_string;
-};
+    str.resize(old + len);
+}
 
-class TabFormatItem : public LogFormatter::FormatItem
+LogEvent::LogEvent(Logger* logger, LogLevel::Level level, const char* file, int32_t line)
+    : m_file(file)
+    , m_line(line)
+    , m_threadId(GetThreadId())
+    , m_fiberId(GetFiberId())
+    , m_time(time(0))
+    , m_threadName(&Thread::GetName())
+    , m_stream(LogStream::Acquire())
+    , m_logger(logger)
+    , m_level(level)
 {
-public:
-    TabFormatItem(const std::string& str = "") {} 
-    virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override
-    {
-        os << "\t"; 
-    }
-};
+}
 
 LogEvent::LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level, 
         const char* file, int32_t line, uint32_t elapse,
@@ -241,175 +315,1491 @@ LogEvent::LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level,
     , m_threadId(thread_id)
     , m_fiberId(fiber_id)
     , m_time(time)
-    , m_threadName(thread_name)
-    , m_logger(logger)
+    , m_threadName(&m_threadNameCopy)
+    , m_threadNameCopy(thread_name)
+    , m_stream(LogStream::Acquire())
+    , m_logger(logger.get())
+    , m_holder(logger)
     , m_level(level)
 {
     
 }
 
+LogEvent::~LogEvent()
+{
+    LogStream::Release(m_stream);
+}
+
 Logger::Logger(const std::string& name)
     : m_name(name)
     , m_level(LogLevel::Level::DEBUG)
+    , m_appenders(new AppenderSnapshot(new AppenderList))
 {
     m_formatter.reset(new LogFormatter("%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n"));
 }
 
+Logger::~Logger()
+{
+    LogSite::Unregister(this);
+    delete m_appenders.load(std::memory_order_relaxed);
+}
+
+void Logger::setLevel(LogLevel::Level level)
+{
+    m_level.store(level, std::memory_order_relaxed);
+    LogSite::Refresh(this);
+}
+
+void Logger::publishAppenders(AppenderList* list)
+{
+    AppenderSnapshot* old = m_appenders.exchange(new AppenderSnapshot(list), std::memory_order_acq_rel);
+    // 释放的只是发布者持有的引用, 正在写日志的线程仍持有自己的引用
+    Epoch::Retire(old);
+}
+
+/**
+ * @brief appender列表很少修改, 修改后直接推进两次epoch,
+ *        没有线程正在写日志时旧列表和被删除的appender立即释放
+ */
+static void ReclaimAppenders()
+{
+    Epoch::Reclaim();
+    Epoch::Reclaim();
+}
+
 void Logger::addAppender(LogAppender::ptr appender)
+{
+    {
+        MutexType::Lock lock(m_mutex);
+        if (!appender->getFormatter())
+        {
+            MutexType::Lock ll(appender->m_mutex);
+            appender->m_formatter = m_formatter;
+        }
+        AppenderList* list = new AppenderList(**m_appenders.load(std::memory_order_relaxed));
+        list->push_back(appender);
+        publishAppenders(list);
+    }
+    ReclaimAppenders();
+}
+
+void Logger::delAppender(LogAppender::ptr appender)
+{
+    {
+        MutexType::Lock lock(m_mutex);
+        AppenderList* list = new AppenderList(**m_appenders.load(std::memory_order_relaxed));
+        auto it = std::find(list->begin(), list->end(), appender);
+        if (it == list->end())
+        {
+            delete list;
+            return;
+        }
+        list->erase(it);
+        publishAppenders(list);
+    }
+    ReclaimAppenders();
+}
+
+void Logger::clearAppenders()
+{
+    {
+        MutexType::Lock lock(m_mutex);
+        publishAppenders(new AppenderList);
+    }
+    ReclaimAppenders();
+}
+
+void Logger::setFormatter(LogFormatter::ptr val)
+{
+    MutexType::Lock lock(m_mutex);
+    m_formatter = val;
+    for (auto& i : **m_appenders.load(std::memory_order_relaxed))
+    {
+        MutexType::Lock ll(i->m_mutex);
+        if (!i->m_hasFormatter) {
+            i->m_formatter = m_formatter;
+        }
+    }
+}
+void Logger::setFormatter(const std::string& val)
+{
+    sylar::LogFormatter::ptr new_val(new sylar::LogFormatter(val));
+    if (new_val->isError())
+    {
+        std::cout << "Logger setFormatter name=" << m_name
+                << " value=" << val << " invalid formatter"
+                << std::endl;
+        return ;
+    }
+    setFormatter(new_val);
+}
+
+LogFormatter::ptr Logger::getFormatter()
+{
+    MutexType::Lock lock(m_mutex);
+    return m_formatter;
+}
+
+std::string Logger::toYamlString()
+{
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["name"] = m_name;
+    node["level"] = LogLevel::ToString(m_level);
+    if (m_formatter){
+        node["formatter"] = m_formatter->getPattern();
+    }
+    for (auto& i : **m_appenders.load(std::memory_order_relaxed))
+    {
+        node["appenders"].push_back(YAML::Load(i->toYamlString()));
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+void Logger::log(LogLevel::Level level, LogEvent::ptr event)
+{
+    log(level, *event);
+}
+
+void Logger::log(LogLevel::Level level, const LogEvent& event)
+{
+    if (level < getLevel())
+    {
+        return;
+    }
+    AppenderSnapshot appenders;
+    {
+        EpochGuard guard;
+        appenders = *m_appenders.load(std::memory_order_acquire);
+    }
+    // appender在自旋锁内做IO, 关闭hook保证不会让出协程
+    HookDisabler disabler;
+    if (!appenders->empty())
+    {
+        for (auto& i : *appenders)
+        {
+            i->log(this, level, event);
+        }
+    }
+    else if (m_root)
+    {
+        m_root->log(level, event);
+    }
+}
+    
+void Logger::debug(LogEvent::ptr event)
+{
+    log(LogLevel::Level::DEBUG, event);
+}
+
+void Logger::info(LogEvent::ptr event)
+{
+    log(LogLevel::Level::INFO, event);
+}
+
+void Logger::warn(LogEvent::ptr event)
+{
+    log(LogLevel::Level::WARN, event);
+}
+
+void Logger::fatal(LogEvent::ptr event)
+{
+    log(LogLevel::Level::FATAL, event);
+}
+
+void Logger::error(LogEvent::ptr event)
+{
+    log(LogLevel::Level::ERROR, event);
+}
+
+void LogAppender::setFormatter(LogFormatter::ptr formatter)
+ { 
+    MutexType::Lock lock(m_mutex);
+    m_formatter = formatter; 
+    if (m_formatter){
+        m_hasFormatter = true;
+    } else {
+        m_hasFormatter = false;
+    }
+}
+
+LogFormatter::ptr LogAppender::getFormatter() 
+{ 
+    MutexType::Lock lock(m_mutex);
+    return m_formatter; 
+}
+
+void StdoutLogAppender::log(Logger* logger, LogLevel::Level level, const LogEvent& event)
+{
+    if (level >= getLevel())
+    {
+        std::string& buf = LogFormatter::GetThreadBuffer();
+        {
+            MutexType::Lock lock(m_mutex);
+            m_formatter->format(buf, logger, level, event);
+        }
+        // 与stdio同步的cout每次write自带FILE锁, 整行输出不会交错
+        std::cout.write(buf.data(), buf.size());
+    }
+}
+
+std::string StdoutLogAppender::toYamlString()
 {
     MutexType::Lock lock(m_mutex);
-    if (!appender->getFormatter())
+    YAML::Node node;
+    node["type"] = "StdoutLogAppender";
+    if (m_level != LogLevel::Level::UNKNOW)
+        node["level"] = LogLevel::ToString(m_level);
+    if (m_hasFormatter && m_formatter){
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+/// ReopenLogFiles计数
+static std::atomic<uint64_t> s_reopen_gen(0);
+
+void ReopenLogFiles()
+{
+    s_reopen_gen.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void OnSighupReopen(int)
+{
+    ReopenLogFiles();
+}
+
+bool InstallLogReopenSignalHandler()
+{
+    struct sigaction old_action;
+    if (sigaction(SIGHUP, nullptr, &old_action) != 0)
+    {
+        return false;
+    }
+    if (old_action.sa_handler == &OnSighupReopen)
+    {
+        return true;
+    }
+    // 不覆盖应用自己的处理函数, 它可以自行调用ReopenLogFiles
+    if (old_action.sa_handler != SIG_DFL)
+    {
+        return false;
+    }
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = &OnSighupReopen;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    return sigaction(SIGHUP, &action, nullptr) == 0;
+}
+
+/**
+ * @brief 卸载InstallLogReopenSignalHandler安装的处理函数, 恢复默认行为
+ */
+static void UninstallLogReopenSignalHandler()
+{
+    struct sigaction old_action;
+    if (sigaction(SIGHUP, nullptr, &old_action) == 0
+            && old_action.sa_handler == &OnSighupReopen)
+    {
+        signal(SIGHUP, SIG_DFL);
+    }
+}
+
+/**
+ * @brief 以追加方式打开日志文件
+ */
+static int OpenLogFile(const std::string& filename)
+{
+    HookDisabler disabler;
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd == -1)
+    {
+        std::cout << "open log file " << filename << " failed errno="
+                  << errno << " errstr=" << strerror(errno) << std::endl;
+    }
+    return fd;
+}
+
+/**
+ * @brief 写出全部数据, 出错时丢弃剩余数据
+ */
+static void WriteAll(int fd, const char* data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+FileLogAppender::FileLogAppender(const std::string& filename)
+    : m_filename(filename)
+{
+    reopen();
+}
+
+FileLogAppender::~FileLogAppender()
+{
+    if (m_fd != -1)
+    {
+        close(m_fd);
+    }
+}
+
+void FileLogAppender::log(Logger* logger, LogLevel::Level level, const LogEvent& event)
+{
+    if (level >= getLevel())
+    {
+        MutexType::Lock lock(m_mutex);
+        if (m_reopenGen != s_reopen_gen.load(std::memory_order_relaxed))
+        {
+            reopenLocked();
+        }
+        std::string& buf = LogFormatter::GetThreadBuffer();
+        m_formatter->format(buf, logger, level, event);
+        WriteAll(m_fd, buf.data(), buf.size());
+    }
+}
+
+std::string FileLogAppender::toYamlString()
+{
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "FileLogAppender";
+    node["file"] = m_filename;
+    node["level"] = LogLevel::ToString(m_level);
+    if (m_hasFormatter && m_formatter){
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+bool FileLogAppender::reopen()
+{
+    MutexType::Lock lock(m_mutex);
+    return reopenLocked();
+}
+
+bool FileLogAppender::reopenLocked()
+{
+    m_reopenGen = s_reopen_gen.load(std::memory_order_relaxed);
+    if (m_fd != -1)
+    {
+        close(m_fd);
+    }
+    m_fd = OpenLogFile(m_filename);
+    return m_fd != -1;
+}
+
+/**
+ * @brief 滚动后的文件名: 文件名.开始时间[.序号], 避开已存在的文件和压缩文件
+ */
+static std::string RotatedFileName(const std::string& filename, time_t start)
+{
+    char tbuf[32];
+    struct tm tm;
+    localtime_r(&start, &tm);
+    strftime(tbuf, sizeof(tbuf), "%Y%m%d-%H%M%S", &tm);
+    std::string target = filename + "." + tbuf;
+    struct stat st;
+    for (int i = 1; stat(target.c_str(), &st) == 0 || stat((target + ".gz").c_str(), &st) == 0; ++i)
+    {
+        target = filename + "." + tbuf + "." + std::to_string(i);
+    }
+    return target;
+}
+
+/**
+ * @brief 删除超出数量的滚动文件, 按修改时间保留最新的max_files个
+ */
+static void PruneRotatedFiles(const std::string& filename, uint32_t max_files)
+{
+    if (!max_files)
+    {
+        return;
+    }
+    size_t pos = filename.rfind('/');
+    std::string dir = pos == std::string::npos ? "." : filename.substr(0, pos ? pos : 1);
+    std::string prefix = (pos == std::string::npos ? filename : filename.substr(pos + 1)) + ".";
+    DIR* d = opendir(dir.c_str());
+    if (!d)
+    {
+        return;
+    }
+    std::vector<std::pair<uint64_t, std::string> > files;
+    struct dirent* dp = nullptr;
+    while ((dp = readdir(d)) != nullptr)
+    {
+        std::string name = dp->d_name;
+        // 只处理 前缀+数字开头 的滚动文件
+        if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0
+                || !isdigit(name[prefix.size()]))
+        {
+            continue;
+        }
+        std::string path = dir + "/" + name;
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0)
+        {
+            files.push_back(std::make_pair(st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec, path));
+        }
+    }
+    closedir(d);
+    if (files.size() <= max_files)
+    {
+        return;
+    }
+    std::sort(files.begin(), files.end());
+    for (size_t i = 0; i < files.size() - max_files; ++i)
+    {
+        unlink(files[i].second.c_str());
+    }
+}
+
+const char* RotatingFileLogAppender::IntervalToString(Interval interval)
+{
+    switch (interval)
+    {
+        case Interval::HOURLY:
+            return "hourly";
+        case Interval::DAILY:
+            return "daily";
+        default:
+            return "none";
+    }
+}
+
+RotatingFileLogAppender::Interval RotatingFileLogAppender::IntervalFromString(const std::string& str)
+{
+    if (str == "hourly" || str == "HOURLY")
+    {
+        return Interval::HOURLY;
+    }
+    if (str == "daily" || str == "DAILY")
+    {
+        return Interval::DAILY;
+    }
+    return Interval::NONE;
+}
+
+RotatingFileLogAppender::RotatingFileLogAppender(const std::string& filename
+                                                 ,uint64_t max_size
+                                                 ,Interval interval
+                                                 ,uint32_t max_files
+                                                 ,bool compress)
+    : m_filename(filename)
+    , m_maxSize(max_size)
+    , m_interval(interval)
+    , m_maxFiles(max_files)
+    , m_compress(compress)
+    , m_pending(false)
+    , m_stopping(false)
+    , m_rotations(0)
+{
+    {
+        MutexType::Lock lock(m_mutex);
+        openLocked(time(0));
+    }
+    m_thread.reset(new Thread(std::bind(&RotatingFileLogAppender::run, this), "log_rotate"));
+}
+
+RotatingFileLogAppender::~RotatingFileLogAppender()
+{
+    m_stopping = true;
+    m_sem.notify();
+    m_thread->join();
+    if (m_fd != -1)
+    {
+        close(m_fd);
+    }
+}
+
+bool RotatingFileLogAppender::openLocked(time_t now)
+{
+    m_reopenGen = s_reopen_gen.load(std::memory_order_relaxed);
+    if (m_fd != -1)
+    {
+        close(m_fd);
+    }
+    m_fd = OpenLogFile(m_filename);
+    struct stat st;
+    m_size = (m_fd != -1 && fstat(m_fd, &st) == 0) ? st.st_size : 0;
+    m_segmentStart = now;
+    m_nextRotate = nextRotateTime(now);
+    return m_fd != -1;
+}
+
+time_t RotatingFileLogAppender::nextRotateTime(time_t now) const
+{
+    if (m_interval == Interval::NONE)
+    {
+        return 0;
+    }
+    struct tm tm;
+    localtime_r(&now, &tm);
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    if (m_interval == Interval::HOURLY)
+    {
+        tm.tm_hour += 1;
+    }
+    else
+    {
+        tm.tm_hour = 0;
+        tm.tm_mday += 1;
+    }
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+void RotatingFileLogAppender::log(Logger* logger, LogLevel::Level level, const LogEvent& event)
+{
+    if (level < getLevel())
+    {
+        return;
+    }
+    bool need_rotate = false;
+    {
+        MutexType::Lock lock(m_mutex);
+        if (m_reopenGen != s_reopen_gen.load(std::memory_order_relaxed))
+        {
+            openLocked(event.getTime());
+        }
+        std::string& buf = LogFormatter::GetThreadBuffer();
+        m_formatter->format(buf, logger, level, event);
+        WriteAll(m_fd, buf.data(), buf.size());
+        m_size += buf.size();
+        need_rotate = (m_maxSize && m_size >= m_maxSize)
+            || (m_nextRotate && (time_t)event.getTime() >= m_nextRotate);
+    }
+    if (need_rotate && !m_pending.load(std::memory_order_relaxed))
+    {
+        rotate();
+    }
+}
+
+void RotatingFileLogAppender::rotate()
+{
+    if (!m_pending.exchange(true))
+    {
+        m_sem.notify();
+    }
+}
+
+std::string RotatingFileLogAppender::toYamlString()
+{
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "RotatingFileLogAppender";
+    node["file"] = m_filename;
+    node["level"] = LogLevel::ToString(m_level);
+    node["max_size"] = m_maxSize;
+    node["interval"] = IntervalToString(m_interval);
+    node["max_files"] = m_maxFiles;
+    node["compress"] = m_compress;
+    if (m_hasFormatter && m_formatter){
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+void RotatingFileLogAppender::run()
+{
+    while (!m_stopping)
+    {
+        uint64_t wait_ms = 1000 * 60;
+        bool due = false;
+        {
+            MutexType::Lock lock(m_mutex);
+            time_t now = time(0);
+            if (m_nextRotate)
+            {
+                due = now >= m_nextRotate;
+                wait_ms = due ? 0 : std::min<uint64_t>(wait_ms, (m_nextRotate - now) * 1000);
+            }
+        }
+        // 按时间滚动时即使没有新日志也要到点滚动
+        if (!due && !m_pending)
+        {
+            m_sem.waitFor(wait_ms);
+            continue;
+        }
+        doRotate();
+    }
+}
+
+/**
+ * @brief 压缩文件, 成功后删除原文件
+ */
+static bool CompressFile(const std::string& path)
+{
+#ifdef SYLAR_HAVE_ZLIB
+    std::string gz = path + ".gz";
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return false;
+    }
+    gzFile out = gzopen(gz.c_str(), "wb");
+    if (!out)
+    {
+        close(fd);
+        return false;
+    }
+    char buf[64 * 1024];
+    bool ok = true;
+    while (true)
+    {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            ok = n == 0;
+            break;
+        }
+        if (gzwrite(out, buf, n) != n)
+        {
+            ok = false;
+            break;
+        }
+    }
+    close(fd);
+    ok = (gzclose(out) == Z_OK) && ok;
+    if (!ok)
+    {
+        unlink(gz.c_str());
+        return false;
+    }
+    return unlink(path.c_str()) == 0;
+#else
+    pid_t pid;
+    const char* argv[] = {"gzip", "-f", path.c_str(), nullptr};
+    if (posix_spawnp(&pid, "gzip", nullptr, nullptr, (char* const*)argv, environ) != 0)
+    {
+        return false;
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+}
+
+void RotatingFileLogAppender::doRotate()
+{
+    m_pending = false;
+    time_t now = time(0);
+    time_t start;
+    bool empty;
+    {
+        MutexType::Lock lock(m_mutex);
+        start = m_segmentStart;
+        empty = m_size == 0;
+    }
+    if (empty)
+    {
+        MutexType::Lock lock(m_mutex);
+        m_segmentStart = now;
+        m_nextRotate = nextRotateTime(now);
+        return;
+    }
+
+    std::string target = RotatedFileName(m_filename, start);
+
+    // 重命名后写线程仍然写入旧文件, 直到换成新的fd, 这部分日志属于滚动出去的文件
+    if (rename(m_filename.c_str(), target.c_str()) != 0)
+    {
+        std::cout << "rotate log file " << m_filename << " failed errno="
+                  << errno << " errstr=" << strerror(errno) << std::endl;
+        MutexType::Lock lock(m_mutex);
+        openLocked(now);
+        return;
+    }
+    int fd = OpenLogFile(m_filename);
+    int old_fd;
+    {
+        MutexType::Lock lock(m_mutex);
+        old_fd = m_fd;
+        m_fd = fd;
+        m_size = 0;
+        m_segmentStart = now;
+        m_nextRotate = nextRotateTime(now);
+    }
+    if (old_fd != -1)
+    {
+        close(old_fd);
+    }
+    if (m_compress)
+    {
+        CompressFile(target);
+    }
+    prune();
+    ++m_rotations;
+}
+
+void RotatingFileLogAppender::prune()
+{
+    PruneRotatedFiles(m_filename, m_maxFiles);
+}
+
+/**
+ * @brief 映射的段文件
+ */
+struct MmapLogAppender::Segment
+{
+    Segment(int fd_, char* base_, uint64_t size_, uint64_t offset_, time_t start_
+            ,const struct stat& st)
+        : fd(fd_)
+        , base(base_)
+        , size(size_)
+        , start(start_)
+        , dev(st.st_dev)
+        , ino(st.st_ino)
+        , ownsFile(true)
+        , offset(offset_)
+        , end(size_)
+        , synced(offset_)
+    {
+    }
+
+    /**
+     * @brief 所有写线程都已离开, 截断到实际长度
+     * @details 文件仍被新段映射时不能截断, 否则新段超出文件末尾的页访问时SIGBUS
+     */
+    ~Segment()
+    {
+        // 已同步的页是干净的, 这里只写回最后一个同步周期的数据
+        msync(base, std::min(used(), size), MS_SYNC);
+        munmap(base, size);
+        if (ownsFile && ftruncate(fd, used()) != 0)
+        {
+            std::cout << "truncate mmap log segment failed errno=" << errno
+                      << " errstr=" << strerror(errno) << std::endl;
+        }
+        close(fd);
+    }
+
+    /**
+     * @brief 是否映射的是st描述的文件
+     */
+    bool sameFile(const struct stat& st) const
+    {
+        return dev == st.st_dev && ino == st.st_ino;
+    }
+
+    /**
+     * @brief 已写入的长度, 放不下的记录不计入
+     */
+    uint64_t used() const
+    {
+        return std::min(offset.load(std::memory_order_relaxed)
+                        ,end.load(std::memory_order_relaxed));
+    }
+
+    int fd;
+    char* base;
+    uint64_t size;
+    time_t start;
+    dev_t dev;
+    ino_t ino;
+    /// 析构时是否截断文件, 由m_rollMutex保护, 换下后不再修改
+    bool ownsFile;
+    /// bump指针, 可能超过size
+    std::atomic<uint64_t> offset;
+    /// 第一条放不下的记录的位置
+    std::atomic<uint64_t> end;
+    /// 已msync的位置, 由m_syncMutex保护
+    uint64_t synced;
+};
+
+/**
+ * @brief 写线程计数的RAII守卫, 守卫期间读到的段不会被释放
+ * @details 先增加计数再读取m_segment, 都是seq_cst, 后台线程看到计数归零前不会释放
+ *          守卫之前读到的段
+ */
+class MmapLogAppender::PinGuard : Noncopyable
+{
+public:
+    PinGuard(MmapLogAppender* appender)
+        : m_pins(appender->m_pins)
+        , m_idx(appender->m_pinPhase.load(std::memory_order_relaxed) & 1)
+    {
+        m_pins[m_idx].fetch_add(1);
+    }
+
+    ~PinGuard()
+    {
+        m_pins[m_idx].fetch_sub(1, std::memory_order_release);
+    }
+private:
+    std::atomic<uint32_t>* m_pins;
+    uint32_t m_idx;
+};
+
+MmapLogAppender::MmapLogAppender(const std::string& filename
+                                 ,uint64_t segment_size
+                                 ,uint32_t sync_interval
+                                 ,uint32_t max_files)
+    : m_filename(filename)
+    , m_segmentSize(std::max<uint64_t>(segment_size, 4096))
+    , m_syncInterval(sync_interval ? sync_interval : 1000)
+    , m_maxFiles(max_files)
+    , m_segment(nullptr)
+    , m_reopenGen(s_reopen_gen.load(std::memory_order_relaxed))
+    , m_pinPhase(0)
+    , m_pendingPrune(false)
+    , m_stopping(false)
+    , m_rollovers(0)
+{
+    m_pins[0] = 0;
+    m_pins[1] = 0;
+    m_segment = openSegment(time(0));
+    m_thread.reset(new Thread(std::bind(&MmapLogAppender::run, this), "log_mmap"));
+}
+
+MmapLogAppender::~MmapLogAppender()
+{
+    m_stopping = true;
+    m_sem.notify();
+    m_thread->join();
+    sync();
+    // 已不在任何日志器中, 没有并发的写线程
+    delete m_segment.exchange(nullptr);
+    for (auto& v : {&m_retired, &m_graceWait, &m_reclaimable})
+    {
+        for (auto i : *v)
+        {
+            delete i;
+        }
+    }
+}
+
+MmapLogAppender::Segment* MmapLogAppender::openSegment(time_t now)
+{
+    HookDisabler disabler;
+    int fd = open(m_filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1)
+    {
+        std::cout << "open mmap log file " << m_filename << " failed errno="
+                  << errno << " errstr=" << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        std::cout << "stat mmap log file " << m_filename << " failed errno="
+                  << errno << " errstr=" << strerror(errno) << std::endl;
+        close(fd);
+        return nullptr;
+    }
+    uint64_t offset = 0;
+    if (st.st_size > 0)
+    {
+        // 上次没有正常关闭时末尾是NUL, 接在最后一个非NUL字节之后写
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            const char* data = (const char*)p;
+            offset = st.st_size;
+            while (offset > 0 && data[offset - 1] == '\0')
+            {
+                --offset;
+            }
+            munmap(p, st.st_size);
+        }
+        else
+        {
+            offset = st.st_size;
+        }
+    }
+    if (offset >= m_segmentSize)
+    {
+        // 已有文件写满, 先滚动出去
+        int rt = ftruncate(fd, offset);
+        close(fd);
+        if (rt == 0 && rename(m_filename.c_str()
+                    ,RotatedFileName(m_filename, st.st_mtime).c_str()) == 0)
+        {
+            m_pendingPrune = true;
+            return openSegment(now);
+        }
+        std::cout << "rotate mmap log file " << m_filename << " failed errno="
+                  << errno << " errstr=" << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    if ((uint64_t)st.st_size > m_segmentSize && ftruncate(fd, m_segmentSize) != 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+    // 预先分配磁盘块, 避免写映射区时因磁盘满收到SIGBUS
+    int rt = posix_fallocate(fd, 0, m_segmentSize);
+    if (rt != 0)
+    {
+        std::cout << "allocate mmap log file " << m_filename << " failed errno="
+                  << rt << " errstr=" << strerror(rt) << std::endl;
+        close(fd);
+        return nullptr;
+    }
+    void* base = mmap(nullptr, m_segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        std::cout << "mmap log file " << m_filename << " failed errno="
+                  << errno << " errstr=" << strerror(errno) << std::endl;
+        close(fd);
+        return nullptr;
+    }
+    return new Segment(fd, (char*)base, m_segmentSize, offset, now, st);
+}
+
+void MmapLogAppender::roll(Segment* seg, bool rename_file)
+{
+    Mutex::Lock lock(m_rollMutex);
+    if (m_segment.load(std::memory_order_relaxed) != seg)
+    {
+        return;
+    }
+    m_reopenGen = s_reopen_gen.load(std::memory_order_relaxed);
+    if (seg && !rename_file)
+    {
+        // 文件没有被外部重命名或删除时继续写当前段. 重新打开同一文件会从最后一个
+        // 非NUL字节续写, 覆盖其他线程已预留但尚未拷贝完的区域
+        struct stat st;
+        HookDisabler disabler;
+        if (stat(m_filename.c_str(), &st) == 0 && seg->sameFile(st))
+        {
+            return;
+        }
+    }
+    time_t now = time(0);
+    if (seg && rename_file)
+    {
+        std::string target = RotatedFileName(m_filename, seg->start);
+        // 重命名后仍在旧段中写入的线程写进滚动出去的文件
+        if (rename(m_filename.c_str(), target.c_str()) != 0)
+        {
+            std::cout << "rotate mmap log file " << m_filename << " failed errno="
+                      << errno << " errstr=" << strerror(errno) << std::endl;
+        }
+        m_pendingPrune = true;
+    }
+    Segment* next = openSegment(now);
+    if (seg && next && seg->dev == next->dev && seg->ino == next->ino)
+    {
+        // 重命名失败或文件被换回来, 新段仍映射同一个文件, 旧段不能再截断它
+        seg->ownsFile = false;
+    }
+    m_segment.store(next);
+    if (seg)
+    {
+        // 释放时要msync和截断, 交给后台线程, 不占用写线程和全局epoch
+        m_retired.push_back(seg);
+        ++m_rollovers;
+    }
+    m_sem.notify();
+}
+
+void MmapLogAppender::log(Logger* logger, LogLevel::Level level, const LogEvent& event)
+{
+    if (level < getLevel())
+    {
+        return;
+    }
+    std::string& buf = LogFormatter::GetThreadBuffer();
+    {
+        MutexType::Lock lock(m_mutex);
+        m_formatter->format(buf, logger, level, event);
+    }
+    uint64_t len = std::min<uint64_t>(buf.size(), m_segmentSize);
+    PinGuard guard(this);
+    while (true)
+    {
+        Segment* seg = m_segment.load();
+        if (m_reopenGen.load(std::memory_order_relaxed) != s_reopen_gen.load(std::memory_order_relaxed))
+        {
+            roll(seg, false);
+            continue;
+        }
+        if (!seg)
+        {
+            return;
+        }
+        uint64_t off = seg->offset.fetch_add(len, std::memory_order_relaxed);
+        if (off + len <= seg->size)
+        {
+            memcpy(seg->base + off, buf.data(), len);
+            break;
+        }
+        if (off < seg->size)
+        {
+            // 只有跨过段尾的那条记录会走到这里
+            seg->end.store(off, std::memory_order_relaxed);
+        }
+        roll(seg, true);
+    }
+    if (level >= LogLevel::Level::FATAL)
+    {
+        sync();
+    }
+}
+
+void MmapLogAppender::sync()
+{
+    Mutex::Lock lock(m_syncMutex);
+    PinGuard guard(this);
+    Segment* seg = m_segment.load();
+    if (!seg)
+    {
+        return;
+    }
+    uint64_t used = std::min(seg->used(), seg->size);
+    if (used <= seg->synced)
+    {
+        return;
+    }
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t begin = seg->synced / page * page;
+    msync(seg->base + begin, used - begin, MS_SYNC);
+    seg->synced = used;
+}
+
+std::string MmapLogAppender::toYamlString()
+{
+    MutexType::Lock lock(m_mutex);
+    YAML::Node node;
+    node["type"] = "MmapLogAppender";
+    node["file"] = m_filename;
+    node["level"] = LogLevel::ToString(m_level);
+    node["segment_size"] = m_segmentSize;
+    node["sync_interval"] = m_syncInterval;
+    node["max_files"] = m_maxFiles;
+    if (m_hasFormatter && m_formatter){
+        node["formatter"] = m_formatter->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+void MmapLogAppender::reclaim()
+{
+    {
+        Mutex::Lock lock(m_rollMutex);
+        m_graceWait.insert(m_graceWait.end(), m_retired.begin(), m_retired.end());
+        m_retired.clear();
+    }
+    if (m_graceWait.empty() && m_reclaimable.empty())
+    {
+        return;
+    }
+    uint32_t phase = m_pinPhase.load(std::memory_order_relaxed);
+    if (m_pins[(phase & 1) ^ 1].load() != 0)
+    {
+        // 上一组还有写线程, 下个周期再看
+        return;
+    }
+    std::vector<Segment*> done;
+    done.swap(m_reclaimable);
+    m_reclaimable.swap(m_graceWait);
+    m_pinPhase.store(phase + 1);
+    for (auto i : done)
+    {
+        delete i;
+    }
+}
+
+void MmapLogAppender::run()
+{
+    while (!m_stopping)
+    {
+        m_sem.waitFor(m_syncInterval);
+        sync();
+        reclaim();
+        if (m_pendingPrune.exchange(false))
+        {
+            PruneRotatedFiles(m_filename, m_maxFiles);
+        }
+    }
+}
+
+struct AsyncLogAppender::ThreadBuffer {
+    typedef std::shared_ptr<ThreadBuffer> ptr;
+
+    ThreadBuffer(size_t size)
+        :ring(size)
+        ,dropped(0)
+        ,closed(false)
+        ,orphan(false) {
+    }
+
+    SpscRingBuffer ring;
+    /// 丢弃数量, 只有所属线程写入
+    std::atomic<uint64_t> dropped;
+    /// SAMPLE计数, 只有所属线程访问
+    uint32_t sampleCount = 0;
+    /// 所属appender已析构
+    std::atomic<bool> closed;
+    /// 所属线程已退出
+    std::atomic<bool> orphan;
+};
+
+static std::atomic<uint64_t> s_async_appender_id(0);
+
+const char* AsyncLogAppender::PolicyToString(Policy policy)
+{
+    switch (policy)
+    {
+        case Policy::DROP:
+            return "drop";
+        case Policy::SAMPLE:
+            return "sample";
+        default:
+            return "block";
+    }
+}
+
+AsyncLogAppender::Policy AsyncLogAppender::PolicyFromString(const std::string& str)
+{
+    if (str == "drop" || str == "DROP") {
+        return Policy::DROP;
+    }
+    if (str == "sample" || str == "SAMPLE") {
+        return Policy::SAMPLE;
+    }
+    return Policy::BLOCK;
+}
+
+AsyncLogAppender::AsyncLogAppender(const std::string& filename
+                                   ,size_t buffer_size
+                                   ,Policy policy
+                                   ,uint32_t sample_rate
+                                   ,uint32_t flush_interval)
+    : m_id(++s_async_appender_id)
+    , m_filename(filename)
+    , m_bufferSize(buffer_size)
+    , m_policy(policy)
+    , m_sampleRate(sample_rate ? sample_rate : 1)
+    , m_flushInterval(flush_interval ? flush_interval : 1)
+    , m_notified(false)
+    , m_stopping(false)
+{
+    if (m_filename.empty())
+    {
+        m_fd = STDOUT_FILENO;
+    }
+    else
+    {
+        m_reopenGen = s_reopen_gen.load(std::memory_order_relaxed);
+        m_fd = OpenLogFile(m_filename);
+    }
+    m_thread.reset(new Thread(std::bind(&AsyncLogAppender::run, this), "async_log"));
+}
+
+AsyncLogAppender::~AsyncLogAppender()
+{
+    m_stopping = true;
+    m_sem.notify();
+    m_thread->join();
+    Mutex::Lock lock(m_buffersMutex);
+    for (auto& i : m_buffers)
+    {
+        i->closed = true;
+    }
+    if (m_fd > STDERR_FILENO)
+    {
+        close(m_fd);
+    }
+}
+
+AsyncLogAppender::ThreadBuffer* AsyncLogAppender::getBuffer()
+{
+    // 线程退出时把缓冲区交给后台线程写完后回收
+    struct BufferCache {
+        std::vector<std::pair<uint64_t, ThreadBuffer::ptr> > items;
+
+        ~BufferCache() {
+            for (auto& i : items) {
+                i.second->orphan = true;
+            }
+        }
+    };
+    static thread_local BufferCache t_cache;
+    for (auto& i : t_cache.items)
+    {
+        if (i.first == m_id)
+        {
+            return i.second.get();
+        }
+    }
+    for (auto it = t_cache.items.begin(); it != t_cache.items.end();)
+    {
+        if (it->second->closed)
+        {
+            it = t_cache.items.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    ThreadBuffer::ptr buf(new ThreadBuffer(m_bufferSize));
     {
-        MutexType::Lock ll(appender->m_mutex);
-        appender->m_formatter = m_formatter;
+        Mutex::Lock lock(m_buffersMutex);
+        m_buffers.push_back(buf);
     }
-    m_appenders.push_back(appender);
+    t_cache.items.push_back(std::make_pair(m_id, buf));
+    return buf.get();
 }
 
-void Logger::delAppender(LogAppender::ptr appender)
+void AsyncLogAppender::log(Logger* logger, LogLevel::Level level, const LogEvent& event)
 {
-    MutexType::Lock lock(m_mutex);
-    for (auto it = m_appenders.begin(); it != m_appenders.end(); ++it)
+    if (level < getLevel())
+    {
+        return;
+    }
+    // 只在锁内取formatter, 格式化在各线程并行进行
+    LogFormatter::ptr formatter;
+    {
+        MutexType::Lock lock(m_mutex);
+        formatter = m_formatter;
+    }
+    std::string& str = LogFormatter::GetThreadBuffer();
+    formatter->format(str, logger, level, event);
+    ThreadBuffer* buf = getBuffer();
+    SpscRingBuffer& ring = buf->ring;
+    if (str.size() > ring.capacity())
+    {
+        // 超过缓冲区容量的日志截断后按正常流程写入, FATAL和BLOCK策略下不会丢失
+        static const char s_truncated[] = "...(truncated)\n";
+        str.resize(ring.capacity() - (sizeof(s_truncated) - 1));
+        str.append(s_truncated);
+    }
+    bool fatal = level >= LogLevel::Level::FATAL;
+    bool pushed = false;
+    if (m_policy == Policy::BLOCK || fatal)
     {
-        if (*it == appender)
+        while (!(pushed = ring.push(str.c_str(), str.size())))
         {
-            m_appenders.erase(it);
-            break;
+            wakeup();
+            sched_yield();
         }
     }
+    else if (m_policy == Policy::SAMPLE && ring.producerSize() > ring.capacity() / 4 * 3)
+    {
+        pushed = (++buf->sampleCount % m_sampleRate == 0)
+            && ring.push(str.c_str(), str.size());
+    }
+    else
+    {
+        pushed = ring.push(str.c_str(), str.size());
+    }
+    if (!pushed)
+    {
+        buf->dropped.store(buf->dropped.load(std::memory_order_relaxed) + 1
+                           ,std::memory_order_relaxed);
+    }
+
+    if (fatal)
+    {
+        flush();
+    }
+    else if (ring.producerSize() > ring.capacity() / 2)
+    {
+        wakeup();
+    }
 }
 
-void Logger::clearAppenders()
+void AsyncLogAppender::wakeup()
 {
-    MutexType::Lock lock(m_mutex);
-    m_appenders.clear();
+    if (!m_notified.load(std::memory_order_relaxed) && !m_notified.exchange(true))
+    {
+        m_sem.notify();
+    }
 }
 
-void Logger::setFormatter(LogFormatter::ptr val)
+void AsyncLogAppender::flush()
 {
-    MutexType::Lock lock(m_mutex);
-    m_formatter = val;
-    for (auto& i : m_appenders)
+    std::vector<std::pair<ThreadBuffer::ptr, uint64_t> > targets;
     {
-        MutexType::Lock ll(i->m_mutex);
-        if (!i->m_hasFormatter) {
-            i->m_formatter = m_formatter;
+        Mutex::Lock lock(m_buffersMutex);
+        for (auto& i : m_buffers)
+        {
+            targets.push_back(std::make_pair(i, i->ring.getHead()));
         }
     }
-}
-void Logger::setFormatter(const std::string& val)
-{
-    sylar::LogFormatter::ptr new_val(new sylar::LogFormatter(val));
-    if (new_val->isError())
+    for (auto& i : targets)
     {
-        std::cout << "Logger setFormatter name=" << m_name
-                << " value=" << val << " invalid formatter"
-                << std::endl;
-        return ;
+        while (i.first->ring.getTail() < i.second)
+        {
+            wakeup();
+            sched_yield();
+        }
     }
-    setFormatter(new_val);
-}
-
-LogFormatter::ptr Logger::getFormatter()
-{
-    MutexType::Lock lock(m_mutex);
-    return m_formatter;
 }
 
-std::string Logger::toYamlString()
+uint64_t AsyncLogAppender::getDropped()
 {
-    MutexType::Lock lock(m_mutex);
-    YAML::Node node;
-    node["name"] = m_name;
-    node["level"] = LogLevel::ToString(m_level);
-    if (m_formatter){
-        node["formatter"] = m_formatter->getPattern();
-    }
-    for (auto& i : m_appenders)
+    Mutex::Lock lock(m_buffersMutex);
+    uint64_t dropped = m_orphanDropped;
+    for (auto& i : m_buffers)
     {
-        node["appenders"].push_back(YAML::Load(i->toYamlString()));
+        dropped += i->dropped.load(std::memory_order_relaxed);
     }
-    std::stringstream ss;
-    ss << node;
-    return ss.str();
+    return dropped;
 }
 
-void Logger::log(LogLevel::Level level, LogEvent::ptr event)
+/**
+ * @brief 写出全部iovec, 出错时丢弃剩余数据
+ */
+static void WriteAll(int fd, iovec* iov, int cnt)
 {
-    if (level >= m_level)
+    while (cnt > 0)
     {
-        auto self = shared_from_this();
-        MutexType::Lock lock(m_mutex);
-        if (!m_appenders.empty())
+        ssize_t n = writev(fd, iov, std::min(cnt, IOV_MAX));
+        if (n < 0)
         {
-            for (auto& i : m_appenders)
+            if (errno == EINTR)
             {
-                i->log(self, level, event);
+                continue;
             }
+            return;
+        }
+        while (cnt > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            ++iov;
+            --cnt;
         }
-        else if (m_root)
+        if (cnt > 0)
         {
-            m_root->log(level, event);
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
         }
     }
 }
-    
-void Logger::debug(LogEvent::ptr event)
-{
-    log(LogLevel::Level::DEBUG, event);
-}
 
-void Logger::info(LogEvent::ptr event)
-{
-    log(LogLevel::Level::INFO, event);
-}
-
-void Logger::warn(LogEvent::ptr event)
-{
-    log(LogLevel::Level::WARN, event);
-}
-
-void Logger::fatal(LogEvent::ptr event)
+size_t AsyncLogAppender::drain()
 {
-    log(LogLevel::Level::FATAL, event);
-}
+    std::vector<ThreadBuffer::ptr> buffers;
+    uint64_t dropped = 0;
+    {
+        Mutex::Lock lock(m_buffersMutex);
+        for (auto it = m_buffers.begin(); it != m_buffers.end();)
+        {
+            ThreadBuffer::ptr& buf = *it;
+            if (buf->orphan && buf->ring.size() == 0)
+            {
+                m_orphanDropped += buf->dropped.load(std::memory_order_relaxed);
+                it = m_buffers.erase(it);
+                continue;
+            }
+            dropped += buf->dropped.load(std::memory_order_relaxed);
+            buffers.push_back(buf);
+            ++it;
+        }
+        dropped += m_orphanDropped;
+    }
 
-void Logger::error(LogEvent::ptr event)
-{
-    log(LogLevel::Level::ERROR, event);
-}
+    std::vector<iovec> iovs;
+    std::vector<size_t> lens;
+    size_t total = 0;
+    for (auto& i : buffers)
+    {
+        iovec iov[2];
+        int cnt = i->ring.peek(iov);
+        size_t len = 0;
+        for (int n = 0; n < cnt; ++n)
+        {
+            iovs.push_back(iov[n]);
+            len += iov[n].iov_len;
+        }
+        lens.push_back(len);
+        total += len;
+    }
 
-void LogAppender::setFormatter(LogFormatter::ptr formatter)
- { 
-    MutexType::Lock lock(m_mutex);
-    m_formatter = formatter; 
-    if (m_formatter){
-        m_hasFormatter = true;
-    } else {
-        m_hasFormatter = false;
+    std::string report;
+    if (dropped > m_reportedDropped)
+    {
+        report = "AsyncLogAppender dropped " + std::to_string(dropped - m_reportedDropped) + " records\n";
+        iovec iov;
+        iov.iov_base = &report[0];
+        iov.iov_len = report.size();
+        iovs.push_back(iov);
+        m_reportedDropped = dropped;
     }
-}
 
-LogFormatter::ptr LogAppender::getFormatter() 
-{ 
-    MutexType::Lock lock(m_mutex);
-    return m_formatter; 
+    if (m_fd != -1 && !iovs.empty())
+    {
+        WriteAll(m_fd, &iovs[0], iovs.size());
+    }
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        if (lens[i])
+        {
+            buffers[i]->ring.consume(lens[i]);
+        }
+    }
+    return total;
 }
 
-void StdoutLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event)
+void AsyncLogAppender::run()
 {
-    if (level >= m_level)
+    while (true)
     {
-        MutexType::Lock lock(m_mutex);
-        std::cout << m_formatter->format(logger, level, event);
+        m_notified = false;
+        if (!m_filename.empty() && m_reopenGen != s_reopen_gen.load(std::memory_order_relaxed))
+        {
+            m_reopenGen = s_reopen_gen.load(std::memory_order_relaxed);
+            if (m_fd != -1)
+            {
+                close(m_fd);
+            }
+            m_fd = OpenLogFile(m_filename);
+        }
+        if (drain() == 0)
+        {
+            if (m_stopping)
+            {
+                break;
+            }
+            m_sem.waitFor(m_flushInterval);
+        }
     }
 }
 
-std::string StdoutLogAppender::toYamlString()
+std::string AsyncLogAppender::toYamlString()
 {
     MutexType::Lock lock(m_mutex);
     YAML::Node node;
-    node["type"] = "StdoutLogAppender";
+    node["type"] = "AsyncLogAppender";
+    if (!m_filename.empty())
+    {
+        node["file"] = m_filename;
+    }
+    node["policy"] = PolicyToString(m_policy);
+    node["buffer_size"] = m_bufferSize;
+    node["sample_rate"] = m_sampleRate;
+    node["flush_interval"] = m_flushInterval;
     if (m_level != LogLevel::Level::UNKNOW)
         node["level"] = LogLevel::ToString(m_level);
     if (m_hasFormatter && m_formatter){
@@ -420,66 +1810,130 @@ std::string StdoutLogAppender::toYamlString()
     return ss.str();
 }
 
-FileLogAppender::FileLogAppender(const std::string& filename)
-    : m_filename(filename)
+static std::atomic<uint64_t> s_formatter_id(0);
+
+LogFormatter::LogFormatter(const std::string& pattern)
+    : m_id(++s_formatter_id)
+    , m_pattern(pattern)
 {
-    reopen();
+    init();
 }
 
-void FileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event)
+std::string& LogFormatter::GetThreadBuffer()
 {
-    if (level >= m_level)
-    {
-        uint64_t now = time(0);
-        if (now != m_lastTime){
-            reopen();
-            m_lastTime = now;
-        }
-        MutexType::Lock lock(m_mutex);
-        m_filestream << m_formatter->format(logger, level, event);
-    }
+    static thread_local std::string t_buffer;
+    t_buffer.clear();
+    return t_buffer;
 }
 
-std::string FileLogAppender::toYamlString()
+std::string LogFormatter::format(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event)
 {
-    MutexType::Lock lock(m_mutex);
-    YAML::Node node;
-    node["type"] = "FileLogAppender";
-    node["file"] = m_filename;
-    node["level"] = LogLevel::ToString(m_level);
-    if (m_hasFormatter && m_formatter){
-        node["formatter"] = m_formatter->getPattern();
-    }
-    std::stringstream ss;
-    ss << node;
-    return ss.str();
+    std::string buf;
+    format(buf, logger.get(), level, *event);
+    return buf;
 }
 
-bool FileLogAppender::reopen()
+/**
+ * @brief 无符号整数追加到字符串
+ */
+static void AppendUInt(std::string& buf, uint64_t v)
 {
-    MutexType::Lock lock(m_mutex);
-    if (m_filestream)
+    char tmp[24];
+    char* end = tmp + sizeof(tmp);
+    char* p = end;
+    do
+    {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    buf.append(p, end - p);
+}
+
+static void AppendInt(std::string& buf, int64_t v)
+{
+    if (v < 0)
+    {
+        buf.push_back('-');
+        AppendUInt(buf, -(uint64_t)v);
+    }
+    else
     {
-        m_filestream.close();
+        AppendUInt(buf, v);
     }
-    m_filestream.open(m_filename);
-    return !!m_filestream;
 }
 
-LogFormatter::LogFormatter(const std::string& pattern)
-    : m_pattern(pattern)
+/**
+ * @brief 时间格式化缓存, 每个线程每个时间格式保存最近一秒的结果
+ */
+struct DateTimeCache
 {
-    init();
+    uint64_t key = 0;
+    time_t second = -1;
+    size_t len = 0;
+    char buf[64];
+};
+
+void LogFormatter::appendDateTime(std::string& buf, size_t idx, time_t second)
+{
+    static const size_t s_cache_size = 4;
+    static thread_local DateTimeCache t_cache[s_cache_size];
+    uint64_t key = (m_id << 8) | idx;
+    DateTimeCache& c = t_cache[key % s_cache_size];
+    if (c.key != key || c.second != second)
+    {
+        struct tm tm;
+        localtime_r(&second, &tm);
+        c.len = strftime(c.buf, sizeof(c.buf), m_ops[idx].arg.c_str(), &tm);
+        c.key = key;
+        c.second = second;
+    }
+    buf.append(c.buf, c.len);
 }
 
-std::string LogFormatter::format(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event)
+void LogFormatter::format(std::string& buf, Logger* logger, LogLevel::Level level, const LogEvent& event)
 {
-    std::stringstream ss;
-    for (auto& i : m_items)
+    for (size_t i = 0; i < m_ops.size(); ++i)
     {
-        i->format(ss, logger, level, event);
+        const Op& op = m_ops[i];
+        switch (op.type)
+        {
+            case OP_STRING:
+                buf.append(op.arg);
+                break;
+            case OP_MESSAGE:
+                buf.append(event.getContent());
+                break;
+            case OP_LEVEL:
+                buf.append(LogLevel::ToString(level));
+                break;
+            case OP_ELAPSE:
+                AppendUInt(buf, event.getElapse());
+                break;
+            case OP_NAME:
+                buf.append(event.getLogger()->getName());
+                break;
+            case OP_THREAD_ID:
+                AppendInt(buf, event.getThreadId());
+                break;
+            case OP_DATETIME:
+                appendDateTime(buf, i, event.getTime());
+                break;
+            case OP_FILENAME:
+                buf.append(event.getFile());
+                break;
+            case OP_LINE:
+                AppendInt(buf, event.getLine());
+                break;
+            case OP_FIBER_ID:
+                AppendUInt(buf, event.getFiberId());
+                break;
+            case OP_THREAD_NAME:
+                buf.append(event.getThreadName());
+                break;
+            default:
+                break;
+        }
     }
-    return ss.str();
 }
 
 //%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n
@@ -568,22 +2022,22 @@ void LogFormatter::init()
         vec.push_back(std::make_tuple(nstr, "", 0));
     }
 
-    static std::map<std::string, std::function<FormatItem::ptr(const std::string& str)>> s_format_items = {
+    static std::map<std::string, OpType> s_format_ops = {
 #define XX(str, C) \
-        {#str, [](const std::string& fmt) { return FormatItem::ptr(new C(fmt)); }}
-
-        XX(m, MessageFormatItem),
-        XX(p, LevelFormatItem),
-        XX(r, ElapseFormatItem),
-        XX(c, NameFormatItem),
-        XX(t, ThreadIdFormatItem),
-        XX(n, NewLineFormatItem),
-        XX(d, DateTimeFormatItem),
-        XX(f, FilenameFormatItem),
-        XX(l, LineFormatItem),
-        XX(T, TabFormatItem),
-        XX(F, FiberIdFormatItem),
-        XX(N, ThreadNameFormatItem),
+        {#str, C}
+
+        XX(m, OP_MESSAGE),
+        XX(p, OP_LEVEL),
+        XX(r, OP_ELAPSE),
+        XX(c, OP_NAME),
+        XX(t, OP_THREAD_ID),
+        XX(n, OP_NEWLINE),
+        XX(d, OP_DATETIME),
+        XX(f, OP_FILENAME),
+        XX(l, OP_LINE),
+        XX(T, OP_TAB),
+        XX(F, OP_FIBER_ID),
+        XX(N, OP_THREAD_NAME),
 #undef XX
     };
 
@@ -591,25 +2045,46 @@ void LogFormatter::init()
     {
         if (std::get<2>(i) == 0)
         {
-            m_items.push_back(FormatItem::ptr(new StringFormatItem(std::get<0>(i))));
+            addOp(OP_STRING, std::get<0>(i));
         }
         else 
         {
-            auto it = s_format_items.find(std::get<0>(i));
+            auto it = s_format_ops.find(std::get<0>(i));
             // 解析参数不存在
-            if (it == s_format_items.end())
+            if (it == s_format_ops.end())
             {
-                m_items.push_back(FormatItem::ptr(new StringFormatItem("<<error_format %" + std::get<0>(i) + ">>")));
+                addOp(OP_STRING, "<<error_format %" + std::get<0>(i) + ">>");
                 m_error = true;
             }
+            else if (it->second == OP_DATETIME)
+            {
+                addOp(OP_DATETIME, std::get<1>(i).empty() ? "%Y-%m-%d %H:%M:%S" : std::get<1>(i));
+            }
             else 
             {
-                m_items.push_back(it->second(std::get<1>(i)));
+                addOp(it->second, std::string());
             }
         }
     }
 }
 
+void LogFormatter::addOp(OpType type, const std::string& arg)
+{
+    // 相邻的常量合并成一个
+    if (type == OP_STRING || type == OP_TAB || type == OP_NEWLINE)
+    {
+        std::string str = type == OP_TAB ? "\t" : (type == OP_NEWLINE ? "\n" : arg);
+        if (!m_ops.empty() && m_ops.back().type == OP_STRING)
+        {
+            m_ops.back().arg += str;
+            return;
+        }
+        m_ops.push_back(Op{OP_STRING, str});
+        return;
+    }
+    m_ops.push_back(Op{type, arg});
+}
+
 LoggerManager::LoggerManager()
 {
     m_root.reset(new Logger);
@@ -634,16 +2109,39 @@ Logger::ptr LoggerManager::getLogger(const std::string& name)
 // 保证在程序启动时有默认的日志格式定义
 struct LogAppenderDefine
 {
-    int type = 0; // 1 file, 2 stdout
+    int type = 0; // 1 file, 2 stdout, 3 async, 4 rotating, 5 mmap
     LogLevel::Level level = LogLevel::Level::UNKNOW;
     std::string formatter;
     std::string file;
+    // async
+    std::string policy;
+    size_t buffer_size = 1024 * 1024;
+    uint32_t sample_rate = 10;
+    uint32_t flush_interval = 10;
+    // rotating
+    uint64_t max_size = 0;
+    std::string interval;
+    uint32_t max_files = 0;
+    bool compress = false;
+    // mmap
+    uint64_t segment_size = 64 * 1024 * 1024;
+    uint32_t sync_interval = 1000;
 
     bool operator==(const LogAppenderDefine& oth) const
     {
         return type == oth.type && level == oth.level
             && formatter == oth.formatter
-            && file == oth.file;
+            && file == oth.file
+            && policy == oth.policy
+            && buffer_size == oth.buffer_size
+            && sample_rate == oth.sample_rate
+            && flush_interval == oth.flush_interval
+            && max_size == oth.max_size
+            && interval == oth.interval
+            && max_files == oth.max_files
+            && compress == oth.compress
+            && segment_size == oth.segment_size
+            && sync_interval == oth.sync_interval;
     }
 };
 
@@ -711,6 +2209,67 @@ public:
                     if(a["formatter"].IsDefined()) {
                         lad.formatter = a["formatter"].as<std::string>();
                     }
+                } else if(type == "AsyncLogAppender") {
+                    lad.type = 3;
+                    if(a["file"].IsDefined()) {
+                        lad.file = a["file"].as<std::string>();
+                    }
+                    if(a["formatter"].IsDefined()) {
+                        lad.formatter = a["formatter"].as<std::string>();
+                    }
+                    if(a["policy"].IsDefined()) {
+                        lad.policy = a["policy"].as<std::string>();
+                    }
+                    if(a["buffer_size"].IsDefined()) {
+                        lad.buffer_size = a["buffer_size"].as<size_t>();
+                    }
+                    if(a["sample_rate"].IsDefined()) {
+                        lad.sample_rate = a["sample_rate"].as<uint32_t>();
+                    }
+                    if(a["flush_interval"].IsDefined()) {
+                        lad.flush_interval = a["flush_interval"].as<uint32_t>();
+                    }
+                } else if(type == "RotatingFileLogAppender") {
+                    lad.type = 4;
+                    if(!a["file"].IsDefined()) {
+                        std::cout << "log config error: rotating fileappender file is null, " << a
+                              << std::endl;
+                        continue;
+                    }
+                    lad.file = a["file"].as<std::string>();
+                    if(a["formatter"].IsDefined()) {
+                        lad.formatter = a["formatter"].as<std::string>();
+                    }
+                    if(a["max_size"].IsDefined()) {
+                        lad.max_size = a["max_size"].as<uint64_t>();
+                    }
+                    lad.interval = a["interval"].IsDefined() ? a["interval"].as<std::string>() : "daily";
+                    if(a["max_files"].IsDefined()) {
+                        lad.max_files = a["max_files"].as<uint32_t>();
+                    }
+                    if(a["compress"].IsDefined()) {
+                        lad.compress = a["compress"].as<bool>();
+                    }
+                } else if(type == "MmapLogAppender") {
+                    lad.type = 5;
+                    if(!a["file"].IsDefined()) {
+                        std::cout << "log config error: mmap fileappender file is null, " << a
+                              << std::endl;
+                        continue;
+                    }
+                    lad.file = a["file"].as<std::string>();
+                    if(a["formatter"].IsDefined()) {
+                        lad.formatter = a["formatter"].as<std::string>();
+                    }
+                    if(a["segment_size"].IsDefined()) {
+                        lad.segment_size = a["segment_size"].as<uint64_t>();
+                    }
+                    if(a["sync_interval"].IsDefined()) {
+                        lad.sync_interval = a["sync_interval"].as<uint32_t>();
+                    }
+                    if(a["max_files"].IsDefined()) {
+                        lad.max_files = a["max_files"].as<uint32_t>();
+                    }
                 } else {
                     std::cout << "log config error: appender type is invalid, " << a
                               << std::endl;
@@ -744,6 +2303,30 @@ public:
                 na["file"] = a.file;
             } else if(a.type == 2) {
                 na["type"] = "StdoutLogAppender";
+            } else if(a.type == 3) {
+                na["type"] = "AsyncLogAppender";
+                if(!a.file.empty()) {
+                    na["file"] = a.file;
+                }
+                na["policy"] = AsyncLogAppender::PolicyToString(
+                        AsyncLogAppender::PolicyFromString(a.policy));
+                na["buffer_size"] = a.buffer_size;
+                na["sample_rate"] = a.sample_rate;
+                na["flush_interval"] = a.flush_interval;
+            } else if(a.type == 4) {
+                na["type"] = "RotatingFileLogAppender";
+                na["file"] = a.file;
+                na["max_size"] = a.max_size;
+                na["interval"] = RotatingFileLogAppender::IntervalToString(
+                        RotatingFileLogAppender::IntervalFromString(a.interval));
+                na["max_files"] = a.max_files;
+                na["compress"] = a.compress;
+            } else if(a.type == 5) {
+                na["type"] = "MmapLogAppender";
+                na["file"] = a.file;
+                na["segment_size"] = a.segment_size;
+                na["sync_interval"] = a.sync_interval;
+                na["max_files"] = a.max_files;
             }
             if(a.level != LogLevel::Level::UNKNOW) {
                 na["level"] = LogLevel::ToString(a.level);
@@ -764,6 +2347,9 @@ public:
 sylar::ConfigVar<std::set<LogDefine>>::ptr g_log_defines = 
     sylar::Config::Lookup("logs", std::set<LogDefine>(), "logs config");
 
+static sylar::ConfigVar<bool>::ptr g_log_reopen_on_sighup =
+    sylar::Config::Lookup("log.reopen_on_sighup", false, "reopen log files on SIGHUP");
+
 struct LogIniter
 {
     LogIniter()
@@ -809,6 +2395,27 @@ struct LogIniter
                     {
                         ap.reset(new StdoutLogAppender);
                     }
+                    else if (a.type == 3)
+                    {
+                        ap.reset(new AsyncLogAppender(a.file, a.buffer_size
+                                    ,AsyncLogAppender::PolicyFromString(a.policy)
+                                    ,a.sample_rate, a.flush_interval));
+                    }
+                    else if (a.type == 4)
+                    {
+                        ap.reset(new RotatingFileLogAppender(a.file, a.max_size
+                                    ,RotatingFileLogAppender::IntervalFromString(a.interval)
+                                    ,a.max_files, a.compress));
+                    }
+                    else if (a.type == 5)
+                    {
+                        ap.reset(new MmapLogAppender(a.file, a.segment_size
+                                    ,a.sync_interval, a.max_files));
+                    }
+                    if (!ap)
+                    {
+                        continue;
+                    }
                     ap->setLevel(a.level);
                     if(!a.formatter.empty()) {
                         LogFormatter::ptr fmt(new LogFormatter(a.formatter));
@@ -834,6 +2441,18 @@ struct LogIniter
                 }
             }
         });
+
+        // 默认保持SIGHUP终止进程的行为, 只有配置开启时才接管
+        g_log_reopen_on_sighup->addListener([](const bool& old_value, const bool& new_value){
+            if (new_value)
+            {
+                InstallLogReopenSignalHandler();
+            }
+            else
+            {
+                UninstallLogReopenSignalHandler();
+            }
+        });
     }
 };
 
@@ -10,7 +10,9 @@
 #include <vector>
 #include <iostream>
 #include <stdarg.h>
+#include <time.h>
 #include <map>
+#include <atomic>
 
 #include "util.h"
 #include "singleton.h"
@@ -18,11 +20,19 @@
 #include "mutex.h"
 #include "lock.h"
 
+/**
+ * @brief 编译期最低日志级别, 低于它的日志语句被编译器整体消除, 0表示全部保留
+ * @details 由cmake选项SYLAR_LOG_MIN_LEVEL设置, 取值同LogLevel::Level
+ */
+#ifndef SYLAR_LOG_MIN_LEVEL
+#define SYLAR_LOG_MIN_LEVEL 0
+#endif
+
+#define SYLAR_LOG_COMPILED(level) ((int)(level) >= SYLAR_LOG_MIN_LEVEL)
+
 #define SYLAR_LOG_LEVEL(logger, level) \
-    if(logger->getLevel() <= level) \
-        sylar::LogEventWrap(sylar::LogEvent::ptr(new sylar::LogEvent(logger, level, \
-                        __FILE__, __LINE__, 0, sylar::GetThreadId(),\
-                sylar::GetFiberId(), time(0), sylar::Thread::GetName()))).getSS()
+    if(SYLAR_LOG_COMPILED(level) && logger->getLevel() <= level) \
+        sylar::LogEventWrap(&*(logger), level, __FILE__, __LINE__).getSS()
 
 #define SYLAR_LOG_DEBUG(logger) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::Level::DEBUG)
 #define SYLAR_LOG_INFO(logger) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::Level::INFO)
@@ -30,11 +40,27 @@
 #define SYLAR_LOG_ERROR(logger) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::Level::ERROR)
 #define SYLAR_LOG_FATAL(logger) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::Level::FATAL)
 
+/**
+ * @brief 固定日志器的日志, 调用点缓存日志器和是否启用, 关闭时只有一次判断
+ * @details logger表达式只在调用点第一次执行时求值, 只能用于生命周期内不变的日志器,
+ *          如文件内的g_logger或SYLAR_LOG_NAME(name). 日志器级别修改时刷新所有相关调用点
+ */
+#define SYLAR_LOG_STATIC_LEVEL(logger, level) \
+    if (SYLAR_LOG_COMPILED(level)) \
+        if (sylar::Logger* sylar_log_logger = [&]() -> sylar::LogSite& { \
+                static sylar::LogSite s_sylar_site(level); \
+                return s_sylar_site; }().get([&]() { return &*(logger); })) \
+            sylar::LogEventWrap(sylar_log_logger, level, __FILE__, __LINE__).getSS()
+
+#define SYLAR_LOG_STATIC_DEBUG(logger) SYLAR_LOG_STATIC_LEVEL(logger, sylar::LogLevel::Level::DEBUG)
+#define SYLAR_LOG_STATIC_INFO(logger) SYLAR_LOG_STATIC_LEVEL(logger, sylar::LogLevel::Level::INFO)
+#define SYLAR_LOG_STATIC_WARN(logger) SYLAR_LOG_STATIC_LEVEL(logger, sylar::LogLevel::Level::WARN)
+#define SYLAR_LOG_STATIC_ERROR(logger) SYLAR_LOG_STATIC_LEVEL(logger, sylar::LogLevel::Level::ERROR)
+#define SYLAR_LOG_STATIC_FATAL(logger) SYLAR_LOG_STATIC_LEVEL(logger, sylar::LogLevel::Level::FATAL)
+
 #define SYLAR_LOG_FMT_LEVEL(logger, level, fmt, ...) \
-    if (logger->getLevel() <= level) \
-        sylar::LogEventWrap(sylar::LogEvent::ptr(new sylar::LogEvent(logger, level, \
-                        __FILE__, __LINE__, 0, sylar::GetThreadId(),\
-                sylar::GetFiberId(), time(0), sylar::Thread::GetName()))).getEvent()->format(fmt, __VA_ARGS__)
+    if (SYLAR_LOG_COMPILED(level) && logger->getLevel() <= level) \
+        sylar::LogEventWrap(&*(logger), level, __FILE__, __LINE__).getEvent().format(fmt, __VA_ARGS__)
 
 #define SYLAR_LOG_FMT_DEBUG(logger, fmt, ...) SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::Level::DEBUG, fmt, __VA_ARGS__)
 #define SYLAR_LOG_FMT_INFO(logger, fmt, ...) SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::Level::INFO, fmt, __VA_ARGS__)
@@ -42,6 +68,42 @@
 #define SYLAR_LOG_FMT_ERROR(logger, fmt, ...) SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::Level::ERROR, fmt, __VA_ARGS__)
 #define SYLAR_LOG_FMT_FATAL(logger, fmt, ...) SYLAR_LOG_FMT_LEVEL(logger, sylar::LogLevel::Level::FATAL, fmt, __VA_ARGS__)
 
+/**
+ * @brief 限速日志, 每个调用点每秒最多输出per_sec条(允许per_sec条的突发)
+ * @details 被抑制的条数在下一条输出的日志开头以"[suppressed N messages]"给出,
+ *          per_sec只在调用点第一次执行时生效
+ */
+#define SYLAR_LOG_LEVEL_RATE(logger, level, per_sec) \
+    if (SYLAR_LOG_COMPILED(level) && logger->getLevel() <= level) \
+        if (uint64_t sylar_log_permit = [&]() -> sylar::LogRateLimiter& { \
+                static sylar::LogRateLimiter s_sylar_limiter(per_sec); \
+                return s_sylar_limiter; }().acquire()) \
+            sylar::LogEventWrap(&*(logger), level, __FILE__, __LINE__).getSS() \
+                << sylar::LogSuppressed(sylar_log_permit - 1)
+
+#define SYLAR_LOG_DEBUG_RATE(logger, per_sec) SYLAR_LOG_LEVEL_RATE(logger, sylar::LogLevel::Level::DEBUG, per_sec)
+#define SYLAR_LOG_INFO_RATE(logger, per_sec) SYLAR_LOG_LEVEL_RATE(logger, sylar::LogLevel::Level::INFO, per_sec)
+#define SYLAR_LOG_WARN_RATE(logger, per_sec) SYLAR_LOG_LEVEL_RATE(logger, sylar::LogLevel::Level::WARN, per_sec)
+#define SYLAR_LOG_ERROR_RATE(logger, per_sec) SYLAR_LOG_LEVEL_RATE(logger, sylar::LogLevel::Level::ERROR, per_sec)
+#define SYLAR_LOG_FATAL_RATE(logger, per_sec) SYLAR_LOG_LEVEL_RATE(logger, sylar::LogLevel::Level::FATAL, per_sec)
+
+/**
+ * @brief 采样日志, 每个调用点每k次输出1次(第1, k+1, 2k+1...次)
+ */
+#define SYLAR_LOG_LEVEL_SAMPLE(logger, level, k) \
+    if (SYLAR_LOG_COMPILED(level) && logger->getLevel() <= level) \
+        if (uint64_t sylar_log_permit = [&]() -> sylar::LogSampler& { \
+                static sylar::LogSampler s_sylar_sampler(k); \
+                return s_sylar_sampler; }().acquire()) \
+            sylar::LogEventWrap(&*(logger), level, __FILE__, __LINE__).getSS() \
+                << sylar::LogSuppressed(sylar_log_permit - 1)
+
+#define SYLAR_LOG_DEBUG_SAMPLE(logger, k) SYLAR_LOG_LEVEL_SAMPLE(logger, sylar::LogLevel::Level::DEBUG, k)
+#define SYLAR_LOG_INFO_SAMPLE(logger, k) SYLAR_LOG_LEVEL_SAMPLE(logger, sylar::LogLevel::Level::INFO, k)
+#define SYLAR_LOG_WARN_SAMPLE(logger, k) SYLAR_LOG_LEVEL_SAMPLE(logger, sylar::LogLevel::Level::WARN, k)
+#define SYLAR_LOG_ERROR_SAMPLE(logger, k) SYLAR_LOG_LEVEL_SAMPLE(logger, sylar::LogLevel::Level::ERROR, k)
+#define SYLAR_LOG_FATAL_SAMPLE(logger, k) SYLAR_LOG_LEVEL_SAMPLE(logger, sylar::LogLevel::Level::FATAL, k)
+
 #define SYLAR_LOG_ROOT() sylar::LoggerMgr::GetInstance()->getRoot()
 #define SYLAR_LOG_NAME(name) sylar::LoggerMgr::GetInstance()->getLogger(name)
 
@@ -65,24 +127,133 @@ public:
     static LogLevel::Level FromString(const std::string& str);
 };
 
-class LogEvent {
+/**
+ * @brief 日志调用点, 由SYLAR_LOG_STATIC_*宏定义为函数内静态变量
+ * @details 常量初始化, 没有局部静态变量的初始化检查. 第一次执行时记录日志器并加入全局列表,
+ *          之后由Logger::setLevel刷新状态
+ */
+class LogSite : Noncopyable {
+public:
+    enum State {
+        DISABLED = 0,
+        ENABLED = 1,
+        UNRESOLVED = 2
+    };
+
+    constexpr LogSite(LogLevel::Level level)
+        :m_level(level)
+        ,m_state(UNRESOLVED)
+        ,m_logger(nullptr)
+        ,m_next(nullptr) {
+    }
+
+    /**
+     * @brief 返回启用时的日志器
+     * @param[in] cb 第一次执行时获取日志器
+     * @return 未启用时返回nullptr
+     */
+    template<class F>
+    Logger* get(F cb) {
+        int state = m_state.load(std::memory_order_acquire);
+        if (state == DISABLED) {
+            return nullptr;
+        }
+        if (state == ENABLED) {
+            return m_logger.load(std::memory_order_relaxed);
+        }
+        return resolve(cb());
+    }
+
+    /**
+     * @brief 按日志器当前级别刷新它的所有调用点
+     */
+    static void Refresh(Logger* logger);
+
+    /**
+     * @brief 日志器析构时解除它的所有调用点, 下次执行时重新求值
+     */
+    static void Unregister(Logger* logger);
+private:
+    Logger* resolve(Logger* logger);
+private:
+    LogLevel::Level m_level;
+    std::atomic<int> m_state;
+    /// 状态不是UNRESOLVED时有效
+    std::atomic<Logger*> m_logger;
+    /// 全局列表, 由列表锁保护
+    LogSite* m_next;
+};
+
+/**
+ * @brief 日志消息流
+ * @details 直接追加到内部字符串, 不像stringstream那样每次构造都分配内存,
+ *          由线程局部的空闲列表复用
+ */
+class LogStream : Noncopyable {
+public:
+    LogStream();
+
+    std::ostream& stream() { return m_os; }
+    const std::string& str() const { return m_buf.str; }
+    std::string& str() { return m_buf.str; }
+
+    /**
+     * @brief 清空内容并恢复默认的格式状态
+     */
+    void reset();
+
+    /**
+     * @brief 从当前线程的空闲列表取出一个流
+     */
+    static LogStream* Acquire();
+
+    /**
+     * @brief 归还到当前线程的空闲列表, 可以不是取出时的线程
+     */
+    static void Release(LogStream* stream);
+private:
+    struct Buf : public std::streambuf {
+        virtual int_type overflow(int_type c) override;
+        virtual std::streamsize xsputn(const char* s, std::streamsize n) override;
+
+        std::string str;
+    };
+private:
+    Buf m_buf;
+    std::ostream m_os;
+};
+
+/**
+ * @brief 日志事件
+ * @details 宏在栈上构造, 线程id和名称取自线程局部缓存, 消息写入复用的LogStream,
+ *          稳定状态下每条日志没有堆分配
+ */
+class LogEvent : Noncopyable {
 public:
     typedef std::shared_ptr<LogEvent> ptr;
+
+    /**
+     * @brief 构造函数, 线程和协程信息取当前值
+     */
+    LogEvent(Logger* logger, LogLevel::Level level, const char* file, int32_t line);
+
     LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level, 
         const char* file, int32_t line, uint32_t elapse,
         uint32_t thread_id, uint32_t fiber_id, uint64_t time,
         const std::string& thread_name);
 
+    ~LogEvent();
+
     const char* getFile() const {return m_file;}
     int32_t getLine() const {return m_line;}
     uint32_t getElapse() const {return m_elapse;}
     uint32_t getThreadId() const {return m_threadId;}
     uint32_t getFiberId() const {return m_fiberId;}
     uint64_t getTime() const {return m_time;}
-    std::string getContent() const {return m_ss.str();}
-    std::stringstream& getSS() { return m_ss; }
-    const std::string& getThreadName() const { return m_threadName; }
-    std::shared_ptr<Logger> getLogger() const { return m_logger; }
+    const std::string& getContent() const {return m_stream->str();}
+    std::ostream& getSS() { return m_stream->stream(); }
+    const std::string& getThreadName() const { return *m_threadName; }
+    Logger* getLogger() const { return m_logger; }
     LogLevel::Level getLevel() const { return m_level; }
 
     void format(const char* fmt, ...);
@@ -94,25 +265,124 @@ private:
     uint32_t m_threadId = 0;       //线程id
     uint32_t m_fiberId = 0;        //协程id
     uint64_t m_time = 0;           //时间戳
-    std::string m_threadName;
-    std::stringstream m_ss;        //消息 
-
-    std::shared_ptr<Logger> m_logger;
+    /// 线程名称, 指向线程局部变量或m_threadNameCopy
+    const std::string* m_threadName;
+    /// 显式指定的线程名称
+    std::string m_threadNameCopy;
+    LogStream* m_stream;           //消息
+
+    Logger* m_logger;
+    /// 显式构造时持有日志器
+    std::shared_ptr<Logger> m_holder;
     LogLevel::Level m_level;
 };
 
 // RAII机制
-class LogEventWrap {
+class LogEventWrap : Noncopyable {
 public:
-    LogEventWrap(LogEvent::ptr e);
+    LogEventWrap(Logger* logger, LogLevel::Level level, const char* file, int32_t line)
+        :m_event(logger, level, file, line) {
+    }
     ~LogEventWrap();
 
-    std::stringstream& getSS();
-    LogEvent::ptr getEvent() const { return m_event; }
+    std::ostream& getSS() { return m_event.getSS(); }
+    LogEvent& getEvent() { return m_event; }
+private:
+    LogEvent m_event;
+};
+
+/**
+ * @brief 调用点限速器, 无锁的令牌桶(GCRA)
+ * @details 只保存理论到达时间一个原子变量, 被拒绝时不写它,
+ *          时间取CLOCK_MONOTONIC_COARSE, 精度为几毫秒
+ */
+class LogRateLimiter : Noncopyable {
+public:
+    /**
+     * @brief 构造函数
+     * @param[in] per_sec 每秒允许的条数, 也是突发上限
+     */
+    LogRateLimiter(uint32_t per_sec);
+
+    /**
+     * @brief 申请输出一条
+     * @return 0表示被抑制, 否则为1 + 上次输出以来被抑制的条数
+     */
+    uint64_t acquire() {
+        uint64_t now = NowUS();
+        uint64_t tat = m_tat.load(std::memory_order_relaxed);
+        while (true) {
+            if (tat > now + m_tolerance) {
+                m_suppressed.fetch_add(1, std::memory_order_relaxed);
+                return 0;
+            }
+            uint64_t next = (tat > now ? tat : now) + m_interval;
+            if (m_tat.compare_exchange_weak(tat, next, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        return m_suppressed.exchange(0, std::memory_order_relaxed) + 1;
+    }
+
+    static uint64_t NowUS();
+private:
+    /// 每条的间隔(微秒)
+    uint64_t m_interval;
+    /// 允许提前的时间, 决定突发条数
+    uint64_t m_tolerance;
+    /// 理论到达时间
+    std::atomic<uint64_t> m_tat;
+    /// 上次输出以来被抑制的条数
+    std::atomic<uint64_t> m_suppressed;
+};
+
+/**
+ * @brief 调用点采样器, 每k次放行1次
+ */
+class LogSampler : Noncopyable {
+public:
+    LogSampler(uint32_t k)
+        :m_k(k ? k : 1)
+        ,m_count(0) {
+    }
+
+    /**
+     * @brief 返回值同LogRateLimiter::acquire
+     */
+    uint64_t acquire() {
+        uint64_t n = m_count.fetch_add(1, std::memory_order_relaxed);
+        if (n % m_k) {
+            return 0;
+        }
+        return n ? m_k : 1;
+    }
 private:
-    LogEvent::ptr m_event;
+    uint64_t m_k;
+    std::atomic<uint64_t> m_count;
 };
 
+/**
+ * @brief 输出被抑制的条数, 为0时不输出
+ */
+struct LogSuppressed {
+    explicit LogSuppressed(uint64_t n)
+        :count(n) {
+    }
+    uint64_t count;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const LogSuppressed& s) {
+    if (s.count) {
+        os << "[suppressed " << s.count << " messages] ";
+    }
+    return os;
+}
+
+/**
+ * @brief 日志格式器
+ * @details 模式串在构造时编译成扁平的操作列表, 格式化时直接追加到调用方的缓冲区,
+ *          不创建stringstream也没有虚函数调用, 时间按秒缓存
+ */
 class LogFormatter {
 public:
     typedef std::shared_ptr<LogFormatter> ptr;
@@ -120,24 +390,70 @@ public:
 
     //%t    %thread_id  %m%n
     std::string format(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event);
-public:
-    class FormatItem
-    {
-    public:
-        typedef std::shared_ptr<FormatItem> ptr;
-        virtual ~FormatItem() {}
 
-        virtual void format(std::ostream& os, std::shared_ptr<Logger> logger, 
-            LogLevel::Level level, LogEvent::ptr event) = 0;
+    /**
+     * @brief 格式化并追加到buf
+     */
+    void format(std::string& buf, Logger* logger, LogLevel::Level level, const LogEvent& event);
+
+    /**
+     * @brief 返回清空后的线程局部缓冲区, 在本线程下一次调用前有效
+     */
+    static std::string& GetThreadBuffer();
+public:
+    /**
+     * @brief 格式化操作类型
+     */
+    enum OpType {
+        /// 常量字符串
+        OP_STRING,
+        /// %m 消息
+        OP_MESSAGE,
+        /// %p 日志级别
+        OP_LEVEL,
+        /// %r 累计毫秒数
+        OP_ELAPSE,
+        /// %c 日志名称
+        OP_NAME,
+        /// %t 线程id
+        OP_THREAD_ID,
+        /// %n 换行
+        OP_NEWLINE,
+        /// %d 时间
+        OP_DATETIME,
+        /// %f 文件名
+        OP_FILENAME,
+        /// %l 行号
+        OP_LINE,
+        /// %T 制表符
+        OP_TAB,
+        /// %F 协程id
+        OP_FIBER_ID,
+        /// %N 线程名称
+        OP_THREAD_NAME
     };
 
     void init();
     bool isError() const { return m_error; }
     const std::string getPattern() const { return m_pattern; }
 private:
+    /**
+     * @brief 格式化操作
+     */
+    struct Op {
+        OpType type;
+        /// 常量字符串或时间格式
+        std::string arg;
+    };
+
+    void addOp(OpType type, const std::string& arg);
+    void appendDateTime(std::string& buf, size_t idx, time_t second);
+private:
+    /// 实例id, 用于时间缓存
+    uint64_t m_id;
     bool m_error = false;
     std::string m_pattern;
-    std::vector<FormatItem::ptr> m_items;
+    std::vector<Op> m_ops;
 };
 
 // 日志输出地
@@ -148,29 +464,38 @@ public:
     typedef Spinlock MutexType;
     virtual ~LogAppender() {}
 
-    virtual void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) = 0;
+    virtual void log(Logger* logger, LogLevel::Level level, const LogEvent& event) = 0;
     virtual std::string toYamlString() = 0;
 
     void setFormatter(LogFormatter::ptr formatter);
     LogFormatter::ptr getFormatter();
 
-    void setLevel(LogLevel::Level level) { m_level = level; }
-    LogLevel::Level getLevel() const { return m_level; }
+    void setLevel(LogLevel::Level level) { m_level.store(level, std::memory_order_relaxed); }
+    LogLevel::Level getLevel() const { return m_level.load(std::memory_order_relaxed); }
 protected:
-    LogLevel::Level m_level = LogLevel::Level::DEBUG;
+    std::atomic<LogLevel::Level> m_level{LogLevel::Level::DEBUG};
     bool m_hasFormatter = false;
     LogFormatter::ptr m_formatter;
     MutexType m_mutex;
 };
 
-// 日志输出器
+/**
+ * @brief 日志输出器
+ * @details appender列表是不可变的快照, 修改时复制后原子替换. log()只在epoch内取得快照的
+ *          引用计数, 离开epoch后再调用appender, 慢的appender不会阻塞epoch回收.
+ *          日志级别是relaxed原子变量
+ */
 class Logger : public std::enable_shared_from_this<Logger> {
 friend class LoggerManager;
 public:
     typedef std::shared_ptr<Logger> ptr;
     typedef Spinlock MutexType;
+    typedef std::vector<LogAppender::ptr> AppenderList;
+    typedef std::shared_ptr<const AppenderList> AppenderSnapshot;
     Logger(const std::string& name = "root");
+    ~Logger();
     void log(LogLevel::Level level, LogEvent::ptr event);
+    void log(LogLevel::Level level, const LogEvent& event);
     
     void debug(LogEvent::ptr event);
     void info(LogEvent::ptr event);
@@ -181,8 +506,12 @@ public:
     void addAppender(LogAppender::ptr appender);
     void delAppender(LogAppender::ptr appender);
     void clearAppenders();
-    LogLevel::Level getLevel() const { return m_level; }
-    void setLevel(LogLevel::Level level) { m_level = level; }
+    LogLevel::Level getLevel() const { return m_level.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 设置级别并刷新SYLAR_LOG_STATIC_*调用点
+     */
+    void setLevel(LogLevel::Level level);
 
     const std::string& getName() const { return m_name; }
 
@@ -191,12 +520,19 @@ public:
     LogFormatter::ptr getFormatter();
 
     std::string toYamlString();
+private:
+    /**
+     * @brief 发布新的appender列表, 旧列表延迟释放, 需要持有m_mutex
+     */
+    void publishAppenders(AppenderList* list);
 private:
     std::string m_name;                                    // 日志名称
-    LogLevel::Level m_level;                               // 日志级别 
-    std::list<LogAppender::ptr> m_appenders;               // Appender集合
+    std::atomic<LogLevel::Level> m_level;                  // 日志级别 
+    /// Appender集合快照, 指向的shared_ptr对象本身通过epoch延迟释放
+    std::atomic<AppenderSnapshot*> m_appenders;
     LogFormatter::ptr m_formatter;
     Logger::ptr m_root;
+    /// 修改appender列表和formatter的锁, log()不使用
     MutexType m_mutex;
 };
 
@@ -205,26 +541,365 @@ class StdoutLogAppender : public LogAppender
 {
 public:
     typedef std::shared_ptr<StdoutLogAppender> ptr;
-    virtual void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
+    virtual void log(Logger* logger, LogLevel::Level level, const LogEvent& event) override;
     virtual std::string toYamlString() override;
 private:
 };
 
-// 输出到文件
+/**
+ * @brief 通知所有文件appender重新打开文件
+ * @details 只增加一个计数, 各appender在下一次写入前重新打开, 可以在信号处理函数中调用,
+ *          配合外部logrotate使用
+ */
+void ReopenLogFiles();
+
+/**
+ * @brief 安装收到SIGHUP时调用ReopenLogFiles的处理函数
+ * @details 默认不安装, 也可以通过配置log.reopen_on_sighup开启.
+ *          SIGHUP已有其他处理函数或被忽略时不覆盖
+ * @return 处理函数是否已安装
+ */
+bool InstallLogReopenSignalHandler();
+
+/**
+ * @brief 输出到文件
+ * @details 以O_APPEND打开, 每条日志在appender锁内直接write(2), 返回时已交给内核,
+ *          进程崩溃也不会丢失, 代价是每条日志一次系统调用. 需要吞吐量时使用
+ *          AsyncLogAppender或MmapLogAppender
+ */
 class FileLogAppender : public LogAppender 
 {
 public:
     typedef std::shared_ptr<FileLogAppender> ptr;
     FileLogAppender(const std::string& filename);
-    virtual void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
+    ~FileLogAppender();
+    virtual void log(Logger* logger, LogLevel::Level level, const LogEvent& event) override;
     virtual std::string toYamlString() override;
 
     bool reopen();
 
 private:
+    bool reopenLocked();
+private:
+    std::string m_filename;
+    int m_fd = -1;
+    /// 打开文件时的ReopenLogFiles计数
+    uint64_t m_reopenGen = 0;
+};
+
+/**
+ * @brief 按大小/时间滚动的文件appender
+ * @details 写日志的线程只检查是否需要滚动并通知后台线程, 重命名, 打开新文件,
+ *          压缩和清理旧文件都在后台线程完成, 所以滚动完成前写入的日志仍进入当前文件,
+ *          文件可能略大于max_size. 滚动后的文件名为 文件名.开始时间[.序号][.gz]
+ */
+class RotatingFileLogAppender : public LogAppender
+{
+public:
+    typedef std::shared_ptr<RotatingFileLogAppender> ptr;
+
+    /**
+     * @brief 按时间滚动的周期
+     */
+    enum class Interval {
+        NONE = 0,
+        HOURLY = 1,
+        DAILY = 2
+    };
+
+    static const char* IntervalToString(Interval interval);
+    static Interval IntervalFromString(const std::string& str);
+
+    /**
+     * @brief 构造函数
+     * @param[in] filename 文件名
+     * @param[in] max_size 单个文件的最大字节数, 0不按大小滚动
+     * @param[in] interval 按时间滚动的周期
+     * @param[in] max_files 保留的滚动文件数量, 0不清理
+     * @param[in] compress 是否gzip压缩滚动后的文件
+     */
+    RotatingFileLogAppender(const std::string& filename
+                            ,uint64_t max_size = 0
+                            ,Interval interval = Interval::DAILY
+                            ,uint32_t max_files = 0
+                            ,bool compress = false);
+
+    /**
+     * @brief 析构函数, 等待进行中的滚动和压缩结束
+     */
+    ~RotatingFileLogAppender();
+
+    virtual void log(Logger* logger, LogLevel::Level level, const LogEvent& event) override;
+    virtual std::string toYamlString() override;
+
+    /**
+     * @brief 立即请求一次滚动
+     */
+    void rotate();
+
+    /**
+     * @brief 返回已完成的滚动次数
+     */
+    uint64_t getRotations() const { return m_rotations;}
+private:
+    /**
+     * @brief 打开当前文件, 需要持有m_mutex
+     */
+    bool openLocked(time_t now);
+
+    /**
+     * @brief 计算下一个时间滚动点
+     */
+    time_t nextRotateTime(time_t now) const;
+
+    /**
+     * @brief 后台线程
+     */
+    void run();
+
+    /**
+     * @brief 执行滚动
+     */
+    void doRotate();
+
+    /**
+     * @brief 删除超出数量的旧文件
+     */
+    void prune();
+private:
+    std::string m_filename;
+    uint64_t m_maxSize;
+    Interval m_interval;
+    uint32_t m_maxFiles;
+    bool m_compress;
+
+    int m_fd = -1;
+    /// 当前文件大小
+    uint64_t m_size = 0;
+    /// 当前文件的开始时间
+    time_t m_segmentStart = 0;
+    /// 下一个时间滚动点, 0表示不按时间滚动
+    time_t m_nextRotate = 0;
+    uint64_t m_reopenGen = 0;
+
+    /// 是否有未处理的滚动请求
+    std::atomic<bool> m_pending;
+    std::atomic<bool> m_stopping;
+    std::atomic<uint64_t> m_rotations;
+    Semaphore m_sem;
+    Thread::ptr m_thread;
+};
+
+/**
+ * @brief 内存映射文件appender
+ * @details 当前段文件预先分配segment_size字节并以MAP_SHARED映射, 写线程格式化后用原子
+ *          bump指针预留位置直接拷贝进映射区, 不调用write. 数据写入即进入页缓存, 进程崩溃
+ *          也不会丢失, 后台线程按sync_interval批量msync到磁盘.
+ *          段写满后滚动为 文件名.开始时间[.序号], 关闭时截断到实际长度.
+ *          进程崩溃时当前段末尾是未写入的NUL字节, 重新打开时从最后一个非NUL字节之后继续写.
+ *          ReopenLogFiles时文件没有被移走则继续写当前段
+ */
+class MmapLogAppender : public LogAppender
+{
+public:
+    typedef std::shared_ptr<MmapLogAppender> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] filename 文件名
+     * @param[in] segment_size 段大小, 超过段大小的单条日志被截断
+     * @param[in] sync_interval 后台msync间隔(毫秒)
+     * @param[in] max_files 保留的滚动文件数量, 0不清理
+     */
+    MmapLogAppender(const std::string& filename
+                    ,uint64_t segment_size = 64 * 1024 * 1024
+                    ,uint32_t sync_interval = 1000
+                    ,uint32_t max_files = 0);
+
+    /**
+     * @brief 析构函数, 同步并截断当前段
+     */
+    ~MmapLogAppender();
+
+    virtual void log(Logger* logger, LogLevel::Level level, const LogEvent& event) override;
+    virtual std::string toYamlString() override;
+
+    /**
+     * @brief 把当前段已写入的数据同步到磁盘
+     */
+    void sync();
+
+    /**
+     * @brief 返回已完成的滚动次数
+     */
+    uint64_t getRollovers() const { return m_rollovers;}
+private:
+    struct Segment;
+    class PinGuard;
+
+    /**
+     * @brief 打开当前文件作为新段, 已有内容时接着写
+     */
+    Segment* openSegment(time_t now);
+
+    /**
+     * @brief 用新段替换seg, 旧段在所有写线程离开后由后台线程释放
+     * @param[in] seg 调用方看到的当前段, 已被替换时什么都不做
+     * @param[in] rename_file 是否把旧段重命名为滚动文件, 外部移动文件后重新打开时为false
+     */
+    void roll(Segment* seg, bool rename_file);
+
+    /**
+     * @brief 释放已没有写线程的旧段, 只在后台线程调用
+     * @details 换下的段要等两组写线程计数先后归零才释放: 第一次归零后切换计数组,
+     *          第二次归零时换下之前进入的写线程都已离开
+     */
+    void reclaim();
+
+    /**
+     * @brief 后台线程
+     */
+    void run();
+private:
+    std::string m_filename;
+    uint64_t m_segmentSize;
+    uint32_t m_syncInterval;
+    uint32_t m_maxFiles;
+
+    /// 当前段
+    std::atomic<Segment*> m_segment;
+    std::atomic<uint64_t> m_reopenGen;
+    /// 两组写线程计数, 访问段期间计数不为0
+    std::atomic<uint32_t> m_pins[2];
+    /// 新进入的写线程使用的计数组
+    std::atomic<uint32_t> m_pinPhase;
+    /// 刚换下的段, 由m_rollMutex保护
+    std::vector<Segment*> m_retired;
+    /// 等待第一次/第二次计数归零的段, 只有后台线程访问
+    std::vector<Segment*> m_graceWait;
+    std::vector<Segment*> m_reclaimable;
+    /// 滚动锁, 只在换段时使用
+    Mutex m_rollMutex;
+    /// msync锁
+    Mutex m_syncMutex;
+    /// 是否需要清理旧文件
+    std::atomic<bool> m_pendingPrune;
+    std::atomic<bool> m_stopping;
+    std::atomic<uint64_t> m_rollovers;
+    Semaphore m_sem;
+    Thread::ptr m_thread;
+};
+
+class SpscRingBuffer;
+
+/**
+ * @brief 异步输出到文件/控制台
+ * @details 每个线程把格式化好的日志写入自己的无锁环形缓冲区,
+ *          后台线程批量取出后用writev输出, 写日志的线程不会被磁盘IO阻塞
+ *          FATAL日志在返回前保证已经写出
+ */
+class AsyncLogAppender : public LogAppender
+{
+public:
+    typedef std::shared_ptr<AsyncLogAppender> ptr;
+
+    /**
+     * @brief 缓冲区满时的策略
+     */
+    enum class Policy {
+        /// 等待后台线程腾出空间
+        BLOCK = 0,
+        /// 丢弃
+        DROP = 1,
+        /// 使用超过3/4后每sample_rate条保留1条, 满了丢弃
+        SAMPLE = 2
+    };
+
+    static const char* PolicyToString(Policy policy);
+    static Policy PolicyFromString(const std::string& str);
+
+    /**
+     * @brief 构造函数
+     * @param[in] filename 输出文件, 为空输出到标准输出
+     * @param[in] buffer_size 每个线程的缓冲区大小, 更长的单条日志会被截断
+     * @param[in] policy 缓冲区满时的策略
+     * @param[in] sample_rate SAMPLE策略下的采样率
+     * @param[in] flush_interval 后台线程空闲时的刷新间隔(毫秒)
+     */
+    AsyncLogAppender(const std::string& filename = ""
+                     ,size_t buffer_size = 1024 * 1024
+                     ,Policy policy = Policy::BLOCK
+                     ,uint32_t sample_rate = 10
+                     ,uint32_t flush_interval = 10);
+
+    /**
+     * @brief 析构函数, 写出剩余日志后退出后台线程
+     */
+    ~AsyncLogAppender();
+
+    virtual void log(Logger* logger, LogLevel::Level level, const LogEvent& event) override;
+    virtual std::string toYamlString() override;
+
+    /**
+     * @brief 等待调用前写入的日志全部输出
+     */
+    void flush();
+
+    /**
+     * @brief 返回丢弃的日志条数
+     */
+    uint64_t getDropped();
+private:
+    /**
+     * @brief 单个线程的缓冲区
+     */
+    struct ThreadBuffer;
+
+    /**
+     * @brief 获取当前线程的缓冲区
+     */
+    ThreadBuffer* getBuffer();
+
+    /**
+     * @brief 后台线程
+     */
+    void run();
+
+    /**
+     * @brief 输出所有缓冲区中的数据
+     * @return 输出的字节数
+     */
+    size_t drain();
+
+    /**
+     * @brief 唤醒后台线程
+     */
+    void wakeup();
+private:
+    /// 实例id, 用于线程局部缓冲区的查找
+    uint64_t m_id;
     std::string m_filename;
-    std::ofstream m_filestream;
-    uint64_t m_lastTime = 0;
+    int m_fd = -1;
+    /// 打开文件时的ReopenLogFiles计数, 只有后台线程访问
+    uint64_t m_reopenGen = 0;
+    size_t m_bufferSize;
+    Policy m_policy;
+    uint32_t m_sampleRate;
+    uint32_t m_flushInterval;
+
+    /// 缓冲区注册锁, 只在线程第一次写日志时使用
+    Mutex m_buffersMutex;
+    std::vector<std::shared_ptr<ThreadBuffer> > m_buffers;
+    /// 后台线程唤醒
+    Semaphore m_sem;
+    /// 是否已有未处理的唤醒
+    std::atomic<bool> m_notified;
+    std::atomic<bool> m_stopping;
+    /// 已回收缓冲区的丢弃数量
+    uint64_t m_orphanDropped = 0;
+    /// 已报告的丢弃数量, 只有后台线程访问
+    uint64_t m_reportedDropped = 0;
+    Thread::ptr m_thread;
 };
 
 class LoggerManager
@@ -2,6 +2,8 @@
 #include "macro.h"
 #include "scheduler.h"
 #include <stdexcept>
+#include <errno.h>
+#include <time.h>
 
 namespace sylar {
 
@@ -21,6 +23,26 @@ void Semaphore::wait() {
     }
 }
 
+bool Semaphore::waitFor(uint64_t ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += ms % 1000 * 1000000;
+    if(ts.tv_nsec >= 1000000000) {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000;
+    }
+    while(sem_timedwait(&m_semaphore, &ts)) {
+        if(errno == ETIMEDOUT) {
+            return false;
+        }
+        if(errno != EINTR) {
+            throw std::logic_error("sem_timedwait error");
+        }
+    }
+    return true;
+}
+
 void Semaphore::notify() {
     if(sem_post(&m_semaphore)) {
         throw std::logic_error("sem_post error");
@@ -71,4 +93,163 @@ void FiberSemaphore::notify() {
     }
 }
 
-}
\ No newline at end of file
+FiberMutex::~FiberMutex() {
+    SYLAR_ASSERT(m_waiters.empty());
+}
+
+void FiberMutex::lockSlow() {
+    SYLAR_ASSERT(Scheduler::GetThis());
+    {
+        MutexType::Lock lock(m_mutex);
+        // 标记为有竞争, 持有者解锁时会进入慢路径检查等待队列
+        if(m_state.exchange(CONTENDED, std::memory_order_acquire) == UNLOCKED) {
+            return;
+        }
+        m_waiters.push_back(std::make_pair(Scheduler::GetThis(), Fiber::GetThis()));
+    }
+    // 被唤醒时锁已经交给当前协程
+    Fiber::YieldToHold();
+}
+
+void FiberMutex::unlockSlow() {
+    std::pair<Scheduler*, Fiber::ptr> next;
+    {
+        MutexType::Lock lock(m_mutex);
+        if(m_waiters.empty()) {
+            m_state.store(UNLOCKED, std::memory_order_release);
+            return;
+        }
+        next = m_waiters.front();
+        m_waiters.pop_front();
+        // 锁不释放, 直接交给next
+        m_state.store(m_waiters.empty() ? LOCKED : CONTENDED, std::memory_order_release);
+    }
+    next.first->schedule(next.second);
+}
+
+FiberRWMutex::~FiberRWMutex() {
+    SYLAR_ASSERT(m_waiters.empty());
+}
+
+void FiberRWMutex::rdlockSlow() {
+    SYLAR_ASSERT(Scheduler::GetThis());
+    {
+        MutexType::Lock lock(m_mutex);
+        uint32_t s = m_state.load(std::memory_order_relaxed);
+        while(true) {
+            if(!(s & WRITER) && m_waiters.empty()) {
+                if(m_state.compare_exchange_weak(s, s + 1, std::memory_order_acquire)) {
+                    return;
+                }
+                continue;
+            }
+            // 按观察到的状态设置WAITERS, 之后的解锁都会进入慢路径
+            if(m_state.compare_exchange_weak(s, s | WAITERS, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        m_waiters.push_back(Waiter{Scheduler::GetThis(), Fiber::GetThis(), false});
+    }
+    Fiber::YieldToHold();
+}
+
+void FiberRWMutex::wrlockSlow() {
+    SYLAR_ASSERT(Scheduler::GetThis());
+    {
+        MutexType::Lock lock(m_mutex);
+        uint32_t s = m_state.load(std::memory_order_relaxed);
+        while(true) {
+            if(s == 0) {
+                if(m_state.compare_exchange_weak(s, WRITER, std::memory_order_acquire)) {
+                    return;
+                }
+                continue;
+            }
+            if(m_state.compare_exchange_weak(s, s | WAITERS, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        m_waiters.push_back(Waiter{Scheduler::GetThis(), Fiber::GetThis(), true});
+    }
+    Fiber::YieldToHold();
+}
+
+void FiberRWMutex::wakeLocked(std::vector<std::pair<Scheduler*, Fiber::ptr> >& wakes) {
+    uint32_t s = 0;
+    if(m_waiters.front().writer) {
+        wakes.push_back(std::make_pair(m_waiters.front().scheduler, m_waiters.front().fiber));
+        m_waiters.pop_front();
+        s = WRITER;
+    } else {
+        // 唤醒队首连续的读者, 遇到写者为止
+        while(!m_waiters.empty() && !m_waiters.front().writer) {
+            wakes.push_back(std::make_pair(m_waiters.front().scheduler, m_waiters.front().fiber));
+            m_waiters.pop_front();
+            ++s;
+        }
+    }
+    if(!m_waiters.empty()) {
+        s |= WAITERS;
+    }
+    m_state.store(s, std::memory_order_release);
+}
+
+void FiberRWMutex::unlockSlow() {
+    std::vector<std::pair<Scheduler*, Fiber::ptr> > wakes;
+    {
+        // 设置了WAITERS后状态只在持有m_mutex时改变
+        MutexType::Lock lock(m_mutex);
+        uint32_t s = m_state.load(std::memory_order_relaxed);
+        SYLAR_ASSERT(s & WAITERS);
+        if(!(s & WRITER) && (s & ~WAITERS) > 1) {
+            m_state.store(s - 1, std::memory_order_release);
+            return;
+        }
+        wakeLocked(wakes);
+    }
+    for(auto& i : wakes) {
+        i.first->schedule(i.second);
+    }
+}
+
+FiberCondition::~FiberCondition() {
+    SYLAR_ASSERT(m_waiters.empty());
+}
+
+void FiberCondition::wait(FiberMutex& mutex) {
+    SYLAR_ASSERT(Scheduler::GetThis());
+    {
+        MutexType::Lock lock(m_mutex);
+        m_waiters.push_back(std::make_pair(Scheduler::GetThis(), Fiber::GetThis()));
+    }
+    // 先入队再解锁, 解锁后的notify不会丢失
+    mutex.unlock();
+    Fiber::YieldToHold();
+    mutex.lock();
+}
+
+void FiberCondition::notifyOne() {
+    std::pair<Scheduler*, Fiber::ptr> next;
+    {
+        MutexType::Lock lock(m_mutex);
+        if(m_waiters.empty()) {
+            return;
+        }
+        next = m_waiters.front();
+        m_waiters.pop_front();
+    }
+    next.first->schedule(next.second);
+}
+
+void FiberCondition::notifyAll() {
+    std::list<std::pair<Scheduler*, Fiber::ptr> > waiters;
+    {
+        MutexType::Lock lock(m_mutex);
+        waiters.swap(m_waiters);
+    }
+    for(auto& i : waiters) {
+        i.first->schedule(i.second);
+    }
+}
+
+}
@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include <atomic>
 #include <list>
+#include <vector>
 
 #include "noncopyable.h"
 #include "fiber.h"
@@ -36,6 +37,13 @@ public:
      */
     void wait();
 
+    /**
+     * @brief 带超时获取信号量
+     * @param[in] ms 超时时间(毫秒)
+     * @return 获取成功返回true, 超时返回false
+     */
+    bool waitFor(uint64_t ms);
+
     /**
      * @brief 释放信号量
      */
@@ -444,6 +452,187 @@ private:
     size_t m_concurrency;
 };
 
+/**
+ * @brief 协程互斥量
+ * @details 获取不到锁时挂起当前协程而不是阻塞线程, 解锁时把锁直接交给等待队列中的
+ *          第一个协程并在它所属的调度器中唤醒, 不同调度器的协程可以使用同一把锁.
+ *          没有竞争时加锁和解锁都只有一次CAS
+ * @attention 只能在调度器的协程中使用
+ */
+class FiberMutex : Noncopyable {
+public:
+    typedef ScopedLockImpl<FiberMutex> Lock;
+    typedef Spinlock MutexType;
+
+    FiberMutex()
+        :m_state(UNLOCKED) {
+    }
+
+    ~FiberMutex();
+
+    /**
+     * @brief 加锁, 锁被占用时挂起当前协程
+     */
+    void lock() {
+        int expected = UNLOCKED;
+        if(!m_state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire)) {
+            lockSlow();
+        }
+    }
+
+    /**
+     * @brief 尝试加锁
+     */
+    bool tryLock() {
+        int expected = UNLOCKED;
+        return m_state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire);
+    }
+
+    /**
+     * @brief 解锁, 有等待者时直接交给第一个等待者
+     */
+    void unlock() {
+        int expected = LOCKED;
+        if(!m_state.compare_exchange_strong(expected, UNLOCKED, std::memory_order_release)) {
+            unlockSlow();
+        }
+    }
+private:
+    void lockSlow();
+    void unlockSlow();
+private:
+    enum State {
+        UNLOCKED = 0,
+        LOCKED = 1,
+        /// 已加锁且可能有等待者, 解锁需要进入慢路径
+        CONTENDED = 2
+    };
+    std::atomic<int> m_state;
+    /// 保护等待队列
+    MutexType m_mutex;
+    std::list<std::pair<Scheduler*, Fiber::ptr> > m_waiters;
+};
+
+/**
+ * @brief 协程读写锁
+ * @details 写优先: 有协程在等待时新的读者也要排队. 解锁时按队列顺序唤醒一个写者
+ *          或者连续的多个读者, 被唤醒的协程已持有锁. 没有等待者时加锁和解锁都只有一次CAS
+ * @attention 只能在调度器的协程中使用
+ */
+class FiberRWMutex : Noncopyable {
+public:
+    typedef ReadScopedLockImpl<FiberRWMutex> ReadLock;
+    typedef WriteScopedLockImpl<FiberRWMutex> WriteLock;
+    typedef Spinlock MutexType;
+
+    FiberRWMutex()
+        :m_state(0) {
+    }
+
+    ~FiberRWMutex();
+
+    /**
+     * @brief 上读锁
+     */
+    void rdlock() {
+        uint32_t s = m_state.load(std::memory_order_relaxed);
+        if((s & (WRITER | WAITERS))
+                || !m_state.compare_exchange_weak(s, s + 1, std::memory_order_acquire)) {
+            rdlockSlow();
+        }
+    }
+
+    /**
+     * @brief 上写锁
+     */
+    void wrlock() {
+        uint32_t expected = 0;
+        if(!m_state.compare_exchange_strong(expected, WRITER, std::memory_order_acquire)) {
+            wrlockSlow();
+        }
+    }
+
+    /**
+     * @brief 解锁
+     */
+    void unlock() {
+        uint32_t s = m_state.load(std::memory_order_relaxed);
+        while(!(s & WAITERS)) {
+            uint32_t n = (s & WRITER) ? 0 : s - 1;
+            if(m_state.compare_exchange_weak(s, n, std::memory_order_release)) {
+                return;
+            }
+        }
+        unlockSlow();
+    }
+private:
+    void rdlockSlow();
+    void wrlockSlow();
+    void unlockSlow();
+
+    /**
+     * @brief 锁被释放时唤醒等待队列的队首, 需要持有m_mutex
+     */
+    void wakeLocked(std::vector<std::pair<Scheduler*, Fiber::ptr> >& wakes);
+private:
+    /// 写者持有锁
+    static const uint32_t WRITER = 1u << 31;
+    /// 等待队列非空, 所有状态变化都要持有m_mutex
+    static const uint32_t WAITERS = 1u << 30;
+
+    struct Waiter {
+        Scheduler* scheduler;
+        Fiber::ptr fiber;
+        bool writer;
+    };
+
+    /// 读者数量 | WRITER | WAITERS
+    std::atomic<uint32_t> m_state;
+    MutexType m_mutex;
+    std::list<Waiter> m_waiters;
+};
+
+/**
+ * @brief 协程条件变量
+ * @details 配合FiberMutex使用, 等待时挂起协程, 被唤醒后重新获取锁
+ * @attention 只能在调度器的协程中使用
+ */
+class FiberCondition : Noncopyable {
+public:
+    typedef Spinlock MutexType;
+
+    ~FiberCondition();
+
+    /**
+     * @brief 释放mutex并挂起, 被唤醒后重新加锁返回
+     * @param[in] mutex 调用者已持有的锁
+     */
+    void wait(FiberMutex& mutex);
+
+    /**
+     * @brief 等待直到pred()为true
+     */
+    template<class Predicate>
+    void wait(FiberMutex& mutex, Predicate pred) {
+        while(!pred()) {
+            wait(mutex);
+        }
+    }
+
+    /**
+     * @brief 唤醒一个等待的协程
+     */
+    void notifyOne();
+
+    /**
+     * @brief 唤醒所有等待的协程
+     */
+    void notifyAll();
+private:
+    MutexType m_mutex;
+    std::list<std::pair<Scheduler*, Fiber::ptr> > m_waiters;
+};
+
 
 
 }
@@ -0,0 +1,66 @@
+#include "offload.h"
+#include "config.h"
+#include "log.h"
+
+namespace sylar {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static ConfigVar<uint32_t>::ptr g_offload_threads =
+    Config::Lookup<uint32_t>("offload.threads", 4, "blocking io offload thread count");
+
+OffloadPool::OffloadPool() {
+    uint32_t count = g_offload_threads->getValue();
+    for (uint32_t i = 0; i < count; ++i) {
+        m_threads.push_back(Thread::ptr(new Thread(std::bind(&OffloadPool::run, this),
+            "offload_" + std::to_string(i))));
+    }
+    SYLAR_LOG_INFO(g_logger) << "offload pool started threads=" << count;
+}
+
+OffloadPool::~OffloadPool() {
+    {
+        MutexType::Lock lock(m_mutex);
+        m_stopping = true;
+    }
+    for (size_t i = 0; i < m_threads.size(); ++i) {
+        m_sem.notify();
+    }
+    for (auto& i : m_threads) {
+        i->join();
+    }
+}
+
+bool OffloadPool::submit(std::function<void()> cb) {
+    if (m_threads.empty()) {
+        return false;
+    }
+    {
+        MutexType::Lock lock(m_mutex);
+        m_tasks.push_back(std::function<void()>());
+        m_tasks.back().swap(cb);
+    }
+    m_sem.notify();
+    return true;
+}
+
+void OffloadPool::run() {
+    while (true) {
+        m_sem.wait();
+        std::function<void()> cb;
+        {
+            MutexType::Lock lock(m_mutex);
+            if (m_tasks.empty()) {
+                if (m_stopping) {
+                    break;
+                }
+                continue;
+            }
+            cb.swap(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        cb();
+    }
+}
+
+}
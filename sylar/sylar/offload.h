@@ -0,0 +1,69 @@
+/**
+ * @file offload.h
+ * @brief 阻塞IO卸载线程池
+ * @details 普通文件等无法被epoll管理的句柄上的阻塞调用交给独立线程执行,
+ *          调用协程挂起直到调用完成, 工作线程不会因磁盘IO而阻塞
+ */
+#ifndef __SYLAR_OFFLOAD_H__
+#define __SYLAR_OFFLOAD_H__
+
+#include <functional>
+#include <list>
+#include <vector>
+#include "mutex.h"
+#include "thread.h"
+#include "singleton.h"
+
+namespace sylar {
+
+/**
+ * @brief 阻塞IO线程池
+ */
+class OffloadPool : Noncopyable {
+public:
+    typedef Mutex MutexType;
+
+    /**
+     * @brief 构造函数, 线程数量由配置offload.threads决定
+     */
+    OffloadPool();
+
+    /**
+     * @brief 析构函数, 执行完剩余任务后退出所有线程
+     */
+    ~OffloadPool();
+
+    /**
+     * @brief 提交阻塞任务
+     * @param[in] cb 在线程池中执行的函数
+     * @return 线程池未启用(线程数为0)返回false
+     */
+    bool submit(std::function<void()> cb);
+
+    /**
+     * @brief 返回线程数量
+     */
+    size_t getThreadCount() const { return m_threads.size();}
+private:
+    /**
+     * @brief 线程执行函数
+     */
+    void run();
+private:
+    /// Mutex
+    MutexType m_mutex;
+    /// 任务计数信号量
+    Semaphore m_sem;
+    /// 待执行的任务
+    std::list<std::function<void()> > m_tasks;
+    /// 线程池
+    std::vector<Thread::ptr> m_threads;
+    /// 是否停止
+    bool m_stopping = false;
+};
+
+typedef Singleton<OffloadPool> OffloadMgr;
+
+}
+
+#endif
@@ -0,0 +1,148 @@
+/**
+ * @file ring_buffer.h
+ * @brief 单生产者单消费者的无锁字节环形缓冲区
+ * @details 生产者整块写入或失败, 消费者按字节流读取, 读取区间最多被回绕分成两段,
+ *          可以直接作为writev的iovec
+ */
+#ifndef __SYLAR_RING_BUFFER_H__
+#define __SYLAR_RING_BUFFER_H__
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
+#include "noncopyable.h"
+
+namespace sylar {
+
+/**
+ * @brief SPSC字节环形缓冲区
+ */
+class SpscRingBuffer : Noncopyable {
+public:
+    typedef std::shared_ptr<SpscRingBuffer> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] capacity 容量, 向上取整为2的幂
+     */
+    SpscRingBuffer(size_t capacity)
+        :m_head(0)
+        ,m_cachedTail(0)
+        ,m_tail(0) {
+        m_capacity = 64;
+        while (m_capacity < capacity) {
+            m_capacity <<= 1;
+        }
+        m_data = new char[m_capacity];
+    }
+
+    ~SpscRingBuffer() {
+        delete[] m_data;
+    }
+
+    /**
+     * @brief 生产者写入数据, 剩余空间不足时不写入
+     * @return 是否写入
+     */
+    bool push(const void* data, size_t len) {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        // 消费者的位置只在看起来空间不够时重新读取, 避免每次写入都读对方的缓存行
+        if (m_capacity - (head - m_cachedTail) < len) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (m_capacity - (head - m_cachedTail) < len) {
+                return false;
+            }
+        }
+        size_t pos = head & (m_capacity - 1);
+        size_t first = std::min(len, m_capacity - pos);
+        memcpy(m_data + pos, data, first);
+        memcpy(m_data, (const char*)data + first, len - first);
+        m_head.store(head + len, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 消费者取出可读区间
+     * @param[out] iov 最多两段
+     * @return iov段数, 0表示没有数据
+     */
+    int peek(iovec* iov) const {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        size_t len = head - tail;
+        if (len == 0) {
+            return 0;
+        }
+        size_t pos = tail & (m_capacity - 1);
+        size_t first = std::min(len, m_capacity - pos);
+        iov[0].iov_base = m_data + pos;
+        iov[0].iov_len = first;
+        if (first == len) {
+            return 1;
+        }
+        iov[1].iov_base = m_data;
+        iov[1].iov_len = len - first;
+        return 2;
+    }
+
+    /**
+     * @brief 消费者释放已读取的数据
+     */
+    void consume(size_t len) {
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + len
+                     ,std::memory_order_release);
+    }
+
+    /**
+     * @brief 已使用的字节数, 任意线程可调用, 结果为近似值
+     */
+    size_t size() const {
+        return m_head.load(std::memory_order_acquire)
+            - m_tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief 生产者视角的已使用字节数, 只有生产者调用
+     * @details 结果是上界, 超过一半容量时才重新读取消费者位置
+     */
+    size_t producerSize() {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_cachedTail > m_capacity / 2) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+        }
+        return head - m_cachedTail;
+    }
+
+    size_t capacity() const { return m_capacity;}
+
+    /**
+     * @brief 生产者写入位置, 用于等待消费者追上
+     */
+    uint64_t getHead() const { return m_head.load(std::memory_order_acquire);}
+
+    /**
+     * @brief 消费者读取位置
+     */
+    uint64_t getTail() const { return m_tail.load(std::memory_order_acquire);}
+private:
+    /// 数据
+    char* m_data;
+    /// 容量
+    size_t m_capacity;
+    char m_pad0[64];
+    /// 生产者写入位置
+    std::atomic<uint64_t> m_head;
+    /// 生产者缓存的消费者位置
+    uint64_t m_cachedTail;
+    char m_pad1[64];
+    /// 消费者读取位置
+    std::atomic<uint64_t> m_tail;
+    char m_pad2[64];
+};
+
+}
+
+#endif
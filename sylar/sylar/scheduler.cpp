@@ -2,6 +2,8 @@
 #include "log.h"
 #include "macro.h"
 #include "hook.h"
+#include "config.h"
+#include <algorithm>
 
 namespace sylar
 {
@@ -11,6 +13,28 @@ static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 static thread_local Scheduler* t_scheduler = nullptr;
 // 调度器的主协程
 static thread_local Fiber* t_scheduler_fiber = nullptr;
+// 弹性模式下当前线程最近一次执行任务的时间(毫秒)
+static thread_local uint64_t t_last_busy = 0;
+// 当前线程已被回收
+static thread_local bool t_retired = false;
+
+static ConfigVar<uint32_t>::ptr g_elastic_min_threads =
+    Config::Lookup("scheduler.elastic.min_threads", (uint32_t)1, "elastic scheduler min threads");
+
+static ConfigVar<uint32_t>::ptr g_elastic_max_threads =
+    Config::Lookup("scheduler.elastic.max_threads", (uint32_t)16, "elastic scheduler max threads");
+
+static ConfigVar<uint32_t>::ptr g_elastic_max_latency =
+    Config::Lookup("scheduler.elastic.max_latency", (uint32_t)20, "elastic scheduler queue latency ms to grow");
+
+static ConfigVar<uint32_t>::ptr g_elastic_max_backlog =
+    Config::Lookup("scheduler.elastic.max_backlog", (uint32_t)64, "elastic scheduler queued tasks per thread to grow");
+
+static ConfigVar<uint32_t>::ptr g_elastic_grow_interval =
+    Config::Lookup("scheduler.elastic.grow_interval", (uint32_t)50, "elastic scheduler min ms between grows");
+
+static ConfigVar<uint32_t>::ptr g_elastic_idle_cooldown =
+    Config::Lookup("scheduler.elastic.idle_cooldown", (uint32_t)5000, "elastic scheduler idle ms to retire a thread");
 
 Scheduler::Scheduler(size_t threads, bool use_caller, const std::string& name)
     : m_name(name)
@@ -75,9 +99,128 @@ void Scheduler::start()
             m_name + "_" + std::to_string(i)));
         m_threadIds.push_back(m_threads[i]->getId());
     }
+    m_threadSeq = m_threadCount;
     lock.unlock();
 }
 
+void Scheduler::addScaleListener(ScaleListener cb)
+{
+    MutexType::Lock lock(m_mutex);
+    m_scaleListeners.push_back(cb);
+}
+
+size_t Scheduler::getThreadCount()
+{
+    MutexType::Lock lock(m_mutex);
+    return m_threads.size();
+}
+
+void Scheduler::loadNoLock(uint64_t& latency, size_t& backlog, size_t& threads)
+{
+    threads = m_threads.size();
+    backlog = m_fibers.size();
+    latency = 0;
+    if (backlog) {
+        uint64_t now = GetCurrentMS();
+        uint64_t time = m_fibers.front().time;
+        latency = time && now > time ? now - time : 0;
+    }
+}
+
+void Scheduler::checkGrow(uint64_t latency, size_t backlog, size_t threads)
+{
+    if (latency < g_elastic_max_latency->getValue()
+            && backlog < (uint64_t)g_elastic_max_backlog->getValue() * std::max(threads, (size_t)1)) {
+        return;
+    }
+    // 新线程需要时间消化积压, 限制增加的速度
+    uint64_t now = GetCurrentMS();
+    uint64_t last = m_lastGrow;
+    if (now < last + g_elastic_grow_interval->getValue()
+            || !m_lastGrow.compare_exchange_strong(last, now)) {
+        return;
+    }
+
+    std::vector<Thread::ptr> retired;
+    ScaleEvent ev;
+    {
+        MutexType::Lock lock(m_mutex);
+        if (m_stopping || m_threads.size() >= g_elastic_max_threads->getValue()) {
+            return;
+        }
+        retired.swap(m_retired);
+        // 持有锁创建线程, 保证stop时能看到这个线程
+        Thread::ptr thr(new Thread(std::bind(&Scheduler::run, this),
+                    m_name + "_" + std::to_string(m_threadSeq++)));
+        m_threads.push_back(thr);
+        m_threadIds.push_back(thr->getId());
+        ++m_threadCount;
+        ev.name = m_name;
+        ev.grow = true;
+        ev.threads = m_threads.size();
+        ev.latency = latency;
+        ev.backlog = backlog;
+    }
+    // 回收的线程在retire后很快退出
+    for (auto& i : retired) {
+        i->join();
+    }
+    notifyScale(ev);
+}
+
+bool Scheduler::retire()
+{
+    if (!m_elastic || sylar::GetThreadId() == m_rootThread
+            || GetCurrentMS() < t_last_busy + g_elastic_idle_cooldown->getValue()) {
+        return false;
+    }
+    ScaleEvent ev;
+    {
+        MutexType::Lock lock(m_mutex);
+        if (m_stopping || m_threads.size() <= g_elastic_min_threads->getValue()) {
+            return false;
+        }
+        int id = sylar::GetThreadId();
+        auto it = std::find_if(m_threads.begin(), m_threads.end(), [id](const Thread::ptr& t) {
+            return t->getId() == id;
+        });
+        if (it == m_threads.end()) {
+            return false;
+        }
+        m_retired.push_back(*it);
+        m_threads.erase(it);
+        m_threadIds.erase(std::remove(m_threadIds.begin(), m_threadIds.end(), id), m_threadIds.end());
+        --m_threadCount;
+        // 指定到当前线程的任务改为任意线程执行
+        for (auto& i : m_fibers) {
+            if (i.thread == id) {
+                i.thread = -1;
+            }
+        }
+        ev.name = m_name;
+        ev.grow = false;
+        loadNoLock(ev.latency, ev.backlog, ev.threads);
+    }
+    t_retired = true;
+    notifyScale(ev);
+    return true;
+}
+
+void Scheduler::notifyScale(const ScaleEvent& ev)
+{
+    SYLAR_LOG_INFO(g_logger) << "scheduler " << ev.name << (ev.grow ? " grow" : " shrink")
+        << " threads=" << ev.threads << " latency=" << ev.latency
+        << "ms backlog=" << ev.backlog;
+    std::vector<ScaleListener> cbs;
+    {
+        MutexType::Lock lock(m_mutex);
+        cbs = m_scaleListeners;
+    }
+    for (auto& i : cbs) {
+        i(ev);
+    }
+}
+
 // 两种情况：
 // 1.使用use_caller: 一定要在创建scheduler的线程里面执行stop
 // 2.不使用use_caller: 在任意线程可执行stop
@@ -121,6 +264,8 @@ void Scheduler::stop()
     {
         MutexType::Lock lock(m_mutex);
         thrs.swap(m_threads);
+        thrs.insert(thrs.end(), m_retired.begin(), m_retired.end());
+        m_retired.clear();
     }
 
     for(auto& i : thrs) {
@@ -135,7 +280,7 @@ void Scheduler::setThis()
 
 void Scheduler::run()
 {
-    SYLAR_LOG_DEBUG(g_logger) << m_name << " run";
+    SYLAR_LOG_STATIC_DEBUG(g_logger) << m_name << " run";
     set_hook_enable(true);
     setThis();
     if(sylar::GetThreadId() != m_rootThread) {
@@ -144,12 +289,21 @@ void Scheduler::run()
 
     Fiber::ptr idle_fiber(new Fiber(std::bind(&Scheduler::idle, this)));
     Fiber::ptr cb_fiber;
+    t_last_busy = GetCurrentMS();
+    t_retired = false;
 
     FiberAndThread ft;
     while(true) {
+        // 被回收的线程不再取任务
+        if(t_retired) {
+            break;
+        }
         ft.reset();
         bool tickle_me = false;
         bool is_active = false;
+        uint64_t latency = 0;
+        size_t backlog = 0;
+        size_t threads = 0;
         {
             MutexType::Lock lock(m_mutex);
             auto it = m_fibers.begin();
@@ -173,16 +327,29 @@ void Scheduler::run()
                 break;
             }
             tickle_me |= it != m_fibers.end();
+            if(is_active && m_elastic) {
+                loadNoLock(latency, backlog, threads);
+                uint64_t now = GetCurrentMS();
+                latency = ft.time && now > ft.time ? now - ft.time : 0;
+            }
         }
 
         if(tickle_me) {
             tickle();
         }
 
+        // schedule时可能还没有积压, 取任务时也检查等待时间
+        if(is_active && m_elastic) {
+            checkGrow(latency, backlog, threads);
+        }
+
         if(ft.fiber && (ft.fiber->getState() != Fiber::TERM
                         && ft.fiber->getState() != Fiber::EXCEPT)) {
             ft.fiber->swapIn();
             --m_activeThreadCount;
+            if(m_elastic) {
+                t_last_busy = GetCurrentMS();
+            }
 
             if(ft.fiber->getState() == Fiber::READY) {
                 schedule(ft.fiber);
@@ -200,6 +367,9 @@ void Scheduler::run()
             ft.reset();
             cb_fiber->swapIn();
             --m_activeThreadCount;
+            if(m_elastic) {
+                t_last_busy = GetCurrentMS();
+            }
             if(cb_fiber->getState() == Fiber::READY) {
                 schedule(cb_fiber);
                 cb_fiber.reset();
@@ -216,7 +386,7 @@ void Scheduler::run()
                 continue;
             }
             if(idle_fiber->getState() == Fiber::TERM) {
-                SYLAR_LOG_INFO(g_logger) << "idle fiber term";
+                SYLAR_LOG_STATIC_INFO(g_logger) << "idle fiber term";
                 break;
             }
 
@@ -233,7 +403,7 @@ void Scheduler::run()
 
 void Scheduler::tickle()
 {
-    SYLAR_LOG_INFO(g_logger) << "tickle";
+    SYLAR_LOG_STATIC_INFO(g_logger) << "tickle";
 }
 
 bool Scheduler::stopping()
@@ -245,8 +415,8 @@ bool Scheduler::stopping()
 
 void Scheduler::idle()
 {
-    SYLAR_LOG_INFO(g_logger) << "idle";
-    while(!stopping()) {
+    SYLAR_LOG_STATIC_INFO(g_logger) << "idle";
+    while(!stopping() && !retire()) {
         sylar::Fiber::YieldToHold();
     }
 }
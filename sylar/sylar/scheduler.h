@@ -1,12 +1,15 @@
 #ifndef __SYLAR_SCHEDULER_H__
 #define __SYLAR_SCHEDULER_H__
 
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <vector>
 #include <list>
 #include "thread.h"
 #include "fiber.h"
 #include "mutex.h"
+#include "util.h"
 
 namespace sylar
 {
@@ -16,6 +19,23 @@ public:
     typedef std::shared_ptr<Scheduler> ptr;
     typedef Mutex MutexType; 
 
+    /**
+     * @brief 弹性模式下线程数量变化事件
+     */
+    struct ScaleEvent {
+        /// 调度器名称
+        std::string name;
+        /// true为增加线程, false为回收线程
+        bool grow;
+        /// 变化后的线程数量(不含use_caller线程)
+        size_t threads;
+        /// 触发时队首任务的等待时间(毫秒)
+        uint64_t latency;
+        /// 触发时的队列长度
+        size_t backlog;
+    };
+    typedef std::function<void(const ScaleEvent&)> ScaleListener;
+
     // user_caller=true表示将创建协程调度器构造函数的线程纳入调度器管理
     /**
      * @brief 构造函数
@@ -39,6 +59,28 @@ public:
     void start();
     void stop();
 
+    /**
+     * @brief 设置弹性模式, 在start前调用
+     * @details 队首任务等待超过scheduler.elastic.max_latency毫秒或每线程积压超过
+     *          scheduler.elastic.max_backlog时增加线程, 线程空闲超过
+     *          scheduler.elastic.idle_cooldown毫秒后回收, 线程数量保持在
+     *          scheduler.elastic.min_threads和max_threads之间. 构造时的线程数为初始数量,
+     *          IOManager构造时已经start, 构造后设置即可
+     */
+    void setElastic(bool v) { m_elastic = v;}
+
+    bool isElastic() const { return m_elastic;}
+
+    /**
+     * @brief 添加线程数量变化的监听器, 在触发变化的线程中调用
+     */
+    void addScaleListener(ScaleListener cb);
+
+    /**
+     * @brief 返回当前线程数量(不含use_caller线程)
+     */
+    size_t getThreadCount();
+
      /**
      * @brief 调度协程
      * @param[in] fc 协程或函数
@@ -48,13 +90,22 @@ public:
     void schedule(FiberOrCb fc, int thread = -1)
     {
         bool need_tickle = false;
+        uint64_t latency = 0;
+        size_t backlog = 0;
+        size_t threads = 0;
         {
             MutexType::Lock lock(m_mutex);
             need_tickle = schedulerNoLock(fc, thread);
+            if (m_elastic) {
+                loadNoLock(latency, backlog, threads);
+            }
         }
         if (need_tickle) {
             tickle();
         }
+        if (m_elastic) {
+            checkGrow(latency, backlog, threads);
+        }
     }
 
     /**
@@ -65,16 +116,25 @@ public:
     template <class InputIterator>
     void schedule(InputIterator begin, InputIterator end) {
         bool need_tickle = false;
+        uint64_t latency = 0;
+        size_t backlog = 0;
+        size_t threads = 0;
         {
             MutexType::Lock lock(m_mutex);
             while (begin != end) {
                 need_tickle = schedulerNoLock(&*begin, -1) || need_tickle;
                 ++begin;
             }
+            if (m_elastic) {
+                loadNoLock(latency, backlog, threads);
+            }
         }
         if (need_tickle) {
             tickle();
         }
+        if (m_elastic) {
+            checkGrow(latency, backlog, threads);
+        }
     }
 
 protected:
@@ -97,16 +157,40 @@ protected:
     void run();
 
     bool hasIdleThreads() { return m_idleThreadCount > 0; }
+
+    /**
+     * @brief 弹性模式下当前线程空闲超时且线程数量大于下限时回收当前线程
+     * @details 在idle中调用, 返回true时idle应当返回, 线程随后退出
+     */
+    bool retire();
 private:
     template <class FiberOrCb>
     bool schedulerNoLock(FiberOrCb fc, int thread) {
         bool need_tickle = m_fibers.empty();
         FiberAndThread ft(fc, thread);
         if (ft.fiber || ft.cb) {
+            if (m_elastic) {
+                ft.time = GetCurrentMS();
+            }
             m_fibers.push_back(ft);
         }
         return need_tickle;
     }
+
+    /**
+     * @brief 返回队首任务的等待时间, 队列长度和线程数量, 需要持有m_mutex
+     */
+    void loadNoLock(uint64_t& latency, size_t& backlog, size_t& threads);
+
+    /**
+     * @brief 负载超过阈值时增加一个线程
+     */
+    void checkGrow(uint64_t latency, size_t backlog, size_t threads);
+
+    /**
+     * @brief 通知监听器
+     */
+    void notifyScale(const ScaleEvent& ev);
 private:
     /**
      * @brief 协程/函数/线程组
@@ -115,6 +199,7 @@ private:
         Fiber::ptr fiber;
         std::function<void()> cb;
         int thread; // 线程id
+        uint64_t time = 0; // 弹性模式下的入队时间(毫秒)
 
         FiberAndThread(Fiber::ptr f, int thr)
             : fiber(f)
@@ -149,6 +234,7 @@ private:
             fiber = nullptr;
             cb = nullptr;
             thread = -1;
+            time = 0;
         }
     };
 
@@ -162,6 +248,13 @@ private:
     // use_caller为true有效，调度协程
     Fiber::ptr m_rootFiber;
     std::string m_name;
+    // 弹性模式下回收的线程, 在增加线程和stop时join
+    std::vector<Thread::ptr> m_retired;
+    std::vector<ScaleListener> m_scaleListeners;
+    // 上次增加线程的时间(毫秒)
+    std::atomic<uint64_t> m_lastGrow = { 0 };
+    // 用于线程命名
+    size_t m_threadSeq = 0;
 protected:
     // 协程下的线程id数组
     std::vector<int> m_threadIds;
@@ -171,6 +264,7 @@ protected:
     std::atomic<size_t> m_idleThreadCount = { 0 };
     bool m_stopping = true;
     bool m_autoStop = false;
+    std::atomic<bool> m_elastic = { false };
     // 主线程id
     int m_rootThread = 0;
 };
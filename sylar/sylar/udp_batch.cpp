@@ -0,0 +1,111 @@
+#include "udp_batch.h"
+#include "hook.h"
+#include <errno.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+namespace sylar {
+
+static const size_t s_control_size = CMSG_SPACE(sizeof(int));
+
+UdpBatch::UdpBatch(size_t count, size_t buf_size)
+    :m_count(count)
+    ,m_bufSize(buf_size)
+    ,m_buffer(count * buf_size)
+    ,m_msgs(count)
+    ,m_iovs(count)
+    ,m_addrs(count)
+    ,m_controls(count * s_control_size)
+    ,m_segments(count) {
+    for (size_t i = 0; i < m_count; ++i) {
+        m_iovs[i].iov_base = &m_buffer[i * m_bufSize];
+        resetHeader(i, m_bufSize);
+    }
+}
+
+void UdpBatch::resetHeader(size_t i, size_t len) {
+    m_iovs[i].iov_len = len;
+    msghdr& hdr = m_msgs[i].msg_hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_name = &m_addrs[i];
+    hdr.msg_namelen = sizeof(sockaddr_storage);
+    hdr.msg_iov = &m_iovs[i];
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = &m_controls[i * s_control_size];
+    hdr.msg_controllen = s_control_size;
+    m_msgs[i].msg_len = 0;
+    m_segments[i] = 0;
+}
+
+size_t UdpBatch::getLength(size_t i) const {
+    return m_msgs[i].msg_len;
+}
+
+int UdpBatch::recv(int fd, int flags) {
+    for (size_t i = 0; i < m_count; ++i) {
+        resetHeader(i, m_bufSize);
+    }
+    m_size = 0;
+    int rt = recvmmsg(fd, &m_msgs[0], m_count, flags, nullptr);
+    if (rt <= 0) {
+        return rt;
+    }
+    m_size = rt;
+    for (size_t i = 0; i < m_size; ++i) {
+        msghdr& hdr = m_msgs[i].msg_hdr;
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                int gso_size = 0;
+                memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+                m_segments[i] = gso_size;
+            }
+        }
+    }
+    return rt;
+}
+
+bool UdpBatch::add(const void* data, size_t len, const sockaddr* to, socklen_t tolen) {
+    if (m_size >= m_count || len > m_bufSize
+            || tolen > sizeof(sockaddr_storage)) {
+        return false;
+    }
+    size_t i = m_size++;
+    memcpy(&m_buffer[i * m_bufSize], data, len);
+    resetHeader(i, len);
+    msghdr& hdr = m_msgs[i].msg_hdr;
+    hdr.msg_control = nullptr;
+    hdr.msg_controllen = 0;
+    if (to) {
+        memcpy(&m_addrs[i], to, tolen);
+        hdr.msg_namelen = tolen;
+    } else {
+        hdr.msg_name = nullptr;
+        hdr.msg_namelen = 0;
+    }
+    return true;
+}
+
+int UdpBatch::send(int fd, int flags) {
+    size_t sent = 0;
+    while (sent < m_size) {
+        int rt = sendmmsg(fd, &m_msgs[sent], m_size - sent, flags);
+        if (rt <= 0) {
+            return sent ? (int)sent : -1;
+        }
+        sent += rt;
+    }
+    return sent;
+}
+
+bool UdpBatch::SetGSO(int fd, uint16_t segment_size) {
+    int val = segment_size;
+    return setsockopt(fd, SOL_UDP, UDP_SEGMENT, &val, sizeof(val)) == 0;
+}
+
+bool UdpBatch::SetGRO(int fd, bool on) {
+    int val = on ? 1 : 0;
+    return setsockopt(fd, SOL_UDP, UDP_GRO, &val, sizeof(val)) == 0;
+}
+
+}
@@ -0,0 +1,137 @@
+/**
+ * @file udp_batch.h
+ * @brief UDP批量收发
+ * @details 基于hook的recvmmsg/sendmmsg, 一次系统调用收发多个报文,
+ *          socket无数据或缓冲区满时挂起当前协程
+ */
+#ifndef __SYLAR_UDP_BATCH_H__
+#define __SYLAR_UDP_BATCH_H__
+
+#include <memory>
+#include <vector>
+#include <stdint.h>
+#include <sys/socket.h>
+
+namespace sylar {
+
+/**
+ * @brief UDP批量收发缓冲区
+ */
+class UdpBatch {
+public:
+    typedef std::shared_ptr<UdpBatch> ptr;
+
+    /**
+     * @brief 构造函数
+     * @param[in] count 一次最多收发的报文数量
+     * @param[in] buf_size 每个报文缓冲区大小(开启GRO/GSO时应不小于64K)
+     */
+    UdpBatch(size_t count, size_t buf_size);
+
+    /**
+     * @brief 批量接收报文, 无数据时挂起协程
+     * @param[in] fd socket句柄
+     * @param[in] flags recvmmsg标志
+     * @return 返回接收到的报文数量, 失败返回-1
+     */
+    int recv(int fd, int flags = 0);
+
+    /**
+     * @brief 返回当前有效的报文数量
+     */
+    size_t size() const { return m_size;}
+
+    /**
+     * @brief 返回最大报文数量
+     */
+    size_t capacity() const { return m_count;}
+
+    /**
+     * @brief 返回第i个报文的数据
+     */
+    const char* getData(size_t i) const { return &m_buffer[i * m_bufSize];}
+
+    /**
+     * @brief 返回第i个报文的长度
+     */
+    size_t getLength(size_t i) const;
+
+    /**
+     * @brief 返回第i个报文的对端地址
+     */
+    const sockaddr* getAddr(size_t i) const { return (const sockaddr*)&m_addrs[i];}
+
+    /**
+     * @brief 返回第i个报文的对端地址长度
+     */
+    socklen_t getAddrLen(size_t i) const { return m_msgs[i].msg_hdr.msg_namelen;}
+
+    /**
+     * @brief 返回第i个报文的GRO分段大小
+     * @return 0表示报文未被合并
+     */
+    uint16_t getSegmentSize(size_t i) const { return m_segments[i];}
+
+    /**
+     * @brief 清空待发送报文
+     */
+    void clear() { m_size = 0;}
+
+    /**
+     * @brief 添加待发送报文(拷贝到内部缓冲区)
+     * @param[in] data 数据
+     * @param[in] len 数据长度, 不能超过buf_size
+     * @param[in] to 目的地址, 已connect的socket可为空
+     * @param[in] tolen 目的地址长度
+     * @return 缓冲区已满或数据过长返回false
+     */
+    bool add(const void* data, size_t len, const sockaddr* to = nullptr, socklen_t tolen = 0);
+
+    /**
+     * @brief 发送所有已添加的报文, 缓冲区满时挂起协程
+     * @param[in] fd socket句柄
+     * @param[in] flags sendmmsg标志
+     * @return 返回发送成功的报文数量, 一个都未发送时返回-1
+     */
+    int send(int fd, int flags = 0);
+
+    /**
+     * @brief 设置UDP GSO分段大小(UDP_SEGMENT), 内核按该大小切分每个发送报文
+     * @return 内核不支持返回false
+     */
+    static bool SetGSO(int fd, uint16_t segment_size);
+
+    /**
+     * @brief 开启/关闭UDP GRO(UDP_GRO), 内核会将同流报文合并后交付
+     * @return 内核不支持返回false
+     */
+    static bool SetGRO(int fd, bool on);
+private:
+    /**
+     * @brief 重置第i个报文的头部
+     */
+    void resetHeader(size_t i, size_t len);
+private:
+    /// 最大报文数量
+    size_t m_count;
+    /// 每个报文缓冲区大小
+    size_t m_bufSize;
+    /// 有效报文数量
+    size_t m_size = 0;
+    /// 报文数据
+    std::vector<char> m_buffer;
+    /// 报文头
+    std::vector<mmsghdr> m_msgs;
+    /// 报文数据iovec
+    std::vector<iovec> m_iovs;
+    /// 报文地址
+    std::vector<sockaddr_storage> m_addrs;
+    /// 控制信息缓冲区
+    std::vector<char> m_controls;
+    /// GRO分段大小
+    std::vector<uint16_t> m_segments;
+};
+
+}
+
+#endif
@@ -9,9 +9,33 @@ namespace sylar
 
 sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
+static thread_local pid_t t_thread_id = 0;
+
+/**
+ * @brief fork后子进程中唯一的线程清除继承来的缓存
+ */
+static void ResetThreadIdAfterFork()
+{
+    t_thread_id = 0;
+}
+
+struct ThreadIdAtForkIniter
+{
+    ThreadIdAtForkIniter()
+    {
+        pthread_atfork(nullptr, nullptr, &ResetThreadIdAfterFork);
+    }
+};
+
+static ThreadIdAtForkIniter s_thread_id_atfork_initer;
+
 pid_t GetThreadId()
 {
-    return syscall(SYS_gettid);
+    if (!t_thread_id)
+    {
+        t_thread_id = syscall(SYS_gettid);
+    }
+    return t_thread_id;
 }
 
 uint32_t GetFiberId()
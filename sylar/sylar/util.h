@@ -20,7 +20,7 @@ std::string BacktraceToString(int size = 64, int skip = 2, const std::string& pr
 
 // 时间 ms
 uint64_t GetCurrentMS();
-uint64_t GtCurrentUS();
+uint64_t GetCurrentUS();
 }
 
 #endif
\ No newline at end of file
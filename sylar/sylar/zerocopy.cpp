@@ -0,0 +1,156 @@
+#include "zerocopy.h"
+#include "hook.h"
+#include "config.h"
+#include "iomanager.h"
+#include "log.h"
+#include <errno.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+
+namespace sylar {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static ConfigVar<uint32_t>::ptr g_zerocopy_threshold =
+    Config::Lookup<uint32_t>("tcp.zerocopy.threshold", 16 * 1024, "tcp zerocopy min send size");
+
+ZeroCopySender::ZeroCopySender(int fd)
+    :m_fd(fd) {
+    int one = 1;
+    m_enabled = setsockopt(m_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+    if (!m_enabled) {
+        SYLAR_LOG_INFO(g_logger) << "SO_ZEROCOPY not supported fd=" << m_fd
+            << " errno=" << errno << " " << strerror(errno);
+    }
+}
+
+ZeroCopySender::~ZeroCopySender() {
+    if (!m_inflight.empty()) {
+        // 内核可能仍在引用缓冲区, 宁可泄漏也不能提前释放
+        SYLAR_LOG_ERROR(g_logger) << "ZeroCopySender destroyed with "
+            << m_inflight.size() << " pending sends fd=" << m_fd;
+    }
+}
+
+ssize_t ZeroCopySender::send(const void* data, size_t len, ReleaseCb cb, int flags) {
+    const char* ptr = (const char*)data;
+    size_t offset = 0;
+    if (!m_enabled || len < g_zerocopy_threshold->getValue()) {
+        while (offset < len) {
+            ssize_t n = ::send(m_fd, ptr + offset, len - offset, flags);
+            if (n <= 0) {
+                break;
+            }
+            offset += n;
+        }
+        if (cb) {
+            cb();
+        }
+        return offset == len ? (ssize_t)len : -1;
+    }
+
+    Buffer::ptr buf(new Buffer);
+    buf->cb.swap(cb);
+    while (offset < len) {
+        ssize_t n = ::send(m_fd, ptr + offset, len - offset, flags | MSG_ZEROCOPY);
+        if (n < 0 && errno == ENOBUFS && !m_inflight.empty()) {
+            // 超出optmem限制, 等待已发送的数据完成后重试
+            waitNotify();
+            reap();
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        m_inflight[m_nextId++] = buf;
+        ++buf->refs;
+        offset += n;
+    }
+    if (buf->refs == 0 && buf->cb) {
+        buf->cb();
+    }
+    reap();
+    return offset == len ? (ssize_t)len : -1;
+}
+
+bool ZeroCopySender::complete(uint32_t id) {
+    auto it = m_inflight.find(id);
+    if (it == m_inflight.end()) {
+        return false;
+    }
+    Buffer::ptr buf = it->second;
+    m_inflight.erase(it);
+    if (--buf->refs == 0) {
+        if (buf->cb) {
+            buf->cb();
+        }
+        return true;
+    }
+    return false;
+}
+
+size_t ZeroCopySender::reap() {
+    size_t released = 0;
+    while (!m_inflight.empty()) {
+        char control[128];
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        // 直接调用原始recvmsg, 错误队列为空时不挂起协程
+        int rt = recvmsg_f(m_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+        if (rt < 0) {
+            break;
+        }
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
+                    || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+            sock_extended_err serr;
+            memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+            if (serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr.ee_errno != 0) {
+                continue;
+            }
+            if (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                ++m_copied;
+            }
+            // [ee_info, ee_data]为已完成的发送序号区间
+            for (uint32_t id = serr.ee_info; ; ++id) {
+                if (complete(id)) {
+                    ++released;
+                }
+                if (id == serr.ee_data) {
+                    break;
+                }
+            }
+        }
+    }
+    return released;
+}
+
+void ZeroCopySender::waitNotify() {
+    IOManager* iom = IOManager::GetThis();
+    // 错误队列的通知以EPOLLERR上报, IOManager会唤醒等待读事件的协程
+    // 上次等待被普通可读事件唤醒或读事件已被其他协程占用时退化为短暂睡眠
+    if (iom && !m_spurious && !iom->hasEvent(m_fd, IOManager::READ)
+            && iom->addEvent(m_fd, IOManager::READ) == 0) {
+        Fiber::YieldToHold();
+    } else {
+        usleep(1000);
+    }
+}
+
+void ZeroCopySender::flush() {
+    reap();
+    while (!m_inflight.empty()) {
+        size_t pending = m_inflight.size();
+        waitNotify();
+        reap();
+        m_spurious = m_inflight.size() == pending;
+    }
+    m_spurious = false;
+}
+
+}
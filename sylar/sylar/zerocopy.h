@@ -0,0 +1,113 @@
+/**
+ * @file zerocopy.h
+ * @brief MSG_ZEROCOPY零拷贝发送
+ * @details 大块数据通过SO_ZEROCOPY/MSG_ZEROCOPY发送, 内核通过socket错误队列
+ *          通知数据已不再引用, 此时才释放缓冲区. 小于阈值(tcp.zerocopy.threshold)
+ *          的数据走普通拷贝发送
+ */
+#ifndef __SYLAR_ZEROCOPY_H__
+#define __SYLAR_ZEROCOPY_H__
+
+#include <memory>
+#include <functional>
+#include <map>
+#include <stdint.h>
+#include <sys/types.h>
+#include "noncopyable.h"
+
+namespace sylar {
+
+/**
+ * @brief 零拷贝发送器
+ * @attention 关闭socket前需要调用flush等待所有数据完成
+ */
+class ZeroCopySender : Noncopyable {
+public:
+    typedef std::shared_ptr<ZeroCopySender> ptr;
+    /// 缓冲区释放回调
+    typedef std::function<void()> ReleaseCb;
+
+    /**
+     * @brief 构造函数
+     * @param[in] fd socket句柄, 构造时尝试开启SO_ZEROCOPY
+     */
+    ZeroCopySender(int fd);
+
+    /**
+     * @brief 析构函数
+     */
+    ~ZeroCopySender();
+
+    /**
+     * @brief 是否开启了零拷贝(内核或socket类型不支持时为false)
+     */
+    bool isEnabled() const { return m_enabled;}
+
+    /**
+     * @brief 发送数据, 数据全部交给内核或出错后返回
+     * @param[in] data 数据, 在cb被调用之前必须保持有效
+     * @param[in] len 数据长度
+     * @param[in] cb 内核不再引用数据时的回调, 拷贝发送时返回前调用
+     * @param[in] flags send标志
+     * @return 成功返回len, 失败返回-1
+     */
+    ssize_t send(const void* data, size_t len, ReleaseCb cb, int flags = 0);
+
+    /**
+     * @brief 处理错误队列中已到达的完成通知, 不阻塞
+     * @return 返回释放的缓冲区数量
+     */
+    size_t reap();
+
+    /**
+     * @brief 挂起协程直到所有缓冲区都被内核释放
+     */
+    void flush();
+
+    /**
+     * @brief 返回等待内核完成的发送次数
+     */
+    size_t getPending() const { return m_inflight.size();}
+
+    /**
+     * @brief 返回内核回退为拷贝发送的通知次数
+     * @details 该值持续增长说明网卡不支持零拷贝, 零拷贝反而增加开销
+     */
+    uint64_t getCopiedCount() const { return m_copied;}
+private:
+    /**
+     * @brief 完成一次零拷贝发送
+     * @param[in] id 发送序号
+     * @return 缓冲区被释放返回true
+     */
+    bool complete(uint32_t id);
+
+    /**
+     * @brief 挂起协程等待错误队列有通知
+     */
+    void waitNotify();
+private:
+    struct Buffer {
+        typedef std::shared_ptr<Buffer> ptr;
+        /// 释放回调
+        ReleaseCb cb;
+        /// 未完成的发送次数
+        uint32_t refs = 0;
+    };
+    /// socket句柄
+    int m_fd;
+    /// 是否开启零拷贝
+    bool m_enabled = false;
+    /// 上次等待是否没有收到任何通知
+    bool m_spurious = false;
+    /// 下一次发送的序号(与内核计数一致)
+    uint32_t m_nextId = 0;
+    /// 回退为拷贝的次数
+    uint64_t m_copied = 0;
+    /// 发送序号到缓冲区的映射
+    std::map<uint32_t, Buffer::ptr> m_inflight;
+};
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include "sylar/sylar.h"
+#include "sylar/binlog.h"
+#include <sstream>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const char* s_file = "/tmp/test_binlog.bin";
+
+enum Color {
+    RED = 1,
+    GREEN = 2
+};
+
+void test_decode() {
+    sylar::BinLogger* binlog = sylar::BinLogMgr::GetInstance();
+    std::string name = "fiber";
+    SYLAR_BINLOG_INFO("no argument");
+    SYLAR_BINLOG_INFO("int=%d neg=%ld unsigned=%u hex=%#x", 42, -7L, 3000000000u, 255);
+    SYLAR_BINLOG_WARN("double=%.3f char=%c enum=%d", 3.14159, 'z', GREEN);
+    SYLAR_BINLOG_ERROR("str=%s std=%s width=[%8s] percent=100%%", "hello", name, "ab");
+    SYLAR_BINLOG_DEBUG("ptr=%p null=%s", (void*)0x1234, (const char*)nullptr);
+    binlog->flush();
+
+    std::stringstream ss;
+    SYLAR_ASSERT(sylar::BinLogDecoder::Decode(s_file, ss));
+    std::string text = ss.str();
+    SYLAR_LOG_INFO(g_logger) << "decoded:\n" << text;
+    SYLAR_ASSERT(text.find("[INFO]") != std::string::npos);
+    SYLAR_ASSERT(text.find("\tno argument\n") != std::string::npos);
+    SYLAR_ASSERT(text.find("int=42 neg=-7 unsigned=3000000000 hex=0xff") != std::string::npos);
+    SYLAR_ASSERT(text.find("double=3.142 char=z enum=2") != std::string::npos);
+    SYLAR_ASSERT(text.find("str=hello std=fiber width=[      ab] percent=100%") != std::string::npos);
+    SYLAR_ASSERT(text.find("ptr=0x1234 null=(null)") != std::string::npos);
+}
+
+/**
+ * @brief 当前线程的CPU时间(微秒), 不包含后台写线程的开销
+ */
+static uint64_t thread_cpu_us() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+void test_bench() {
+    static const int s_lines = 1000000;
+    static const int s_threads = 4;
+    sylar::BinLogger* binlog = sylar::BinLogMgr::GetInstance();
+
+    uint64_t begin = sylar::GetCurrentUS();
+    uint64_t begin_cpu = thread_cpu_us();
+    for (int i = 0; i < s_lines; ++i) {
+        SYLAR_BINLOG_DEBUG("bench i=%d value=%f name=%s", i, i * 0.5, "bench");
+    }
+    uint64_t used_cpu = thread_cpu_us() - begin_cpu;
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    binlog->flush();
+
+    std::vector<sylar::Thread::ptr> thrs;
+    begin = sylar::GetCurrentUS();
+    for (int t = 0; t < s_threads; ++t) {
+        thrs.push_back(sylar::Thread::ptr(new sylar::Thread([](){
+            for (int i = 0; i < s_lines; ++i) {
+                SYLAR_BINLOG_DEBUG("thread bench i=%d", i);
+            }
+        }, "binlog_" + std::to_string(t))));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    uint64_t used_mt = sylar::GetCurrentUS() - begin;
+    binlog->flush();
+
+    std::stringstream ss;
+    SYLAR_ASSERT(sylar::BinLogDecoder::Decode(s_file, ss));
+    size_t lines = 0;
+    std::string line;
+    while (std::getline(ss, line)) {
+        ++lines;
+    }
+    SYLAR_LOG_INFO(g_logger) << "binlog 1 thread " << used * 1000 / s_lines << " ns/line (caller cpu "
+        << used_cpu * 1000 / s_lines << " ns/line), "
+        << s_threads << " threads " << used_mt * 1000 / ((uint64_t)s_lines * s_threads)
+        << " ns/line dropped=" << binlog->getDropped() << " decoded lines=" << lines;
+}
+
+int main(int argc, char** argv) {
+    sylar::BinLogger* binlog = sylar::BinLogMgr::GetInstance();
+    SYLAR_ASSERT(binlog->open(s_file, 16 * 1024 * 1024));
+    test_decode();
+    test_bench();
+    binlog->close();
+    return 0;
+}
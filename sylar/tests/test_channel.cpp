@@ -0,0 +1,265 @@
+#include "sylar/sylar.h"
+#include "sylar/iomanager.h"
+#include "sylar/channel.h"
+#include <unistd.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static std::atomic<int> s_done(0);
+
+static void wait_done(int n) {
+    while (s_done < n) {
+        usleep(1000);
+    }
+    s_done = 0;
+}
+
+void test_basic(sylar::IOManager* iom) {
+    sylar::Channel<int>::ptr ch(new sylar::Channel<int>(2));
+    iom->schedule([ch]() {
+        SYLAR_ASSERT(ch->trySend(1) && ch->trySend(2));
+        SYLAR_ASSERT(!ch->trySend(3));
+        // 满时超时
+        uint64_t begin = sylar::GetCurrentMS();
+        SYLAR_ASSERT(!ch->send(3, 50));
+        SYLAR_ASSERT(sylar::GetCurrentMS() - begin >= 40);
+        // 关闭后剩余的元素仍然可以收到
+        ch->close();
+        SYLAR_ASSERT(!ch->send(3));
+        int v = 0;
+        SYLAR_ASSERT(ch->recv(v) && v == 1);
+        SYLAR_ASSERT(ch->recv(v) && v == 2);
+        SYLAR_ASSERT(!ch->recv(v));
+        ++s_done;
+    });
+    wait_done(1);
+
+    // 关闭唤醒挂起的接收者
+    sylar::Channel<std::string>::ptr sch(new sylar::Channel<std::string>());
+    iom->schedule([sch]() {
+        std::string v;
+        SYLAR_ASSERT(sch->recv(v) && v == "hello");
+        SYLAR_ASSERT(!sch->recv(v));
+        ++s_done;
+    });
+    iom->schedule([sch]() {
+        usleep(10 * 1000);
+        sch->send("hello");
+        usleep(10 * 1000);
+        sch->close();
+        ++s_done;
+    });
+    wait_done(2);
+    SYLAR_LOG_INFO(g_logger) << "test_basic ok";
+}
+
+void test_select(sylar::IOManager* iom) {
+    sylar::Channel<int>::ptr a(new sylar::Channel<int>(1));
+    sylar::Channel<std::string>::ptr b(new sylar::Channel<std::string>(1));
+    sylar::Channel<int>::ptr out(new sylar::Channel<int>(1));
+    iom->schedule([=]() {
+        int av = 0;
+        std::string bv;
+        {
+            sylar::ChannelSelect sel;
+            sel.recv(a, av).recv(b, bv);
+            SYLAR_ASSERT(sel.wait(0) == -1);
+            uint64_t begin = sylar::GetCurrentMS();
+            SYLAR_ASSERT(sel.wait(30) == -1);
+            SYLAR_ASSERT(sylar::GetCurrentMS() - begin >= 20);
+        }
+        // 挂起后被第二个通道唤醒
+        {
+            sylar::ChannelSelect sel;
+            sel.recv(a, av).recv(b, bv);
+            SYLAR_ASSERT(sel.wait() == 1 && sel.ok() && bv == "b");
+        }
+        // 立即完成的发送
+        {
+            sylar::ChannelSelect sel;
+            sel.recv(a, av).send(out, 42);
+            SYLAR_ASSERT(sel.wait() == 1 && sel.ok());
+        }
+        // 关闭的通道
+        a->close();
+        {
+            sylar::ChannelSelect sel;
+            sel.recv(a, av).recv(b, bv);
+            SYLAR_ASSERT(sel.wait() == 0 && !sel.ok());
+        }
+        ++s_done;
+    });
+    iom->schedule([=]() {
+        usleep(50 * 1000);
+        b->send("b");
+        ++s_done;
+    });
+    wait_done(2);
+    SYLAR_ASSERT(out->size() == 1 && b->size() == 0);
+
+    // 多个select竞争同一批通道, 每个值只被收到一次
+    static const int s_count = 20000;
+    sylar::Channel<int>::ptr c1(new sylar::Channel<int>(16));
+    sylar::Channel<int>::ptr c2(new sylar::Channel<int>(16));
+    std::atomic<int64_t> sum(0);
+    for (int i = 0; i < 4; ++i) {
+        iom->schedule([=, &sum]() {
+            int v1 = 0;
+            int v2 = 0;
+            while (true) {
+                sylar::ChannelSelect sel;
+                sel.recv(c1, v1).recv(c2, v2);
+                int idx = sel.wait();
+                if (!sel.ok()) {
+                    break;
+                }
+                sum += idx == 0 ? v1 : v2;
+            }
+            ++s_done;
+        });
+    }
+    iom->schedule([=]() {
+        for (int i = 1; i <= s_count; ++i) {
+            (i % 2 ? c1 : c2)->send(i);
+        }
+        c1->close();
+        ++s_done;
+    });
+    wait_done(5);
+    // c1关闭后select返回, c2里的剩余值单独收
+    iom->schedule([=, &sum]() {
+        int v = 0;
+        while (c2->tryRecv(v)) {
+            sum += v;
+        }
+        ++s_done;
+    });
+    wait_done(1);
+    SYLAR_ASSERT(sum == (int64_t)s_count * (s_count + 1) / 2);
+    SYLAR_LOG_INFO(g_logger) << "test_select ok";
+}
+
+/**
+ * @brief 两个协程通过两个通道来回传递
+ */
+void bench_ping_pong(sylar::IOManager* a, sylar::IOManager* b, const std::string& name) {
+    static const int s_rounds = 100000;
+    sylar::Channel<int>::ptr ping(new sylar::Channel<int>(1));
+    sylar::Channel<int>::ptr pong(new sylar::Channel<int>(1));
+    uint64_t begin = sylar::GetCurrentUS();
+    a->schedule([=]() {
+        for (int i = 0; i < s_rounds; ++i) {
+            ping->send(i);
+            int v = 0;
+            pong->recv(v);
+            SYLAR_ASSERT(v == i);
+        }
+        ++s_done;
+    });
+    b->schedule([=]() {
+        int v = 0;
+        while (ping->recv(v)) {
+            pong->send(v);
+            if (v == s_rounds - 1) {
+                break;
+            }
+        }
+        ++s_done;
+    });
+    wait_done(2);
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "ping-pong " << name << ": " << used * 1000.0 / s_rounds
+        << " ns/round trip";
+}
+
+/**
+ * @brief 原来的做法: Mutex保护的队列加FiberSemaphore计数
+ */
+template<class T>
+class LockedQueue {
+public:
+    void push(const T& v) {
+        {
+            sylar::Mutex::Lock lock(m_mutex);
+            m_queue.push_back(v);
+        }
+        m_sem.notify();
+    }
+
+    T pop() {
+        m_sem.wait();
+        sylar::Mutex::Lock lock(m_mutex);
+        T v = m_queue.front();
+        m_queue.pop_front();
+        return v;
+    }
+private:
+    sylar::Mutex m_mutex;
+    sylar::FiberSemaphore m_sem;
+    std::list<T> m_queue;
+};
+
+/**
+ * @brief 多个生产者发给一个消费者
+ */
+void bench_fan_in(sylar::IOManager* iom) {
+    static const int s_producers = 8;
+    static const int s_per_producer = 100000;
+    static const int s_total = s_producers * s_per_producer;
+
+    sylar::Channel<int>::ptr ch(new sylar::Channel<int>(1024));
+    uint64_t begin = sylar::GetCurrentUS();
+    for (int p = 0; p < s_producers; ++p) {
+        iom->schedule([=]() {
+            for (int i = 0; i < s_per_producer; ++i) {
+                ch->send(i);
+            }
+            ++s_done;
+        });
+    }
+    iom->schedule([=]() {
+        int v = 0;
+        for (int i = 0; i < s_total; ++i) {
+            SYLAR_ASSERT(ch->recv(v));
+        }
+        ++s_done;
+    });
+    wait_done(s_producers + 1);
+    uint64_t channel_used = sylar::GetCurrentUS() - begin;
+
+    std::shared_ptr<LockedQueue<int> > queue(new LockedQueue<int>);
+    begin = sylar::GetCurrentUS();
+    for (int p = 0; p < s_producers; ++p) {
+        iom->schedule([=]() {
+            for (int i = 0; i < s_per_producer; ++i) {
+                queue->push(i);
+            }
+            ++s_done;
+        });
+    }
+    iom->schedule([=]() {
+        for (int i = 0; i < s_total; ++i) {
+            queue->pop();
+        }
+        ++s_done;
+    });
+    wait_done(s_producers + 1);
+    uint64_t queue_used = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "fan-in " << s_producers << "x" << s_per_producer << ": Channel "
+        << s_total * 1.0 / channel_used << " M msg/s, Mutex+FiberSemaphore "
+        << s_total * 1.0 / queue_used << " M msg/s";
+}
+
+int main(int argc, char** argv) {
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::Level::INFO);
+    SYLAR_LOG_ROOT()->setLevel(sylar::LogLevel::Level::INFO);
+    sylar::IOManager iom(2, false, "iom");
+    sylar::IOManager other(1, false, "other");
+    test_basic(&iom);
+    test_select(&iom);
+    bench_ping_pong(&other, &other, "same scheduler");
+    bench_ping_pong(&iom, &other, "cross scheduler");
+    bench_fan_in(&iom);
+    SYLAR_LOG_INFO(g_logger) << "test_channel ok";
+    return 0;
+}
@@ -1,7 +1,11 @@
 #include "sylar/config.h"
 #include "sylar/log.h"
+#include "sylar/thread.h"
+#include "sylar/macro.h"
+#include "sylar/util.h"
 #include <yaml-cpp/yaml.h>
 #include <iostream>
+#include <fstream>
 
 sylar::ConfigVar<int>::ptr g_int_value_config = 
     sylar::Config::Lookup("system.port", (int)8080, "system port");
@@ -218,8 +222,194 @@ void test_log()
 
 }
 
+/**
+ * @brief 多线程读取时不断修改配置, 读到的快照必须完整
+ */
+void test_snapshot()
+{
+    static const int s_reads = 2000000;
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> changes(0);
+    sylar::Thread::ptr writer(new sylar::Thread([&stop, &changes]() {
+        int n = 0;
+        while (!stop)
+        {
+            ++n;
+            g_int_vec_value_config->setValue(std::vector<int>(16, n));
+            ++changes;
+        }
+    }, "writer"));
+
+    std::vector<sylar::Thread::ptr> readers;
+    std::atomic<uint64_t> used(0);
+    for (int i = 0; i < 2; ++i)
+    {
+        readers.push_back(sylar::Thread::ptr(new sylar::Thread([&used]() {
+            uint64_t begin = sylar::GetCurrentUS();
+            for (int n = 0; n < s_reads; ++n)
+            {
+                const std::vector<int>& v = g_int_vec_value_config->getView();
+                SYLAR_ASSERT(v.front() == v.back());
+            }
+            used += sylar::GetCurrentUS() - begin;
+        }, "reader_" + std::to_string(i))));
+    }
+    for (auto& i : readers)
+    {
+        i->join();
+    }
+    stop = true;
+    writer->join();
+
+    uint64_t begin = sylar::GetCurrentUS();
+    size_t total = 0;
+    for (int n = 0; n < s_reads; ++n)
+    {
+        total += g_int_vec_value_config->getValue().size();
+    }
+    uint64_t copy_used = sylar::GetCurrentUS() - begin;
+    begin = sylar::GetCurrentUS();
+    for (int n = 0; n < s_reads; ++n)
+    {
+        total += g_int_vec_value_config->getView().size();
+    }
+    uint64_t view_used = sylar::GetCurrentUS() - begin;
+    begin = sylar::GetCurrentUS();
+    for (int n = 0; n < s_reads; ++n)
+    {
+        total += g_int_vec_value_config->getSnapshot()->size();
+    }
+    uint64_t snapshot_used = sylar::GetCurrentUS() - begin;
+
+    sylar::ConfigVar<std::vector<int>>::ConstPtr old = g_int_vec_value_config->getSnapshot();
+    g_int_vec_value_config->setValue(std::vector<int>{1, 2, 3});
+    SYLAR_ASSERT(old->size() == 16 && g_int_vec_value_config->getView().size() == 3);
+
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "config read with " << changes << " concurrent changes: "
+        << used * 1000.0 / (2 * s_reads) << " ns/view; idle: getValue "
+        << copy_used * 1000.0 / s_reads << " ns, getView "
+        << view_used * 1000.0 / s_reads << " ns, getSnapshot "
+        << snapshot_used * 1000.0 / s_reads << " ns total=" << total;
+}
+
+sylar::ConfigVar<std::map<std::string, std::string>>::ptr g_routes = 
+    sylar::Config::Lookup("load.routes", std::map<std::string, std::string>(), "load routes");
+sylar::ConfigVar<std::vector<int>>::ptr g_load_ports = 
+    sylar::Config::Lookup("load.ports", std::vector<int>(), "load ports");
+
+/**
+ * @brief 生成测试文件, 已注册的load.routes有routes项, 未注册的unused子树有unused项
+ */
+static void write_load_file(const std::string& path, int file, int routes, int unused)
+{
+    std::ofstream ofs(path);
+    ofs << "load:\n    ports: [" << file << ", " << file + 1 << "]\n    routes:\n";
+    for (int i = 0; i < routes; ++i)
+    {
+        ofs << "        /api/" << file << "/" << i << ": backend_" << i % 16 << "\n";
+    }
+    ofs << "unused:\n";
+    for (int i = 0; i < unused; ++i)
+    {
+        ofs << "    item_" << i << ":\n        name: item_" << i << "\n        tags: [a, b, c]\n";
+    }
+}
+
+/**
+ * @brief 原来的加载方式: 列出所有节点, 非标量序列化成字符串再解析
+ */
+static void load_by_string(const std::string& prefix, const YAML::Node& node)
+{
+    if (!prefix.empty())
+    {
+        sylar::ConfigVarBase::ptr var = sylar::Config::LookupBase(prefix);
+        if (var)
+        {
+            std::stringstream ss;
+            ss << node;
+            var->fromString(ss.str());
+        }
+    }
+    if (node.IsMap())
+    {
+        for (auto it = node.begin(); it != node.end(); ++it)
+        {
+            load_by_string(prefix.empty() ? it->first.Scalar()
+                : prefix + "." + it->first.Scalar(), it->second);
+        }
+    }
+}
+
+void test_load()
+{
+    static const int s_files = 4;
+    static const int s_routes = 20000;
+    std::vector<std::string> files;
+    for (int i = 0; i < s_files; ++i)
+    {
+        files.push_back("/tmp/test_config_load_" + std::to_string(i) + ".yml");
+        write_load_file(files.back(), i, s_routes, s_routes / 4);
+    }
+
+    std::vector<YAML::Node> roots;
+    uint64_t begin = sylar::GetCurrentUS();
+    for (auto& i : files)
+    {
+        roots.push_back(YAML::LoadFile(i));
+    }
+    uint64_t parse_used = sylar::GetCurrentUS() - begin;
+
+    g_routes->setValue({});
+    begin = sylar::GetCurrentUS();
+    for (auto& i : roots)
+    {
+        load_by_string("", i);
+    }
+    uint64_t string_used = sylar::GetCurrentUS() - begin;
+    SYLAR_ASSERT(g_routes->getView().size() == s_routes);
+
+    g_routes->setValue({});
+    begin = sylar::GetCurrentUS();
+    for (auto& i : roots)
+    {
+        sylar::Config::LoadFromYaml(i);
+    }
+    uint64_t node_used = sylar::GetCurrentUS() - begin;
+    SYLAR_ASSERT(g_routes->getView().size() == s_routes);
+
+    g_routes->setValue({});
+    begin = sylar::GetCurrentUS();
+    SYLAR_ASSERT(sylar::Config::LoadFromFiles(files, 1) == s_files);
+    uint64_t serial_used = sylar::GetCurrentUS() - begin;
+
+    g_routes->setValue({});
+    begin = sylar::GetCurrentUS();
+    SYLAR_ASSERT(sylar::Config::LoadFromFiles(files, s_files) == s_files);
+    uint64_t parallel_used = sylar::GetCurrentUS() - begin;
+
+    // 后面的文件覆盖前面的
+    SYLAR_ASSERT(g_routes->getView().size() == s_routes);
+    SYLAR_ASSERT(g_routes->getView().count("/api/" + std::to_string(s_files - 1) + "/0"));
+    SYLAR_ASSERT(g_load_ports->getView().front() == s_files - 1);
+
+    std::vector<std::string> bad = files;
+    bad.insert(bad.begin() + 1, "/tmp/test_config_load_none.yml");
+    SYLAR_ASSERT(sylar::Config::LoadFromFiles(bad, 2) == s_files);
+
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << s_files << " files x " << s_routes << " routes: parse "
+        << parse_used / 1000 << " ms; apply by string " << string_used / 1000
+        << " ms, by node " << node_used / 1000 << " ms; LoadFromFiles serial "
+        << serial_used / 1000 << " ms, " << s_files << " threads " << parallel_used / 1000 << " ms";
+    for (auto& i : files)
+    {
+        remove(i.c_str());
+    }
+}
+
 int main()
 {
+    test_snapshot();
+    test_load();
     //test_yaml();
     // test_config();
     // test_class();
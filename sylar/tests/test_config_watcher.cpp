@@ -0,0 +1,94 @@
+#include "sylar/sylar.h"
+#include "sylar/iomanager.h"
+#include "sylar/config_watcher.h"
+#include <fstream>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+sylar::ConfigVar<int>::ptr g_port =
+    sylar::Config::Lookup("watch.port", (int)8080, "watch port");
+sylar::ConfigVar<std::vector<std::string> >::ptr g_hosts =
+    sylar::Config::Lookup("watch.hosts", std::vector<std::string>{"a"}, "watch hosts");
+
+static int s_port_changes = 0;
+static int s_hosts_changes = 0;
+
+static const std::string s_dir = "/tmp/test_config_watcher";
+
+/**
+ * @brief 先写临时文件再重命名, 和编辑器的保存方式一样
+ */
+static void write_config(int port, const std::string& hosts) {
+    std::string tmp = s_dir + "/.app.yml.tmp";
+    {
+        std::ofstream ofs(tmp);
+        ofs << "watch:\n"
+            << "    port: " << port << "\n"
+            << "    hosts: [" << hosts << "]\n"
+            << "unknown:\n"
+            << "    key: 1\n";
+    }
+    rename(tmp.c_str(), (s_dir + "/app.yml").c_str());
+}
+
+void run(sylar::IOManager* iom) {
+    g_port->addListener([](const int&, const int&) {
+        ++s_port_changes;
+    });
+    g_hosts->addListener([](const std::vector<std::string>&, const std::vector<std::string>&) {
+        ++s_hosts_changes;
+    });
+    mkdir(s_dir.c_str(), 0755);
+    write_config(9000, "a, b");
+
+    sylar::ConfigWatcher::ptr watcher(new sylar::ConfigWatcher(iom));
+    SYLAR_ASSERT(watcher->addDirectory(s_dir));
+    SYLAR_ASSERT(g_port->getValue() == 9000 && g_hosts->getValue().size() == 2);
+    SYLAR_ASSERT(s_port_changes == 1 && s_hosts_changes == 1);
+
+    // 只修改port, hosts的值和监听器都不应被调用
+    uint64_t begin = sylar::GetCurrentMS();
+    write_config(9001, "a, b");
+    while (g_port->getValue() != 9001 && sylar::GetCurrentMS() - begin < 3000) {
+        usleep(10 * 1000);
+    }
+    uint64_t latency = sylar::GetCurrentMS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "reload latency " << latency << "ms changed="
+        << watcher->getLastChanged();
+    SYLAR_ASSERT(g_port->getValue() == 9001);
+    SYLAR_ASSERT(watcher->getLastChanged() == 1);
+    SYLAR_ASSERT(s_port_changes == 2 && s_hosts_changes == 1);
+
+    // 连续修改被合并, 持续修改时最迟max_delay后加载
+    uint64_t reloads = watcher->getReloads();
+    for (int i = 0; i < 30; ++i) {
+        write_config(10000 + i, "c");
+        usleep(50 * 1000);
+    }
+    usleep(500 * 1000);
+    SYLAR_LOG_INFO(g_logger) << "30 writes in 1.5s -> reloads=" << watcher->getReloads() - reloads
+        << " port=" << g_port->getValue();
+    SYLAR_ASSERT(g_port->getValue() == 10029 && g_hosts->getValue().size() == 1);
+    SYLAR_ASSERT(watcher->getReloads() - reloads >= 2 && watcher->getReloads() - reloads <= 6);
+
+    // 格式错误时保留当前值
+    {
+        std::ofstream ofs(s_dir + "/app.yml");
+        ofs << "watch: [port: {";
+    }
+    usleep(500 * 1000);
+    SYLAR_ASSERT(g_port->getValue() == 10029);
+
+    watcher->stop();
+    SYLAR_LOG_INFO(g_logger) << "test_config_watcher ok";
+}
+
+int main(int argc, char** argv) {
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::Level::INFO);
+    sylar::IOManager iom(2);
+    iom.schedule(std::bind(run, &iom));
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "sylar/sylar.h"
+#include "sylar/iomanager.h"
+#include "sylar/connector.h"
+#include "sylar/hook.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <string.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static sylar::IPv4Address::ptr listen_on(int& sock, int backlog) {
+    sylar::IPv4Address::ptr addr(new sylar::IPv4Address(INADDR_LOOPBACK, 0));
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    bind(sock, addr->getAddr(), addr->getAddrLen());
+    listen(sock, backlog);
+    socklen_t len = addr->getAddrLen();
+    getsockname(sock, (sockaddr*)addr->getAddr(), &len);
+    return addr;
+}
+
+void run() {
+    // 全连接队列占满且不accept, 之后的SYN会被丢弃, 模拟不可达地址
+    int black_sock = -1;
+    sylar::IPv4Address::ptr black = listen_on(black_sock, 0);
+    std::vector<int> fillers;
+    for (int i = 0; i < 4; ++i) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        connect_f(fd, black->getAddr(), black->getAddrLen());
+        fillers.push_back(fd);
+    }
+    usleep(100 * 1000);
+
+    int good_sock = -1;
+    sylar::IPv4Address::ptr good = listen_on(good_sock, 8);
+
+    std::vector<sylar::Address::ptr> addrs = {black, good};
+    uint64_t begin = sylar::GetCurrentMS();
+    int fd = sylar::ConnectAny(addrs, 3000, 250);
+    SYLAR_LOG_INFO(g_logger) << "connect " << black->toString() << "," << good->toString()
+        << " fd=" << fd << " errno=" << (fd == -1 ? errno : 0)
+        << " used=" << (sylar::GetCurrentMS() - begin) << "ms";
+    if (fd != -1) {
+        close(fd);
+    }
+
+    // 不指定超时时使用tcp.connect.timeout
+    addrs = {good};
+    fd = sylar::ConnectAny(addrs);
+    SYLAR_LOG_INFO(g_logger) << "connect " << good->toString() << " with default timeout fd=" << fd;
+    SYLAR_ASSERT(fd != -1);
+    close(fd);
+
+    // 配置为负数、CONNECT_NO_TIMEOUT和超大的超时时间都不限制超时, 不能因截止时间回绕立即失败
+    sylar::ConfigVar<int>::ptr connect_timeout = sylar::Config::Lookup<int>("tcp.connect.timeout");
+    int old_timeout = connect_timeout->getValue();
+    connect_timeout->setValue(-1);
+    std::vector<uint64_t> timeouts = {sylar::CONNECT_USE_CONFIG, sylar::CONNECT_NO_TIMEOUT, ~0ull / 2 + 1};
+    for (auto timeout : timeouts) {
+        fd = sylar::ConnectAny(addrs, timeout);
+        SYLAR_LOG_INFO(g_logger) << "connect " << good->toString() << " timeout=" << timeout
+            << " fd=" << fd << " errno=" << (fd == -1 ? errno : 0);
+        SYLAR_ASSERT(fd != -1);
+        close(fd);
+    }
+    connect_timeout->setValue(old_timeout);
+
+    addrs = {black};
+    begin = sylar::GetCurrentMS();
+    fd = sylar::ConnectAny(addrs, 500, 250);
+    SYLAR_LOG_INFO(g_logger) << "connect " << black->toString()
+        << " fd=" << fd << " errno=" << (fd == -1 ? errno : 0)
+        << " used=" << (sylar::GetCurrentMS() - begin) << "ms";
+
+    for (auto i : fillers) {
+        close(i);
+    }
+    close(black_sock);
+    close(good_sock);
+}
+
+int main(int argc, char** argv) {
+    sylar::IOManager iom;
+    iom.schedule(run);
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include "sylar/sylar.h"
+#include "sylar/iomanager.h"
+#include "sylar/address.h"
+#include "sylar/dns.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <string.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static bool s_stop = false;
+static int s_lossy_count = 0;
+
+static std::string parse_qname(const std::string& req, size_t& pos) {
+    std::string name;
+    while (pos < req.size() && req[pos]) {
+        uint8_t len = req[pos++];
+        if (!name.empty()) {
+            name += ".";
+        }
+        name.append(req, pos, len);
+        pos += len;
+    }
+    ++pos;
+    return name;
+}
+
+static void put16(std::string& buf, uint16_t v) {
+    buf.push_back(v >> 8);
+    buf.push_back(v & 0xff);
+}
+
+static void put32(std::string& buf, uint32_t v) {
+    put16(buf, v >> 16);
+    put16(buf, v & 0xffff);
+}
+
+/**
+ * @brief 本地DNS应答, a.test(A TTL=1), v6.test(AAAA), missing.test(NXDOMAIN),
+ *        lossy.test(丢弃第一次查询)
+ */
+static std::string make_response(const std::string& req) {
+    size_t pos = 12;
+    std::string name = parse_qname(req, pos);
+    uint16_t qtype = ((uint8_t)req[pos] << 8) | (uint8_t)req[pos + 1];
+    pos += 4;
+
+    std::vector<std::string> rdatas;
+    uint32_t ttl = 60;
+    uint16_t rcode = 0;
+    if (name == "a.test" && qtype == 1) {
+        rdatas.push_back(std::string("\x0a\x00\x00\x01", 4));
+        rdatas.push_back(std::string("\x0a\x00\x00\x02", 4));
+        ttl = 1;
+    } else if (name == "v6.test" && qtype == 28) {
+        rdatas.push_back(std::string("\x20\x01\x0d\xb8\0\0\0\0\0\0\0\0\0\0\0\x01", 16));
+    } else if (name == "lossy.test" && qtype == 1) {
+        if (s_lossy_count++ == 0) {
+            return "";
+        }
+        rdatas.push_back(std::string("\x0a\x00\x00\x03", 4));
+    } else if (name == "missing.test") {
+        rcode = 3;
+    }
+
+    std::string resp = req.substr(0, pos);
+    resp[2] = (char)0x81;
+    resp[3] = (char)(0x80 | rcode);
+    resp[6] = 0;
+    resp[7] = rdatas.size();
+    for (auto& i : rdatas) {
+        put16(resp, 0xc00c);
+        put16(resp, qtype);
+        put16(resp, 1);
+        put32(resp, ttl);
+        put16(resp, i.size());
+        resp += i;
+    }
+    return resp;
+}
+
+void dns_server(int sock) {
+    char buf[512];
+    while (!s_stop) {
+        sockaddr_in from;
+        socklen_t len = sizeof(from);
+        ssize_t n = recvfrom(sock, buf, sizeof(buf), 0, (sockaddr*)&from, &len);
+        if (n <= 12) {
+            continue;
+        }
+        std::string resp = make_response(std::string(buf, n));
+        if (!resp.empty()) {
+            sendto(sock, resp.data(), resp.size(), 0, (sockaddr*)&from, len);
+        }
+    }
+    close(sock);
+}
+
+static void lookup(const std::string& host, int family = AF_INET) {
+    std::vector<sylar::Address::ptr> addrs;
+    uint64_t begin = sylar::GetCurrentMS();
+    bool v = sylar::Address::Lookup(addrs, host, family);
+    std::stringstream ss;
+    for (auto& i : addrs) {
+        ss << " " << i->toString();
+    }
+    SYLAR_LOG_INFO(g_logger) << "lookup " << host << " rt=" << v << ss.str()
+        << " queries=" << sylar::DnsMgr::GetInstance()->getQueryCount()
+        << " used=" << (sylar::GetCurrentMS() - begin) << "ms";
+}
+
+void run() {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sylar::IPv4Address::ptr addr(new sylar::IPv4Address(INADDR_LOOPBACK, 0));
+    bind(sock, addr->getAddr(), addr->getAddrLen());
+    socklen_t len = addr->getAddrLen();
+    getsockname(sock, (sockaddr*)addr->getAddr(), &len);
+    sylar::IOManager::GetThis()->schedule(std::bind(dns_server, sock));
+
+    sylar::Config::Lookup<std::vector<std::string> >("dns.servers")->setValue({addr->toString()});
+    sylar::Config::Lookup<int>("dns.timeout")->setValue(200);
+
+    lookup("127.0.0.1:8080");
+    lookup("[::1]:80", AF_INET6);
+    lookup("localhost:80");
+    lookup("a.test:80");
+    lookup("a.test:81");
+    sleep(2);
+    lookup("a.test");
+    lookup("v6.test:443", AF_UNSPEC);
+    lookup("missing.test");
+    lookup("missing.test");
+    lookup("lossy.test");
+
+    s_stop = true;
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+    sendto(s, "", 0, 0, addr->getAddr(), addr->getAddrLen());
+    close(s);
+}
+
+int main(int argc, char** argv) {
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::Level::INFO);
+    sylar::IOManager iom;
+    iom.schedule(run);
+    return 0;
+}
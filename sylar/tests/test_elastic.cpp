@@ -0,0 +1,83 @@
+#include "sylar/sylar.h"
+#include "sylar/iomanager.h"
+#include "sylar/hook.h"
+#include <unistd.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static std::atomic<int> s_grows(0);
+static std::atomic<int> s_shrinks(0);
+static std::atomic<int> s_done(0);
+
+/**
+ * @brief 阻塞线程的任务, 占住工作线程让队列积压
+ */
+void block_task() {
+    sylar::set_hook_enable(false);
+    usleep(100 * 1000);
+    sylar::set_hook_enable(true);
+    ++s_done;
+}
+
+int main(int argc, char** argv) {
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::Level::INFO);
+    sylar::Config::Lookup<uint32_t>("scheduler.elastic.max_threads")->setValue(4);
+    sylar::Config::Lookup<uint32_t>("scheduler.elastic.min_threads")->setValue(1);
+    sylar::Config::Lookup<uint32_t>("scheduler.elastic.max_latency")->setValue(20);
+    sylar::Config::Lookup<uint32_t>("scheduler.elastic.idle_cooldown")->setValue(300);
+
+    {
+        sylar::IOManager iom(1, false, "elastic");
+        iom.setElastic(true);
+        iom.addScaleListener([](const sylar::Scheduler::ScaleEvent& ev) {
+            SYLAR_LOG_INFO(g_logger) << "scale event " << ev.name << " grow=" << ev.grow
+                << " threads=" << ev.threads << " latency=" << ev.latency
+                << " backlog=" << ev.backlog;
+            if (ev.grow) {
+                ++s_grows;
+            } else {
+                ++s_shrinks;
+            }
+        });
+        SYLAR_ASSERT(iom.getThreadCount() == 1);
+
+        // 32个各阻塞100ms的任务, 单线程需要3.2s
+        uint64_t begin = sylar::GetCurrentMS();
+        for (int i = 0; i < 32; ++i) {
+            iom.schedule(&block_task);
+        }
+        size_t peak = 0;
+        while (s_done < 32) {
+            peak = std::max(peak, iom.getThreadCount());
+            usleep(10 * 1000);
+        }
+        uint64_t used = sylar::GetCurrentMS() - begin;
+        SYLAR_LOG_INFO(g_logger) << "32 blocking tasks used " << used << "ms peak threads=" << peak
+            << " grows=" << s_grows;
+        SYLAR_ASSERT(peak > 1 && peak <= 4);
+        SYLAR_ASSERT(s_grows == (int)peak - 1);
+        SYLAR_ASSERT(used < 3000);
+
+        // 空闲超过cooldown后回收到下限, epoll_wait最多3s醒来一次
+        begin = sylar::GetCurrentMS();
+        while (iom.getThreadCount() > 1 && sylar::GetCurrentMS() - begin < 8000) {
+            usleep(50 * 1000);
+        }
+        SYLAR_LOG_INFO(g_logger) << "shrink to " << iom.getThreadCount() << " in "
+            << sylar::GetCurrentMS() - begin << "ms shrinks=" << s_shrinks;
+        SYLAR_ASSERT(iom.getThreadCount() == 1);
+        SYLAR_ASSERT(s_shrinks == (int)peak - 1);
+
+        // 回收后仍然可以继续增加
+        s_done = 0;
+        for (int i = 0; i < 8; ++i) {
+            iom.schedule(&block_task);
+        }
+        while (s_done < 8) {
+            usleep(10 * 1000);
+        }
+        SYLAR_ASSERT(s_grows > (int)peak - 1);
+    }
+    SYLAR_LOG_INFO(g_logger) << "test_elastic ok";
+    return 0;
+}
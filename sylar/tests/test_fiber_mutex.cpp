@@ -0,0 +1,188 @@
+#include "sylar/sylar.h"
+#include "sylar/iomanager.h"
+#include <unistd.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static sylar::FiberMutex s_mutex;
+static sylar::FiberRWMutex s_rwmutex;
+static sylar::FiberCondition s_cond;
+
+/**
+ * @brief 持有锁期间做hook的sleep, 线程上的其他协程应该继续执行
+ */
+void test_mutex(sylar::IOManager* iom, sylar::IOManager* other) {
+    static const int s_fibers = 20;
+    static const int s_loops = 200;
+    std::atomic<int> done(0);
+    std::atomic<int> ticks(0);
+    int count = 0;
+    bool inside = false;
+    auto worker = [&]() {
+        for (int i = 0; i < s_loops; ++i) {
+            sylar::FiberMutex::Lock lock(s_mutex);
+            SYLAR_ASSERT(!inside);
+            inside = true;
+            if (i % 50 == 0) {
+                usleep(1000);
+            }
+            ++count;
+            inside = false;
+        }
+        ++done;
+    };
+    // 一半协程在另一个调度器上
+    for (int i = 0; i < s_fibers; ++i) {
+        (i % 2 ? other : iom)->schedule(worker);
+    }
+    // 计时协程也计入done, 避免函数返回后它还在访问栈上的变量
+    iom->schedule([&]() {
+        while (done < s_fibers) {
+            ++ticks;
+            usleep(1000);
+        }
+        ++done;
+    });
+    while (done < s_fibers + 1) {
+        usleep(10 * 1000);
+    }
+    SYLAR_LOG_INFO(g_logger) << "FiberMutex count=" << count << " ticks while locked=" << ticks;
+    SYLAR_ASSERT(count == s_fibers * s_loops);
+    SYLAR_ASSERT(ticks > 0);
+}
+
+void test_rwmutex(sylar::IOManager* iom) {
+    static const int s_readers = 8;
+    std::atomic<int> readers(0);
+    std::atomic<int> max_readers(0);
+    std::atomic<int> done(0);
+    int value = 0;
+    bool writing = false;
+    // 只有读者时可以同时持有
+    for (int i = 0; i < s_readers; ++i) {
+        iom->schedule([&]() {
+            sylar::FiberRWMutex::ReadLock lock(s_rwmutex);
+            int r = ++readers;
+            int m = max_readers;
+            while (r > m && !max_readers.compare_exchange_weak(m, r));
+            usleep(10 * 1000);
+            --readers;
+            ++done;
+        });
+    }
+    while (done < s_readers) {
+        usleep(10 * 1000);
+    }
+    SYLAR_ASSERT(max_readers > 1);
+    done = 0;
+
+    // 读写混合时写者独占
+    for (int i = 0; i < s_readers; ++i) {
+        iom->schedule([&]() {
+            for (int n = 0; n < 20; ++n) {
+                sylar::FiberRWMutex::ReadLock lock(s_rwmutex);
+                SYLAR_ASSERT(!writing);
+                ++readers;
+                usleep(1000);
+                --readers;
+            }
+            ++done;
+        });
+    }
+    for (int i = 0; i < 2; ++i) {
+        iom->schedule([&]() {
+            for (int n = 0; n < 20; ++n) {
+                sylar::FiberRWMutex::WriteLock lock(s_rwmutex);
+                SYLAR_ASSERT(readers == 0 && !writing);
+                writing = true;
+                usleep(500);
+                ++value;
+                writing = false;
+            }
+            ++done;
+        });
+    }
+    while (done < s_readers + 2) {
+        usleep(10 * 1000);
+    }
+    SYLAR_LOG_INFO(g_logger) << "FiberRWMutex value=" << value << " max concurrent readers=" << max_readers;
+    SYLAR_ASSERT(value == 40);
+}
+
+void test_condition(sylar::IOManager* iom, sylar::IOManager* other) {
+    static const int s_items = 10000;
+    std::list<int> queue;
+    std::atomic<int> done(0);
+    int64_t sum = 0;
+    for (int c = 0; c < 2; ++c) {
+        (c ? other : iom)->schedule([&]() {
+            while (true) {
+                sylar::FiberMutex::Lock lock(s_mutex);
+                s_cond.wait(s_mutex, [&]() { return !queue.empty(); });
+                int v = queue.front();
+                queue.pop_front();
+                if (v < 0) {
+                    break;
+                }
+                sum += v;
+            }
+            ++done;
+        });
+    }
+    iom->schedule([&]() {
+        for (int i = 1; i <= s_items + 2; ++i) {
+            sylar::FiberMutex::Lock lock(s_mutex);
+            queue.push_back(i <= s_items ? i : -1);
+            s_cond.notifyOne();
+        }
+        ++done;
+    });
+    while (done < 3) {
+        usleep(10 * 1000);
+    }
+    SYLAR_LOG_INFO(g_logger) << "FiberCondition sum=" << sum;
+    SYLAR_ASSERT(sum == (int64_t)s_items * (s_items + 1) / 2);
+}
+
+void bench(sylar::IOManager* iom) {
+    static const int s_loops = 10000000;
+    std::atomic<bool> finished(false);
+    iom->schedule([&]() {
+        sylar::Mutex mutex;
+        uint64_t begin = sylar::GetCurrentUS();
+        for (int i = 0; i < s_loops; ++i) {
+            sylar::Mutex::Lock lock(mutex);
+        }
+        uint64_t mutex_used = sylar::GetCurrentUS() - begin;
+        begin = sylar::GetCurrentUS();
+        for (int i = 0; i < s_loops; ++i) {
+            sylar::FiberMutex::Lock lock(s_mutex);
+        }
+        uint64_t fiber_used = sylar::GetCurrentUS() - begin;
+        begin = sylar::GetCurrentUS();
+        for (int i = 0; i < s_loops; ++i) {
+            sylar::FiberRWMutex::ReadLock lock(s_rwmutex);
+        }
+        uint64_t rd_used = sylar::GetCurrentUS() - begin;
+        SYLAR_LOG_INFO(g_logger) << "uncontended lock+unlock: Mutex "
+            << mutex_used * 1000.0 / s_loops << " ns, FiberMutex "
+            << fiber_used * 1000.0 / s_loops << " ns, FiberRWMutex read "
+            << rd_used * 1000.0 / s_loops << " ns";
+        finished = true;
+    });
+    while (!finished) {
+        usleep(10 * 1000);
+    }
+}
+
+int main(int argc, char** argv) {
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::Level::INFO);
+    sylar::IOManager iom(2, false, "iom");
+    sylar::IOManager other(1, false, "other");
+    test_mutex(&iom, &other);
+    test_rwmutex(&iom);
+    test_condition(&iom, &other);
+    bench(&iom);
+    SYLAR_LOG_INFO(g_logger) << "test_fiber_mutex ok";
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include "sylar/sylar.h"
+#include "sylar/iomanager.h"
+#include "sylar/future.h"
+#include <unistd.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+void test_basic(sylar::IOManager* iom) {
+    // 普通线程中阻塞等待
+    sylar::Future<int> f = sylar::Async(iom, []() {
+        usleep(10 * 1000);
+        return 42;
+    });
+    SYLAR_ASSERT(!f.isDone());
+    SYLAR_ASSERT(f.get() == 42);
+
+    sylar::Future<void> e = sylar::Async(iom, []() {
+        throw std::logic_error("boom");
+    });
+    bool caught = false;
+    try {
+        e.get();
+    } catch(std::logic_error& ex) {
+        caught = std::string(ex.what()) == "boom";
+    }
+    SYLAR_ASSERT(caught && e.getState() == sylar::FutureStateBase::FAILED);
+
+    // 超时
+    sylar::Promise<std::string> p;
+    sylar::Future<std::string> sf = p.getFuture();
+    SYLAR_ASSERT(!sf.wait(20));
+    p.setValue("done");
+    SYLAR_ASSERT(!p.setValue("again"));
+    SYLAR_ASSERT(sf.wait(20) && sf.get() == "done");
+
+    // 协程中的超时
+    std::atomic<bool> finished(false);
+    iom->schedule([&finished]() {
+        sylar::Promise<int> p;
+        uint64_t begin = sylar::GetCurrentMS();
+        SYLAR_ASSERT(!p.getFuture().wait(30));
+        SYLAR_ASSERT(sylar::GetCurrentMS() - begin >= 20);
+        finished = true;
+    });
+    while (!finished) {
+        usleep(1000);
+    }
+    SYLAR_LOG_INFO(g_logger) << "test_basic ok";
+}
+
+void test_cancel(sylar::IOManager* iom) {
+    // 取消后生产者收到通知, get抛出FutureCancelled
+    sylar::Promise<int> p;
+    std::atomic<bool> aborted(false);
+    p.onCancel([&aborted]() {
+        aborted = true;
+    });
+    sylar::Future<int> f = p.getFuture();
+    SYLAR_ASSERT(f.cancel() && aborted && p.isCancelled());
+    SYLAR_ASSERT(!p.setValue(1));
+    bool caught = false;
+    try {
+        f.get();
+    } catch(sylar::FutureCancelled&) {
+        caught = true;
+    }
+    SYLAR_ASSERT(caught);
+
+    // 取消WhenAll取消所有输入, 挂起的协程被唤醒
+    std::vector<sylar::Future<int> > futures;
+    std::vector<sylar::Promise<int> > promises(4);
+    for (auto& i : promises) {
+        futures.push_back(i.getFuture());
+    }
+    sylar::Future<void> all = sylar::WhenAll(futures);
+    std::atomic<bool> woke(false);
+    iom->schedule([futures, &woke]() {
+        SYLAR_ASSERT(futures[2].wait());
+        woke = true;
+    });
+    usleep(10 * 1000);
+    promises[0].setValue(1);
+    SYLAR_ASSERT(all.cancel());
+    for (size_t i = 1; i < promises.size(); ++i) {
+        SYLAR_ASSERT(promises[i].isCancelled());
+    }
+    while (!woke) {
+        usleep(1000);
+    }
+    SYLAR_ASSERT(futures[0].get() == 1);
+    SYLAR_LOG_INFO(g_logger) << "test_cancel ok";
+}
+
+/**
+ * @brief 分散-汇聚: 在协程中并发发起N个下游调用并等待全部完成
+ */
+void test_scatter_gather(sylar::IOManager* iom, sylar::IOManager* other) {
+    static const int s_calls = 200;
+    std::atomic<bool> finished(false);
+    iom->schedule([=, &finished]() {
+        uint64_t begin = sylar::GetCurrentMS();
+        std::vector<sylar::Future<int> > futures;
+        for (int i = 0; i < s_calls; ++i) {
+            // 一半在另一个调度器上, 完成后在原来的调度器中恢复
+            futures.push_back(sylar::Async(i % 2 ? other : iom, [i]() {
+                usleep((i % 10 + 1) * 1000);
+                return i;
+            }));
+        }
+        sylar::Scheduler* sc = sylar::Scheduler::GetThis();
+        sylar::WhenAll(futures).get();
+        SYLAR_ASSERT(sylar::Scheduler::GetThis() == sc);
+        int64_t sum = 0;
+        for (auto& i : futures) {
+            sum += i.get();
+        }
+        SYLAR_ASSERT(sum == (int64_t)s_calls * (s_calls - 1) / 2);
+        uint64_t used = sylar::GetCurrentMS() - begin;
+        SYLAR_LOG_INFO(g_logger) << s_calls << " calls of 1-10ms gathered in " << used << "ms";
+        SYLAR_ASSERT(used < 500);
+
+        // 第一个完成的
+        std::vector<sylar::Future<int> > race;
+        for (int i = 0; i < 3; ++i) {
+            race.push_back(sylar::Async(iom, [i]() {
+                usleep((3 - i) * 20 * 1000);
+                return i;
+            }));
+        }
+        SYLAR_ASSERT(sylar::WhenAny(race).get() == 2);
+        sylar::WhenAll(race).get();
+        finished = true;
+    });
+    while (!finished) {
+        usleep(1000);
+    }
+    SYLAR_LOG_INFO(g_logger) << "test_scatter_gather ok";
+}
+
+/**
+ * @brief 对比每次扇出的开销: Future+WhenAll与手工FiberSemaphore
+ */
+void bench(sylar::IOManager* iom) {
+    static const int s_rounds = 2000;
+    static const int s_fanout = 16;
+    std::atomic<bool> finished(false);
+    iom->schedule([&finished, iom]() {
+        uint64_t begin = sylar::GetCurrentUS();
+        for (int r = 0; r < s_rounds; ++r) {
+            std::vector<sylar::Future<int> > futures;
+            futures.reserve(s_fanout);
+            for (int i = 0; i < s_fanout; ++i) {
+                futures.push_back(sylar::Async(iom, [i]() { return i; }));
+            }
+            sylar::WhenAll(futures).get();
+        }
+        uint64_t future_used = sylar::GetCurrentUS() - begin;
+
+        begin = sylar::GetCurrentUS();
+        for (int r = 0; r < s_rounds; ++r) {
+            sylar::FiberSemaphore sem;
+            std::vector<int> results(s_fanout);
+            for (int i = 0; i < s_fanout; ++i) {
+                iom->schedule([i, &results, &sem]() {
+                    results[i] = i;
+                    sem.notify();
+                });
+            }
+            for (int i = 0; i < s_fanout; ++i) {
+                sem.wait();
+            }
+        }
+        uint64_t sem_used = sylar::GetCurrentUS() - begin;
+        SYLAR_LOG_INFO(g_logger) << "fan-out " << s_fanout << ": Future+WhenAll "
+            << future_used * 1000.0 / (s_rounds * s_fanout) << " ns/call, FiberSemaphore "
+            << sem_used * 1000.0 / (s_rounds * s_fanout) << " ns/call";
+        finished = true;
+    });
+    while (!finished) {
+        usleep(1000);
+    }
+}
+
+int main(int argc, char** argv) {
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::Level::INFO);
+    SYLAR_LOG_ROOT()->setLevel(sylar::LogLevel::Level::INFO);
+    sylar::IOManager iom(2, false, "iom");
+    sylar::IOManager other(1, false, "other");
+    test_basic(&iom);
+    test_cancel(&iom);
+    test_scatter_gather(&iom, &other);
+    bench(&iom);
+    SYLAR_LOG_INFO(g_logger) << "test_future ok";
+    return 0;
+}
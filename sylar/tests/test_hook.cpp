@@ -1,6 +1,9 @@
 #include "sylar/hook.h"
 #include "sylar/iomanager.h"
 #include "sylar/log.h"
+#include "sylar/fd_manager.h"
+#include <vector>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
@@ -55,10 +58,183 @@ void test_sock() {
 
 }
 
+void test_deadline() {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr.s_addr);
+    bind(sock, (const sockaddr*)&addr, sizeof(addr));
+
+    sylar::set_fiber_deadline(200);
+    char buf[16];
+    uint64_t begin = sylar::GetCurrentMS();
+    int rt = recv(sock, buf, sizeof(buf), 0);
+    SYLAR_LOG_INFO(g_logger) << "deadline recv rt=" << rt << " errno=" << errno
+        << " used=" << (sylar::GetCurrentMS() - begin) << "ms";
+    // 截止时间已过, 后续调用立即失败
+    rt = sleep(1);
+    SYLAR_LOG_INFO(g_logger) << "deadline sleep rt=" << rt
+        << " left=" << sylar::get_fiber_deadline_left();
+    sylar::clear_fiber_deadline();
+    close(sock);
+}
+
+void test_file_io() {
+    int fd = open("/tmp/test_hook_file.txt", O_CREAT | O_RDWR | O_TRUNC, 0644);
+    SYLAR_LOG_INFO(g_logger) << "open fd=" << fd << " errno=" << errno;
+    if (fd < 0) {
+        return ;
+    }
+    const char data[] = "hello offload";
+    int rt = write(fd, data, sizeof(data));
+    SYLAR_LOG_INFO(g_logger) << "write rt=" << rt << " fsync rt=" << fsync(fd);
+    char buf[64] = {0};
+    rt = pread(fd, buf, sizeof(buf), 0);
+    SYLAR_LOG_INFO(g_logger) << "pread rt=" << rt << " buf=" << buf;
+    // 截止时间已过, 不再提交到线程池
+    sylar::set_fiber_deadline(10);
+    usleep(20 * 1000);
+    rt = pread(fd, buf, sizeof(buf), 0);
+    SYLAR_LOG_INFO(g_logger) << "pread after deadline rt=" << rt << " errno=" << errno;
+    sylar::clear_fiber_deadline();
+    close(fd);
+
+    // 管道等非普通文件直接调用原函数, 不占用线程池
+    unlink("/tmp/test_hook_fifo");
+    if (mkfifo("/tmp/test_hook_fifo", 0644) == 0) {
+        fd = open("/tmp/test_hook_fifo", O_RDWR);
+        rt = write(fd, data, sizeof(data));
+        memset(buf, 0, sizeof(buf));
+        int rt2 = read(fd, buf, sizeof(buf));
+        SYLAR_LOG_INFO(g_logger) << "fifo write rt=" << rt << " read rt=" << rt2 << " buf=" << buf;
+        close(fd);
+        unlink("/tmp/test_hook_fifo");
+    }
+}
+
+void test_sendfile() {
+    int listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr.s_addr);
+    bind(listen_sock, (const sockaddr*)&addr, sizeof(addr));
+    listen(listen_sock, 8);
+    socklen_t len = sizeof(addr);
+    getsockname(listen_sock, (sockaddr*)&addr, &len);
+
+    sylar::IOManager::GetThis()->schedule([addr](){
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        connect(sock, (const sockaddr*)&addr, sizeof(addr));
+        char buf[64] = {0};
+        int rt = recv(sock, buf, sizeof(buf), 0);
+        SYLAR_LOG_INFO(g_logger) << "sendfile recv rt=" << rt << " buf=" << buf;
+        close(sock);
+    });
+
+    int fd = open("/tmp/test_hook_sendfile.txt", O_CREAT | O_RDWR | O_TRUNC, 0644);
+    const char data[] = "hello sendfile";
+    write(fd, data, sizeof(data));
+    int client = accept(listen_sock, nullptr, nullptr);
+    off_t offset = 0;
+    int rt = sendfile(client, fd, &offset, 64);
+    SYLAR_LOG_INFO(g_logger) << "sendfile rt=" << rt << " errno=" << errno;
+    close(fd);
+    close(client);
+    close(listen_sock);
+}
+
+void test_poll() {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr.s_addr);
+    bind(sock, (const sockaddr*)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(sock, (sockaddr*)&addr, &len);
+
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    FD_SET(sock, &rfds);
+    timeval tv = {0, 100 * 1000};
+    uint64_t begin = sylar::GetCurrentMS();
+    int rt = select(sock + 1, &rfds, nullptr, nullptr, &tv);
+    SYLAR_LOG_INFO(g_logger) << "select rt=" << rt
+        << " used=" << (sylar::GetCurrentMS() - begin) << "ms";
+
+    sylar::IOManager::GetThis()->schedule([addr](){
+        usleep(100 * 1000);
+        int s = socket(AF_INET, SOCK_DGRAM, 0);
+        sendto(s, "ping", 4, 0, (const sockaddr*)&addr, sizeof(addr));
+        close(s);
+    });
+    pollfd pfd;
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    begin = sylar::GetCurrentMS();
+    rt = poll(&pfd, 1, 1000);
+    SYLAR_LOG_INFO(g_logger) << "poll rt=" << rt << " revents=" << pfd.revents
+        << " used=" << (sylar::GetCurrentMS() - begin) << "ms";
+    close(sock);
+
+    // 只等待挂断(events为0)且不超时, 没有可注册的事件, 靠轮询醒来
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    int peer = sv[1];
+    sylar::IOManager::GetThis()->schedule([peer](){
+        usleep(50 * 1000);
+        close(peer);
+    });
+    pfd.fd = sv[0];
+    pfd.events = 0;
+    pfd.revents = 0;
+    begin = sylar::GetCurrentMS();
+    rt = poll(&pfd, 1, -1);
+    SYLAR_LOG_INFO(g_logger) << "poll hangup rt=" << rt << " revents=" << pfd.revents
+        << " used=" << (sylar::GetCurrentMS() - begin) << "ms";
+    close(sv[0]);
+}
+
+void test_fd_table() {
+    std::vector<int> fds;
+    for (int i = 0; i < 200; ++i) {
+        fds.push_back(socket(AF_INET, SOCK_DGRAM, 0));
+    }
+    int found = 0;
+    {
+        sylar::EpochGuard guard;
+        for (auto fd : fds) {
+            found += sylar::FdMgr::GetInstance()->get(fd) ? 1 : 0;
+        }
+    }
+    for (auto fd : fds) {
+        close(fd);
+    }
+    int left = 0;
+    {
+        sylar::EpochGuard guard;
+        for (auto fd : fds) {
+            left += sylar::FdMgr::GetInstance()->get(fd) ? 1 : 0;
+        }
+    }
+    SYLAR_LOG_INFO(g_logger) << "fd table max_fd=" << fds.back()
+        << " found=" << found << " left_after_close=" << left
+        << " pending_reclaim=" << sylar::Epoch::Reclaim();
+}
+
 int main()
 {
     // test_sleep();
     sylar::IOManager iom;
+    iom.schedule(test_deadline);
+    iom.schedule(test_file_io);
+    iom.schedule(test_sendfile);
+    iom.schedule(test_poll);
+    iom.schedule(test_fd_table);
     iom.schedule(test_sock);
     return 0;
 }
\ No newline at end of file
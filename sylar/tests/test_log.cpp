@@ -0,0 +1,598 @@
+#include "sylar/sylar.h"
+#include "sylar/epoch.h"
+#include <yaml-cpp/yaml.h>
+#include <fstream>
+#include <dirent.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+static const int s_threads = 4;
+static const int s_count = 100000;
+
+/**
+ * @brief 多线程写日志, 返回每秒条数
+ */
+static uint64_t bench(sylar::Logger::ptr logger, int threads, int count) {
+    std::vector<sylar::Thread::ptr> thrs;
+    uint64_t begin = sylar::GetCurrentUS();
+    for (int i = 0; i < threads; ++i) {
+        thrs.push_back(sylar::Thread::ptr(new sylar::Thread([logger, count](){
+            for (int n = 0; n < count; ++n) {
+                SYLAR_LOG_INFO(logger) << "bench message n=" << n;
+            }
+        }, "bench_" + std::to_string(i))));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    return (uint64_t)threads * count * 1000000 / (used ? used : 1);
+}
+
+static size_t count_lines(const std::string& file) {
+    std::ifstream ifs(file);
+    std::string line;
+    size_t n = 0;
+    while (std::getline(ifs, line)) {
+        ++n;
+    }
+    return n;
+}
+
+void test_async() {
+    sylar::Logger::ptr root = SYLAR_LOG_ROOT();
+
+    sylar::Logger::ptr sync_logger(new sylar::Logger("sync"));
+    unlink("/tmp/test_log_sync.log");
+    sync_logger->addAppender(sylar::LogAppender::ptr(new sylar::FileLogAppender("/tmp/test_log_sync.log")));
+    uint64_t sync_qps = bench(sync_logger, s_threads, s_count);
+
+    sylar::Logger::ptr async_logger(new sylar::Logger("async"));
+    unlink("/tmp/test_log_async.log");
+    sylar::AsyncLogAppender::ptr async(new sylar::AsyncLogAppender("/tmp/test_log_async.log"));
+    async_logger->addAppender(async);
+    uint64_t async_qps = bench(async_logger, s_threads, s_count);
+    async->flush();
+    SYLAR_LOG_INFO(root) << "FileLogAppender " << sync_qps << "/s AsyncLogAppender(block) "
+        << async_qps << "/s lines=" << count_lines("/tmp/test_log_async.log");
+
+    sylar::Logger::ptr drop_logger(new sylar::Logger("drop"));
+    unlink("/tmp/test_log_drop.log");
+    sylar::AsyncLogAppender::ptr drop(new sylar::AsyncLogAppender("/tmp/test_log_drop.log"
+                , 64 * 1024, sylar::AsyncLogAppender::Policy::DROP));
+    drop_logger->addAppender(drop);
+    uint64_t drop_qps = bench(drop_logger, s_threads, s_count);
+    SYLAR_LOG_FATAL(drop_logger) << "fatal must be written";
+    SYLAR_LOG_INFO(root) << "AsyncLogAppender(drop) " << drop_qps << "/s dropped="
+        << drop->getDropped() << " lines=" << count_lines("/tmp/test_log_drop.log");
+
+    // 超过缓冲区容量的FATAL日志截断后写出, 不会被丢弃
+    sylar::Logger::ptr small_logger(new sylar::Logger("small"));
+    unlink("/tmp/test_log_small.log");
+    sylar::AsyncLogAppender::ptr small(new sylar::AsyncLogAppender("/tmp/test_log_small.log"
+                , 256, sylar::AsyncLogAppender::Policy::DROP));
+    small_logger->addAppender(small);
+    SYLAR_LOG_FATAL(small_logger) << std::string(1000, 'x');
+    std::ifstream ifs("/tmp/test_log_small.log");
+    std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    SYLAR_LOG_INFO(root) << "AsyncLogAppender oversized fatal size=" << content.size()
+        << " dropped=" << small->getDropped();
+    SYLAR_ASSERT(content.size() == 256 && content.find("(truncated)") != std::string::npos);
+    SYLAR_ASSERT(small->getDropped() == 0);
+}
+
+void test_format_bench() {
+    static const int s_lines = 1000000;
+    sylar::Logger::ptr logger = SYLAR_LOG_ROOT();
+    sylar::LogFormatter::ptr fmt(new sylar::LogFormatter(
+                "%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n"));
+    sylar::LogEvent::ptr event(new sylar::LogEvent(logger, sylar::LogLevel::Level::INFO
+                , __FILE__, __LINE__, 0, sylar::GetThreadId(), sylar::GetFiberId()
+                , time(0), sylar::Thread::GetName()));
+    event->getSS() << "format benchmark message";
+
+    size_t bytes = 0;
+    uint64_t begin = sylar::GetCurrentUS();
+    for (int i = 0; i < s_lines; ++i) {
+        std::string& buf = sylar::LogFormatter::GetThreadBuffer();
+        fmt->format(buf, logger.get(), sylar::LogLevel::Level::INFO, *event);
+        bytes += buf.size();
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+
+    begin = sylar::GetCurrentUS();
+    for (int i = 0; i < s_lines; ++i) {
+        bytes += fmt->format(logger, sylar::LogLevel::Level::INFO, event).size();
+    }
+    uint64_t used_str = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(logger) << "format thread buffer " << (uint64_t)s_lines * 1000000 / (used ? used : 1)
+        << " lines/s, return string " << (uint64_t)s_lines * 1000000 / (used_str ? used_str : 1)
+        << " lines/s bytes=" << bytes;
+}
+
+/// 全局operator new调用次数
+static std::atomic<uint64_t> s_alloc_count(0);
+
+// 不内联, 否则gcc把替换后的new/delete内联成malloc/free后误报-Wmismatched-new-delete
+__attribute__((noinline)) void* operator new(size_t size) {
+    ++s_alloc_count;
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
+
+/**
+ * @brief 只格式化不输出的appender
+ */
+class NullLogAppender : public sylar::LogAppender {
+public:
+    virtual void log(sylar::Logger* logger, sylar::LogLevel::Level level
+                     , const sylar::LogEvent& event) override {
+        std::string& buf = sylar::LogFormatter::GetThreadBuffer();
+        {
+            MutexType::Lock lock(m_mutex);
+            m_formatter->format(buf, logger, level, event);
+        }
+        bytes.fetch_add(buf.size(), std::memory_order_relaxed);
+    }
+    virtual std::string toYamlString() override { return ""; }
+
+    std::atomic<size_t> bytes{0};
+};
+
+/**
+ * @brief 在log()中等待release的appender
+ */
+class SlowLogAppender : public sylar::LogAppender {
+public:
+    virtual void log(sylar::Logger* logger, sylar::LogLevel::Level level
+                     , const sylar::LogEvent& event) override {
+        entered = true;
+        while (!release) {
+            usleep(1000);
+        }
+    }
+    virtual std::string toYamlString() override { return ""; }
+
+    std::atomic<bool> entered{false};
+    std::atomic<bool> release{false};
+};
+
+void test_event_bench() {
+    static const int s_lines = 1000000;
+    sylar::Logger::ptr logger(new sylar::Logger("event_bench"));
+    NullLogAppender* appender = new NullLogAppender;
+    logger->addAppender(sylar::LogAppender::ptr(appender));
+
+    for (int i = 0; i < 1000; ++i) {
+        SYLAR_LOG_INFO(logger) << "warm up " << i;
+        SYLAR_LOG_FMT_INFO(logger, "warm up %d", i);
+    }
+
+    uint64_t allocs = s_alloc_count;
+    uint64_t begin = sylar::GetCurrentUS();
+    for (int i = 0; i < s_lines; ++i) {
+        SYLAR_LOG_INFO(logger) << "event benchmark message i=" << i << " pi=" << 3.14;
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    uint64_t stream_allocs = s_alloc_count - allocs;
+
+    allocs = s_alloc_count;
+    begin = sylar::GetCurrentUS();
+    for (int i = 0; i < s_lines; ++i) {
+        SYLAR_LOG_FMT_INFO(logger, "event benchmark message i=%d pi=%.2f", i, 3.14);
+    }
+    uint64_t used_fmt = sylar::GetCurrentUS() - begin;
+    uint64_t fmt_allocs = s_alloc_count - allocs;
+
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "SYLAR_LOG_INFO " << (uint64_t)s_lines * 1000000 / (used ? used : 1)
+        << " lines/s allocs=" << stream_allocs
+        << ", SYLAR_LOG_FMT_INFO " << (uint64_t)s_lines * 1000000 / (used_fmt ? used_fmt : 1)
+        << " lines/s allocs=" << fmt_allocs << " bytes=" << appender->bytes;
+    SYLAR_ASSERT(stream_allocs == 0 && fmt_allocs == 0);
+}
+
+/**
+ * @brief 列出目录下的文件
+ */
+static std::vector<std::string> list_dir(const std::string& dir) {
+    std::vector<std::string> files;
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        return files;
+    }
+    struct dirent* dp = nullptr;
+    while ((dp = readdir(d)) != nullptr) {
+        if (dp->d_name[0] != '.') {
+            files.push_back(dir + "/" + dp->d_name);
+        }
+    }
+    closedir(d);
+    return files;
+}
+
+void test_rotate() {
+    sylar::Logger::ptr root = SYLAR_LOG_ROOT();
+    // 追加写入, 不截断已有内容
+    {
+        std::ofstream ofs("/tmp/test_log_hup.log");
+        ofs << "old line" << std::endl;
+    }
+    unlink("/tmp/test_log_hup.log.1");
+    sylar::Logger::ptr hup_logger(new sylar::Logger("hup"));
+    hup_logger->addAppender(sylar::LogAppender::ptr(new sylar::FileLogAppender("/tmp/test_log_hup.log")));
+    SYLAR_LOG_INFO(hup_logger) << "before logrotate";
+    // 默认不接管SIGHUP, 通过配置开启
+    struct sigaction action;
+    sigaction(SIGHUP, nullptr, &action);
+    SYLAR_ASSERT(action.sa_handler == SIG_DFL);
+    sylar::ConfigVar<bool>::ptr reopen_on_sighup = sylar::Config::Lookup<bool>("log.reopen_on_sighup");
+    reopen_on_sighup->setValue(true);
+    // 模拟logrotate: 移走文件后发送SIGHUP
+    rename("/tmp/test_log_hup.log", "/tmp/test_log_hup.log.1");
+    raise(SIGHUP);
+    SYLAR_LOG_INFO(hup_logger) << "after logrotate";
+    SYLAR_ASSERT(count_lines("/tmp/test_log_hup.log.1") == 2);
+    SYLAR_ASSERT(count_lines("/tmp/test_log_hup.log") == 1);
+    reopen_on_sighup->setValue(false);
+    sigaction(SIGHUP, nullptr, &action);
+    SYLAR_ASSERT(action.sa_handler == SIG_DFL);
+
+    std::string dir = "/tmp/test_log_rotate";
+    for (auto& i : list_dir(dir)) {
+        unlink(i.c_str());
+    }
+    mkdir(dir.c_str(), 0755);
+    sylar::Logger::ptr logger(new sylar::Logger("rotate"));
+    sylar::RotatingFileLogAppender::ptr appender(new sylar::RotatingFileLogAppender(dir + "/app.log"
+                , 64 * 1024, sylar::RotatingFileLogAppender::Interval::DAILY, 3, true));
+    logger->addAppender(appender);
+    uint64_t used = 0;
+    for (int n = 0; n < 10; ++n) {
+        uint64_t begin = sylar::GetCurrentUS();
+        for (int i = 0; i < 1000; ++i) {
+            SYLAR_LOG_INFO(logger) << "rotate message n=" << n << " i=" << i;
+        }
+        used += sylar::GetCurrentUS() - begin;
+        // 留出时间给后台线程滚动
+        usleep(20 * 1000);
+    }
+    for (int i = 0; i < 100 && appender->getRotations() < 5; ++i) {
+        usleep(10 * 1000);
+    }
+    std::vector<std::string> files = list_dir(dir);
+    size_t gz = 0;
+    for (auto& i : files) {
+        SYLAR_LOG_INFO(root) << "rotated file: " << i;
+        if (i.size() > 3 && i.compare(i.size() - 3, 3, ".gz") == 0) {
+            ++gz;
+        }
+    }
+    SYLAR_LOG_INFO(root) << "RotatingFileLogAppender " << 10000 * 1000000ull / (used ? used : 1)
+        << "/s rotations=" << appender->getRotations() << " files=" << files.size();
+    SYLAR_ASSERT(appender->getRotations() >= 5);
+    SYLAR_ASSERT(gz <= 3 && files.size() == gz + 1);
+}
+
+/**
+ * @brief 多线程写同一个logger, 同时不断增删appender
+ */
+void test_dispatch() {
+    static const int s_lines = 200000;
+    sylar::Logger::ptr logger(new sylar::Logger("dispatch"));
+    std::shared_ptr<NullLogAppender> appender(new NullLogAppender);
+    logger->addAppender(appender);
+
+    std::atomic<bool> stop(false);
+    uint64_t changes = 0;
+    sylar::Thread::ptr changer(new sylar::Thread([logger, &stop, &changes](){
+        while (!stop) {
+            sylar::LogAppender::ptr extra(new NullLogAppender);
+            logger->addAppender(extra);
+            logger->delAppender(extra);
+            ++changes;
+        }
+    }, "changer"));
+
+    std::vector<sylar::Thread::ptr> thrs;
+    uint64_t begin = sylar::GetCurrentUS();
+    for (int i = 0; i < s_threads; ++i) {
+        thrs.push_back(sylar::Thread::ptr(new sylar::Thread([logger](){
+            for (int n = 0; n < s_lines; ++n) {
+                SYLAR_LOG_INFO(logger) << "dispatch message n=" << n;
+            }
+        }, "dispatch_" + std::to_string(i))));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    stop = true;
+    changer->join();
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "dispatch " << (uint64_t)s_threads * s_lines * 1000000 / (used ? used : 1)
+        << " lines/s appender changes=" << changes << " bytes=" << appender->bytes;
+    SYLAR_ASSERT(appender->bytes > 0);
+
+    // appender阻塞时不占用epoch, 其他模块的延迟释放照常进行
+    std::shared_ptr<SlowLogAppender> slow(new SlowLogAppender);
+    sylar::Logger::ptr slow_logger(new sylar::Logger("slow"));
+    slow_logger->addAppender(slow);
+    sylar::Thread::ptr writer(new sylar::Thread([slow_logger](){
+        SYLAR_LOG_INFO(slow_logger) << "slow";
+    }, "slow_writer"));
+    while (!slow->entered) {
+        usleep(1000);
+    }
+    std::atomic<bool> freed(false);
+    sylar::Epoch::Retire([&freed](){ freed = true; });
+    for (int i = 0; i < 3 && sylar::Epoch::Reclaim(); ++i);
+    slow->release = true;
+    writer->join();
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "reclaimed while appender blocked: " << freed;
+    SYLAR_ASSERT(freed);
+}
+
+/**
+ * @brief 统计文件中的字节, 返回换行数, nul返回NUL字节数
+ */
+static size_t count_bytes(const std::string& file, size_t& nul) {
+    std::ifstream ifs(file, std::ios::binary);
+    size_t lines = 0;
+    char c;
+    while (ifs.get(c)) {
+        lines += c == '\n';
+        nul += c == '\0';
+    }
+    return lines;
+}
+
+void test_mmap() {
+    static const int s_lines = 20000;
+    std::string dir = "/tmp/test_log_mmap";
+    for (auto& i : list_dir(dir)) {
+        unlink(i.c_str());
+    }
+    mkdir(dir.c_str(), 0755);
+    std::string file = dir + "/app.log";
+
+    // 子进程写完直接退出, 模拟崩溃: 没有截断, 数据仍然在文件中
+    pid_t pid = fork();
+    if (pid == 0) {
+        sylar::Logger::ptr logger(new sylar::Logger("mmap_crash"));
+        sylar::MmapLogAppender* appender = new sylar::MmapLogAppender(file, 64 * 1024);
+        appender->setFormatter(sylar::LogFormatter::ptr(new sylar::LogFormatter("%m%n")));
+        logger->addAppender(sylar::LogAppender::ptr(appender));
+        for (int i = 0; i < 100; ++i) {
+            SYLAR_LOG_INFO(logger) << "crash message " << i;
+        }
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    size_t nul = 0;
+    SYLAR_ASSERT(count_bytes(file, nul) == 100);
+    SYLAR_ASSERT(nul > 0);
+
+    // 重新打开后接在已有数据之后, 多线程写入并多次滚动
+    uint64_t rollovers = 0;
+    uint64_t used = 0;
+    {
+        sylar::Logger::ptr logger(new sylar::Logger("mmap"));
+        sylar::MmapLogAppender::ptr appender(new sylar::MmapLogAppender(file, 256 * 1024, 100));
+        appender->setFormatter(sylar::LogFormatter::ptr(new sylar::LogFormatter("%m%n")));
+        logger->addAppender(appender);
+        std::vector<sylar::Thread::ptr> thrs;
+        uint64_t begin = sylar::GetCurrentUS();
+        for (int i = 0; i < s_threads; ++i) {
+            thrs.push_back(sylar::Thread::ptr(new sylar::Thread([logger, i](){
+                for (int n = 0; n < s_lines; ++n) {
+                    SYLAR_LOG_INFO(logger) << "mmap message t=" << i << " n=" << n;
+                }
+            }, "mmap_" + std::to_string(i))));
+        }
+        for (auto& i : thrs) {
+            i->join();
+        }
+        used = sylar::GetCurrentUS() - begin;
+        rollovers = appender->getRollovers();
+        logger->clearAppenders();
+    }
+
+    size_t lines = 0;
+    nul = 0;
+    std::vector<std::string> files = list_dir(dir);
+    for (auto& i : files) {
+        lines += count_bytes(i, nul);
+    }
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "MmapLogAppender " << (uint64_t)s_threads * s_lines * 1000000 / (used ? used : 1)
+        << " lines/s rollovers=" << rollovers << " files=" << files.size()
+        << " lines=" << lines << " nul=" << nul;
+    SYLAR_ASSERT(rollovers > 0 && files.size() == rollovers + 1);
+    SYLAR_ASSERT(lines == 100 + (size_t)s_threads * s_lines);
+    SYLAR_ASSERT(nul == 0);
+
+    // 文件没有被移走时重新打开继续写当前段, 换下的段不能截断仍在映射的文件
+    for (auto& i : list_dir(dir)) {
+        unlink(i.c_str());
+    }
+    {
+        sylar::Logger::ptr logger(new sylar::Logger("mmap_reopen"));
+        sylar::MmapLogAppender::ptr appender(new sylar::MmapLogAppender(file, 64 * 1024, 10));
+        appender->setFormatter(sylar::LogFormatter::ptr(new sylar::LogFormatter("%m%n")));
+        logger->addAppender(appender);
+        for (int i = 0; i < 100; ++i) {
+            SYLAR_LOG_INFO(logger) << "reopen message " << i;
+        }
+        sylar::ReopenLogFiles();
+        SYLAR_LOG_INFO(logger) << "after reopen";
+        usleep(50 * 1000);
+        for (int i = 0; i < 1000; ++i) {
+            SYLAR_LOG_INFO(logger) << "reopen message " << i;
+        }
+        SYLAR_ASSERT(appender->getRollovers() == 0);
+
+        // logrotate移走文件后重新打开新文件, 旧文件截断到实际长度
+        rename(file.c_str(), (file + ".1").c_str());
+        sylar::ReopenLogFiles();
+        SYLAR_LOG_INFO(logger) << "after logrotate";
+        SYLAR_ASSERT(appender->getRollovers() == 1);
+        logger->clearAppenders();
+    }
+    nul = 0;
+    SYLAR_ASSERT(count_bytes(file + ".1", nul) == 1101);
+    SYLAR_ASSERT(count_bytes(file, nul) == 1);
+    SYLAR_ASSERT(nul == 0);
+
+    // 换下的段由appender自己的后台线程释放, 其他线程停在全局epoch内也不影响
+    for (auto& i : list_dir(dir)) {
+        unlink(i.c_str());
+    }
+    {
+        sylar::Logger::ptr logger(new sylar::Logger("mmap_retire"));
+        sylar::MmapLogAppender::ptr appender(new sylar::MmapLogAppender(file, 4096, 10));
+        appender->setFormatter(sylar::LogFormatter::ptr(new sylar::LogFormatter("%m%n")));
+        logger->addAppender(appender);
+        sylar::EpochGuard guard;
+        for (int i = 0; appender->getRollovers() == 0; ++i) {
+            SYLAR_LOG_INFO(logger) << "retire message " << i;
+        }
+        bool truncated = false;
+        for (int i = 0; i < 200 && !truncated; ++i) {
+            usleep(10 * 1000);
+            for (auto& f : list_dir(dir)) {
+                struct stat st;
+                truncated |= f != file && stat(f.c_str(), &st) == 0 && st.st_size < 4096;
+            }
+        }
+        SYLAR_ASSERT(truncated);
+        logger->clearAppenders();
+    }
+}
+
+void test_async_yaml() {
+    YAML::Node node = YAML::Load(
+        "logs:\n"
+        "    - name: async_yaml\n"
+        "      level: info\n"
+        "      appenders:\n"
+        "          - type: AsyncLogAppender\n"
+        "            file: /tmp/test_log_yaml.log\n"
+        "            policy: sample\n"
+        "            buffer_size: 65536\n"
+        "            sample_rate: 4\n"
+        "          - type: MmapLogAppender\n"
+        "            file: /tmp/test_log_yaml_mmap.log\n"
+        "            segment_size: 1048576\n"
+        "            sync_interval: 500\n");
+    sylar::Config::LoadFromYaml(node);
+    sylar::Logger::ptr logger = SYLAR_LOG_NAME("async_yaml");
+    SYLAR_LOG_INFO(logger) << "hello async yaml";
+    std::cout << logger->toYamlString() << std::endl;
+}
+
+class CaptureLogAppender : public sylar::LogAppender {
+public:
+    virtual void log(sylar::Logger* logger, sylar::LogLevel::Level level
+                     , const sylar::LogEvent& event) override {
+        ++lines;
+        last = event.getContent();
+    }
+    virtual std::string toYamlString() override { return ""; }
+
+    size_t lines = 0;
+    std::string last;
+};
+
+void test_rate_limit() {
+    sylar::Logger::ptr logger(new sylar::Logger("rate_limit"));
+    std::shared_ptr<CaptureLogAppender> appender(new CaptureLogAppender);
+    logger->addAppender(appender);
+
+    // 1.5秒内持续刷日志, 期望 100(突发) + 约150条
+    uint64_t calls = 0;
+    uint64_t begin = sylar::GetCurrentMS();
+    while (sylar::GetCurrentMS() - begin < 1500) {
+        SYLAR_LOG_ERROR_RATE(logger, 100) << "flood " << calls;
+        ++calls;
+    }
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "rate 100/s: calls=" << calls
+        << " lines=" << appender->lines << " last=" << appender->last;
+    SYLAR_ASSERT(appender->lines >= 200 && appender->lines <= 270);
+    SYLAR_ASSERT(appender->last.find("[suppressed ") == 0);
+
+    appender->lines = 0;
+    for (int i = 0; i < 100000; ++i) {
+        SYLAR_LOG_WARN_SAMPLE(logger, 1000) << "sample " << i;
+    }
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "sample 1/1000: lines=" << appender->lines
+        << " last=" << appender->last;
+    SYLAR_ASSERT(appender->lines == 100);
+    SYLAR_ASSERT(appender->last == "[suppressed 999 messages] sample 99000");
+
+    // 级别不够时不消耗令牌
+    appender->lines = 0;
+    logger->setLevel(sylar::LogLevel::Level::FATAL);
+    for (int i = 0; i < 10; ++i) {
+        SYLAR_LOG_ERROR_SAMPLE(logger, 1) << "filtered";
+    }
+    SYLAR_ASSERT(appender->lines == 0);
+}
+
+void static_site_log(int i) {
+    SYLAR_LOG_STATIC_DEBUG(SYLAR_LOG_NAME("static_site")) << "static site " << i;
+}
+
+void test_static_site() {
+    static const int s_calls = 10000000;
+    sylar::Logger::ptr logger = SYLAR_LOG_NAME("static_site");
+    std::shared_ptr<CaptureLogAppender> appender(new CaptureLogAppender);
+    logger->addAppender(appender);
+    logger->setLevel(sylar::LogLevel::Level::INFO);
+
+    uint64_t begin = sylar::GetCurrentUS();
+    for (int i = 0; i < s_calls; ++i) {
+        static_site_log(i);
+    }
+    uint64_t used_static = sylar::GetCurrentUS() - begin;
+    SYLAR_ASSERT(appender->lines == 0);
+
+    begin = sylar::GetCurrentUS();
+    for (int i = 0; i < s_calls; ++i) {
+        SYLAR_LOG_DEBUG(SYLAR_LOG_NAME("static_site")) << "dynamic " << i;
+    }
+    uint64_t used_dynamic = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(SYLAR_LOG_ROOT()) << "disabled debug: static site "
+        << used_static * 1000.0 / s_calls << " ns/call, SYLAR_LOG_NAME "
+        << used_dynamic * 1000.0 / s_calls << " ns/call";
+
+    // 修改级别后调用点立即生效
+    logger->setLevel(sylar::LogLevel::Level::DEBUG);
+    static_site_log(1);
+    SYLAR_ASSERT(appender->lines == 1 && appender->last == "static site 1");
+    logger->setLevel(sylar::LogLevel::Level::ERROR);
+    static_site_log(2);
+    SYLAR_ASSERT(appender->lines == 1);
+    logger->clearAppenders();
+    logger->setLevel(sylar::LogLevel::Level::DEBUG);
+}
+
+int main(int argc, char** argv) {
+    test_format_bench();
+    test_event_bench();
+    test_dispatch();
+    test_rate_limit();
+    test_static_site();
+    test_async();
+    test_rotate();
+    test_mmap();
+    test_async_yaml();
+    return 0;
+}
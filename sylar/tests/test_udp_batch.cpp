@@ -0,0 +1,183 @@
+#include "sylar/sylar.h"
+#include "sylar/iomanager.h"
+#include "sylar/udp_batch.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <string.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const int s_batch = 32;
+static const int s_rounds = 20000;
+
+static int create_udp(sockaddr_in& addr) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr.s_addr);
+    bind(sock, (const sockaddr*)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(sock, (sockaddr*)&addr, &len);
+    return sock;
+}
+
+// 每轮发送s_batch个报文再全部收回, 对比单报文系统调用与批量系统调用
+void bench_single(int rsock, int ssock, const sockaddr_in& addr) {
+    char buf[64] = "metrics";
+    uint64_t begin = sylar::GetCurrentUS();
+    uint64_t count = 0;
+    for (int r = 0; r < s_rounds; ++r) {
+        for (int i = 0; i < s_batch; ++i) {
+            sendto(ssock, buf, 32, 0, (const sockaddr*)&addr, sizeof(addr));
+        }
+        for (int i = 0; i < s_batch; ++i) {
+            if (recvfrom(rsock, buf, sizeof(buf), 0, nullptr, nullptr) > 0) {
+                ++count;
+            }
+        }
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "sendto/recvfrom packets=" << count
+        << " used=" << used << "us pps=" << count * 1000000 / (used ? used : 1);
+}
+
+void bench_batch(int rsock, int ssock, const sockaddr_in& addr) {
+    sylar::UdpBatch sender(s_batch, 64);
+    sylar::UdpBatch receiver(s_batch, 64);
+    char buf[64] = "metrics";
+    for (int i = 0; i < s_batch; ++i) {
+        sender.add(buf, 32, (const sockaddr*)&addr, sizeof(addr));
+    }
+    uint64_t begin = sylar::GetCurrentUS();
+    uint64_t count = 0;
+    for (int r = 0; r < s_rounds; ++r) {
+        sender.send(ssock);
+        int got = 0;
+        while (got < s_batch) {
+            int rt = receiver.recv(rsock);
+            if (rt <= 0) {
+                break;
+            }
+            got += rt;
+        }
+        count += got;
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "sendmmsg/recvmmsg packets=" << count
+        << " used=" << used << "us pps=" << count * 1000000 / (used ? used : 1);
+}
+
+// 收完total个分段为止, 返回收到的报文数, 开启GRO时一个报文可能包含多个分段
+static int recv_segments(sylar::UdpBatch& receiver, int rsock, int total, int& segments) {
+    int datagrams = 0;
+    segments = 0;
+    while (segments < total) {
+        int rt = receiver.recv(rsock);
+        if (rt <= 0) {
+            break;
+        }
+        for (int i = 0; i < rt; ++i) {
+            size_t len = receiver.getLength(i);
+            size_t seg = receiver.getSegmentSize(i);
+            segments += seg ? (len + seg - 1) / seg : 1;
+        }
+        datagrams += rt;
+    }
+    return datagrams;
+}
+
+// 每个发送报文由内核按s_segment切成s_segments个报文, 接收端不开GRO时逐个收到,
+// 开启GRO时同一个GSO报文可以整体交付, 分段大小通过cmsg返回
+void test_gso_gro() {
+    static const int s_messages = 4;
+    static const int s_segment = 32;
+    static const int s_segments = 16;
+    sockaddr_in raddr, graddr, saddr;
+    int rsock = create_udp(raddr);
+    int grsock = create_udp(graddr);
+    int ssock = create_udp(saddr);
+    timeval tv = {1, 0};
+    setsockopt(rsock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(grsock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (!sylar::UdpBatch::SetGSO(ssock, s_segment)) {
+        SYLAR_LOG_INFO(g_logger) << "UDP_SEGMENT not supported errno=" << errno << ", skip gso test";
+        close(rsock);
+        close(grsock);
+        close(ssock);
+        return;
+    }
+    bool gro = sylar::UdpBatch::SetGRO(grsock, true);
+
+    char data[s_segment * s_segments];
+    memset(data, 'g', sizeof(data));
+    sylar::UdpBatch sender(s_messages * 2, sizeof(data));
+    for (int i = 0; i < s_messages; ++i) {
+        sender.add(data, sizeof(data), (const sockaddr*)&raddr, sizeof(raddr));
+    }
+    for (int i = 0; i < s_messages; ++i) {
+        sender.add(data, sizeof(data), (const sockaddr*)&graddr, sizeof(graddr));
+    }
+    int rt = sender.send(ssock);
+    SYLAR_ASSERT(rt == s_messages * 2);
+
+    sylar::UdpBatch receiver(s_batch, 64 * 1024);
+    int segments = 0;
+    int datagrams = recv_segments(receiver, rsock, s_messages * s_segments, segments);
+    SYLAR_LOG_INFO(g_logger) << "gso sent=" << rt << " received datagrams=" << datagrams
+        << " segments=" << segments;
+    SYLAR_ASSERT(datagrams == s_messages * s_segments);
+    SYLAR_ASSERT(segments == s_messages * s_segments);
+
+    if (!gro) {
+        SYLAR_LOG_INFO(g_logger) << "UDP_GRO not supported errno=" << errno << ", skip gro test";
+    } else {
+        datagrams = recv_segments(receiver, grsock, s_messages * s_segments, segments);
+        SYLAR_LOG_INFO(g_logger) << "gro received datagrams=" << datagrams
+            << " segments=" << segments << " segment_size=" << receiver.getSegmentSize(0);
+        SYLAR_ASSERT(segments == s_messages * s_segments);
+        SYLAR_ASSERT(datagrams >= s_messages && datagrams <= s_messages * s_segments);
+
+        // 与上面的批量测试相同的报文数, 每次系统调用搬运s_segments个报文
+        sylar::UdpBatch gso_sender(s_batch, sizeof(data));
+        for (int i = 0; i < s_batch / s_segments; ++i) {
+            gso_sender.add(data, sizeof(data), (const sockaddr*)&graddr, sizeof(graddr));
+        }
+        uint64_t begin = sylar::GetCurrentUS();
+        uint64_t count = 0;
+        for (int r = 0; r < s_rounds; ++r) {
+            gso_sender.send(ssock);
+            recv_segments(receiver, grsock, s_batch, segments);
+            count += segments;
+        }
+        uint64_t used = sylar::GetCurrentUS() - begin;
+        SYLAR_LOG_INFO(g_logger) << "gso/gro sendmmsg/recvmmsg packets=" << count
+            << " used=" << used << "us pps=" << count * 1000000 / (used ? used : 1);
+        SYLAR_ASSERT(count == (uint64_t)s_rounds * s_batch);
+    }
+    close(rsock);
+    close(grsock);
+    close(ssock);
+}
+
+void run() {
+    g_logger->setLevel(sylar::LogLevel::Level::INFO);
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::Level::INFO);
+    sockaddr_in raddr, saddr;
+    int rsock = create_udp(raddr);
+    int ssock = create_udp(saddr);
+    SYLAR_LOG_INFO(g_logger) << "gso=" << sylar::UdpBatch::SetGSO(ssock, 0)
+        << " gro=" << sylar::UdpBatch::SetGRO(rsock, false);
+
+    bench_single(rsock, ssock, raddr);
+    bench_batch(rsock, ssock, raddr);
+    close(rsock);
+    close(ssock);
+    test_gso_gro();
+}
+
+int main(int argc, char** argv) {
+    sylar::IOManager iom(1);
+    iom.schedule(run);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include "sylar/sylar.h"
+#include "sylar/iomanager.h"
+#include "sylar/zerocopy.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <string.h>
+
+sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const size_t s_buf_size = 4 * 1024 * 1024;
+static const int s_count = 16;
+
+void run() {
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::Level::INFO);
+    int listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr.s_addr);
+    bind(listen_sock, (const sockaddr*)&addr, sizeof(addr));
+    listen(listen_sock, 8);
+    socklen_t len = sizeof(addr);
+    getsockname(listen_sock, (sockaddr*)&addr, &len);
+
+    sylar::IOManager::GetThis()->schedule([addr](){
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        connect(sock, (const sockaddr*)&addr, sizeof(addr));
+        std::string buf;
+        buf.resize(64 * 1024);
+        size_t total = 0;
+        while (true) {
+            int rt = recv(sock, &buf[0], buf.size(), 0);
+            if (rt <= 0) {
+                break;
+            }
+            total += rt;
+        }
+        SYLAR_LOG_INFO(g_logger) << "recv total=" << total;
+        close(sock);
+    });
+
+    int client = accept(listen_sock, nullptr, nullptr);
+    sylar::ZeroCopySender sender(client);
+    int released = 0;
+    uint64_t begin = sylar::GetCurrentUS();
+    for (int i = 0; i < s_count; ++i) {
+        std::string* buf = new std::string(s_buf_size, 'a' + i);
+        ssize_t rt = sender.send(buf->c_str(), buf->size(), [buf, &released](){
+            ++released;
+            delete buf;
+        });
+        if (rt < 0) {
+            SYLAR_LOG_ERROR(g_logger) << "send error errno=" << errno;
+            break;
+        }
+    }
+    sender.flush();
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "zerocopy enabled=" << sender.isEnabled()
+        << " released=" << released << " copied=" << sender.getCopiedCount()
+        << " used=" << used << "us";
+    close(client);
+    close(listen_sock);
+}
+
+int main(int argc, char** argv) {
+    sylar::IOManager iom(2);
+    iom.schedule(run);
+    return 0;
+}
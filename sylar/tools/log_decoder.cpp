@@ -0,0 +1,21 @@
+/**
+ * @file log_decoder.cpp
+ * @brief 把BinLogger输出的二进制日志还原成文本
+ */
+#include <iostream>
+#include "sylar/binlog.h"
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " binlog_file..." << std::endl;
+        return 1;
+    }
+    int rt = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (!sylar::BinLogDecoder::Decode(argv[i], std::cout)) {
+            std::cerr << argv[i] << ": invalid binlog file" << std::endl;
+            rt = 1;
+        }
+    }
+    return rt;
+}